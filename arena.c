@@ -0,0 +1,44 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+int arena_init(Arena *a, size_t size) {
+    memset(a, 0, sizeof(*a));
+    a->base = malloc(size);
+    if(a->base == NULL) {
+        return 1;
+    }
+    a->size = size;
+    a->owned = true;
+    return 0;
+}
+
+void arena_wrap(Arena *a, void *buffer, size_t size) {
+    memset(a, 0, sizeof(*a));
+    a->base = buffer;
+    a->size = size;
+}
+
+void arena_free(Arena *a) {
+    if(a->owned) {
+        free(a->base);
+    }
+    memset(a, 0, sizeof(*a));
+}
+
+void *arena_alloc(Arena *a, size_t bytes) {
+    // aligned by address, a wrapped buffer may start anywhere
+    uintptr_t start = ((uintptr_t)a->base + a->used + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+    size_t used = (size_t)(start - (uintptr_t)a->base) + bytes;
+    if(used > a->size) {
+        a->failed++;
+        return NULL;
+    }
+    a->used = used;
+    if(used > a->peak) {
+        a->peak = used;
+    }
+    return (void *)start;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Every allocation is rounded up to this, enough for the vector loads in
+// eval.c.
+#define ARENA_ALIGN 32
+
+// Bump allocator over one block taken up front. Allocations are never freed
+// one by one, the arena is rewound to a mark or reset as a whole, so the
+// search code can throw away a whole tree of copies in one step.
+typedef struct Arena {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    size_t peak;            // highest used has been, for sizing the block
+    size_t failed;          // allocations that didn't fit
+    bool owned;             // base came from malloc
+} Arena;
+
+// Allocates the block, returns 1 if it can't.
+int arena_init(Arena *a, size_t size);
+
+// Uses memory the caller owns (a stack buffer for instance), nothing is
+// allocated or freed.
+void arena_wrap(Arena *a, void *buffer, size_t size);
+
+void arena_free(Arena *a);
+
+// Returns NULL when the block is full, never falls back to malloc.
+void *arena_alloc(Arena *a, size_t bytes);
+
+static inline size_t arena_mark(const Arena *a) {
+    return a->used;
+}
+
+// Drops everything allocated since mark.
+static inline void arena_release(Arena *a, size_t mark) {
+    a->used = mark;
+}
+
+static inline void arena_reset(Arena *a) {
+    a->used = 0;
+}
+
+#endif
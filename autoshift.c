@@ -0,0 +1,127 @@
+#include <ncurses.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "autoshift.h"
+
+void autoshift_init(AutoShift *a, int dasMs, int arrMs) {
+    memset(a, 0, sizeof(*a));
+    a->das = (uint64_t)(dasMs > 0 ? dasMs : 0) * 1000000ULL;
+    a->arr = (uint64_t)(arrMs > 0 ? arrMs : 0) * 1000000ULL;
+}
+
+// Whether key is still down at now.
+static bool down(AutoShift *a, uint64_t now) {
+#ifdef _WIN32
+    (void)now;
+    return (GetAsyncKeyState(a->key == KEY_LEFT ? VK_LEFT : VK_RIGHT) & 0x8000) != 0;
+#else
+    return a->held && now - a->lastSeen <= AUTOSHIFT_RELEASE_MS * 1000000ULL;
+#endif
+}
+
+static void press(AutoShift *a, int key, uint64_t now) {
+    a->key = key;
+    a->pending = false;
+    a->pressed = now;
+    a->lastSeen = now;
+    a->nextShift = now + a->das;
+#ifdef _WIN32
+    a->held = true;
+#else
+    a->held = false;
+#endif
+}
+
+static int direction(int key) {
+    return key == KEY_LEFT ? -1 : 1;
+}
+
+int autoshift_update(AutoShift *a, int key, uint64_t now) {
+    int columns = 0;
+    int tapped = 0;
+    // no repeat followed the last press, or the other key came, so it was
+    // a tap after all
+    if(a->pending && (now - a->lastSeen > AUTOSHIFT_RELEASE_MS * 1000000ULL
+                      || ((key == KEY_LEFT || key == KEY_RIGHT) && key != a->key))) {
+        a->pending = false;
+        tapped = direction(a->key);
+    }
+    if(a->key != 0 && a->held && !down(a, now)) {
+        a->key = 0;
+    }
+    if(key == KEY_LEFT || key == KEY_RIGHT) {
+        uint64_t gap = now - a->lastSeen;
+        if(key != a->key) {
+            press(a, key, now);
+            columns = 1;
+        } else if(a->held) {
+            a->lastSeen = now;
+        } else if(gap <= AUTOSHIFT_RELEASE_MS * 1000000ULL) {
+            // repeats this close together come from the terminal, not from
+            // tapping, so the key has been down since it was pressed
+            a->lastSeen = now;
+            a->held = true;
+            a->pending = false;
+            // DAS may be long over by now, start repeating from here rather
+            // than catching up
+            if(a->nextShift < now) {
+                a->nextShift = now;
+            }
+        } else if(gap <= AUTOSHIFT_FIRST_REPEAT_MS * 1000000ULL) {
+            // a tap, or the terminal's first repeat: wait for the next
+            // repeat to tell, and keep counting DAS from the first press in
+            // case it is the latter
+            a->lastSeen = now;
+            a->pending = true;
+        } else {
+            press(a, key, now);
+            columns = 1;
+        }
+    }
+    if(a->key != 0 && a->held && now >= a->nextShift) {
+        int repeats;
+        if(a->arr == 0) {
+            repeats = AUTOSHIFT_WALL;
+            a->nextShift = now;
+        } else {
+            uint64_t due = (now - a->nextShift) / a->arr + 1;
+            repeats = due > AUTOSHIFT_WALL ? AUTOSHIFT_WALL : (int)due;
+            a->nextShift += due * a->arr;
+        }
+        columns += repeats;
+    }
+    return tapped + direction(a->key) * columns;
+}
+
+uint64_t autoshift_wait_ns(AutoShift *a, uint64_t now) {
+    if(a->key == 0) {
+        return UINT64_MAX;
+    }
+#ifndef _WIN32
+    if(a->pending) {
+        // the press turns into a tap if no repeat follows it
+        uint64_t tap = a->lastSeen + AUTOSHIFT_RELEASE_MS * 1000000ULL + 1;
+        return tap > now ? tap - now : 0;
+    }
+    if(!a->held) {
+        // nothing to do until the terminal's repeats show the key is down
+        return UINT64_MAX;
+    }
+#endif
+    uint64_t wait = UINT64_MAX;
+    if(now < a->nextShift) {
+        wait = a->nextShift - now;
+    } else if(a->arr != 0) {
+        wait = 0;
+    }
+#ifdef _WIN32
+    // look at the key often enough to see it come up between two presses
+    if(wait > AUTOSHIFT_POLL_MS * 1000000ULL) {
+        wait = AUTOSHIFT_POLL_MS * 1000000ULL;
+    }
+#endif
+    return wait;
+}
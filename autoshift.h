@@ -0,0 +1,44 @@
+#ifndef AUTOSHIFT_H_
+#define AUTOSHIFT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AUTOSHIFT_DAS_MS 167             // held this long before it repeats
+#define AUTOSHIFT_ARR_MS 33              // then one column this often, 0 slides to the wall
+#define AUTOSHIFT_WALL 9                 // columns that always reach the wall
+#define AUTOSHIFT_RELEASE_MS 80          // no terminal repeat for this long means let go
+#define AUTOSHIFT_FIRST_REPEAT_MS 700    // longest terminal repeat delay expected
+#define AUTOSHIFT_POLL_MS 16             // key state checks while held, Windows only
+
+// Repeats left/right from the game's own clock instead of the terminal's key
+// repeat. On Windows the key state is read directly, so the shift starts DAS
+// after the key went down and stops when it comes up. Terminals elsewhere
+// only send presses, so a key counts as held once the terminal starts
+// repeating it and as released when the repeats stop. The terminal's repeats
+// are swallowed either way, only the engine's ones move the piece. A second
+// press soon after the first could be a tap or the terminal's first repeat,
+// so it only moves once no further repeat follows it.
+typedef struct AutoShift {
+    uint64_t das;
+    uint64_t arr;
+    int key;                             // KEY_LEFT, KEY_RIGHT or 0
+    bool held;                           // key is known to be down
+    bool pending;                        // a second press that may be a tap
+    uint64_t pressed;
+    uint64_t lastSeen;                   // last press or repeat of key
+    uint64_t nextShift;
+} AutoShift;
+
+void autoshift_init(AutoShift *a, int dasMs, int arrMs);
+
+// Feeds the key read with wgetch (ERR if none) at now and returns the columns
+// to move, negative for left: one for a new press, plus whatever repeats are
+// due.
+int autoshift_update(AutoShift *a, int key, uint64_t now);
+
+// Nanoseconds until autoshift_update has a repeat to hand out, UINT64_MAX if
+// none is pending. Used to cut the wgetch timeout short.
+uint64_t autoshift_wait_ns(AutoShift *a, uint64_t now);
+
+#endif
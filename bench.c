@@ -0,0 +1,531 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "frame.h"
+#include "eval.h"
+#include "perfctr.h"
+#include "local.h"
+
+typedef void (*BenchFn)(BenchBoard *b, uint64_t iters);
+
+typedef struct BenchCase {
+    const char *name;
+    BenchFn fn;
+    bool lines;
+    const char *phase;                   // engine phase the counters are added up under
+} BenchCase;
+
+typedef struct BenchPhase {
+    const char *name;
+    PerfCounts perOp;                    // per op counts summed over the phase's results
+    int results;
+} BenchPhase;
+
+static volatile int sink;
+static tetrimo proto[7];
+
+static unsigned int nextRand(unsigned int *state) {
+    *state = (*state * 1103515245u) + 12345u;
+    return (*state >> 16) & 0x7fff;
+}
+
+void bench_make_board(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], int fill, int full_lines, unsigned int seed) {
+    initMatrix(matrix);
+    int rows = ((MATRIX_LENGTH-1) * fill) / 100;
+    for(int i = MATRIX_LENGTH-2; i > MATRIX_LENGTH-2-rows && i >= 0; i--) {
+        int hole = nextRand(&seed) % MATRIX_WIDTH;
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            matrix[i][j] = (j != hole) && (nextRand(&seed) % 4 != 0);
+        }
+    }
+    for(int i = MATRIX_LENGTH-2; i > MATRIX_LENGTH-2-full_lines && i >= 0; i--) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            matrix[i][j] = TRUE;
+        }
+    }
+}
+
+// Spawns every piece and lowers it a few rows so rotations have room.
+static void makeProtos() {
+    bool empty[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    initMatrix(empty);
+    for(int c = RED; c <= ORANGE; c++) {
+        Color next = c;
+        proto[c] = newBlock(c, &next, 0);
+        for(int i = 0; i < 3; i++) {
+            update(DOWN, &proto[c], empty);
+        }
+    }
+}
+
+static void benchCheckDown(BenchBoard *b, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        sink += checkDown(proto[PURPLE], b->matrix);
+    }
+}
+
+static void benchCheckLeft(BenchBoard *b, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        sink += checkLeft(proto[PURPLE], b->matrix);
+    }
+}
+
+static void benchCheckRight(BenchBoard *b, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        sink += checkRight(proto[PURPLE], b->matrix);
+    }
+}
+
+static void benchToggle(Color c, BenchBoard *b, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        tetrimo t = proto[c];
+        t.toggle(&t, b->matrix);
+        sink += t.current_orientation;
+    }
+}
+
+static void benchToggleRed(BenchBoard *b, uint64_t iters) { benchToggle(RED, b, iters); }
+static void benchToggleGreen(BenchBoard *b, uint64_t iters) { benchToggle(GREEN, b, iters); }
+static void benchToggleCyan(BenchBoard *b, uint64_t iters) { benchToggle(CYAN, b, iters); }
+static void benchToggleBlue(BenchBoard *b, uint64_t iters) { benchToggle(BLUE, b, iters); }
+static void benchToggleYellow(BenchBoard *b, uint64_t iters) { benchToggle(YELLOW, b, iters); }
+static void benchTogglePurple(BenchBoard *b, uint64_t iters) { benchToggle(PURPLE, b, iters); }
+static void benchToggleOrange(BenchBoard *b, uint64_t iters) { benchToggle(ORANGE, b, iters); }
+
+// Baseline for the line clear cases, which restore the board before each op.
+static void benchMatrixCopy(BenchBoard *b, uint64_t iters) {
+    bool m[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    for(uint64_t i = 0; i < iters; i++) {
+        memcpy(m, b->matrix, sizeof(m));
+        sink += m[i % (MATRIX_LENGTH-1)][0];
+    }
+}
+
+static void benchCheckLine(BenchBoard *b, uint64_t iters) {
+    bool m[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    for(uint64_t i = 0; i < iters; i++) {
+        memcpy(m, b->matrix, sizeof(m));
+        sink += checkLine(m);
+    }
+}
+
+static void benchReplaceLines(BenchBoard *b, uint64_t iters) {
+    bool m[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    for(uint64_t i = 0; i < iters; i++) {
+        memcpy(m, b->matrix, sizeof(m));
+        replaceLines(MATRIX_LENGTH-2, MATRIX_LENGTH-5, m);
+        sink += m[MATRIX_LENGTH-2][0];
+    }
+}
+
+static void benchNewBlock(BenchBoard *b, uint64_t iters) {
+    (void)b;
+    for(uint64_t i = 0; i < iters; i++) {
+        Color next = i % 7;
+        tetrimo t = newBlock((i + 1) % 7, &next, 0);
+        sink += t.current_xy[0].x;
+    }
+}
+
+static void benchEncode(BenchBoard *b, uint64_t iters) {
+    char send[FRAME_LEN];
+    memcpy(matrix_g, b->matrix, sizeof(matrix_g));
+    currentTetrimo = proto[PURPLE];
+    for(uint64_t i = 0; i < iters; i++) {
+        encodeState(send, false);
+        sink += send[i % 225];
+    }
+}
+
+static void benchDrawSecondPlayer(BenchBoard *b, uint64_t iters) {
+    char frame[FRAME_LEN];
+    memcpy(matrix_g, b->matrix, sizeof(matrix_g));
+    currentTetrimo = proto[PURPLE];
+    encodeState(frame, false);
+    for(uint64_t i = 0; i < iters; i++) {
+        drawSecondPlayer(frame, NULL);
+        sink += frame[i % 225];
+    }
+}
+
+// A whole frame as drawn after clear(): frame, settled blocks, next and held.
+static void drawScene(BenchBoard *b) {
+    render_clear();
+    drawBoard(12300, 5, 0);
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(b->matrix[i][j]) {
+                paint(i, blocktomatrix(j));
+            }
+        }
+    }
+    drawNext(PURPLE, 0);
+    drawHeld(CYAN, 0);
+    render_flush();
+}
+
+static void benchRenderFull(BenchBoard *b, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        drawScene(b);
+    }
+}
+
+// A typical gameplay frame: the piece moves one row and the score changes.
+static void benchRenderMove(BenchBoard *b, uint64_t iters) {
+    tetrimo t = proto[PURPLE];
+    drawScene(b);
+    for(uint64_t i = 0; i < iters; i++) {
+        int dy = (i % 2) ? -1 : 1;
+        for(int k = 0; k < 4; k++) {
+            t.next_xy[k].x = t.current_xy[k].x;
+            t.next_xy[k].y = t.current_xy[k].y + dy;
+        }
+        elim(t);
+        draw(t);
+        for(int k = 0; k < 4; k++) {
+            t.current_xy[k] = t.next_xy[k];
+        }
+        drawScoreLevel((int)(i % 100000), 5, 0);
+        render_flush();
+    }
+}
+
+// A 4 player local split-screen frame, every board drawn in full.
+static void benchRenderLocal(BenchBoard *b, uint64_t iters) {
+    static GameSim games[LOCAL_MAX_PLAYERS];
+    for(int p = 0; p < LOCAL_MAX_PLAYERS; p++) {
+        sim_init(&games[p], 7u + p, 5);
+        memcpy(games[p].matrix, b->matrix, sizeof(games[p].matrix));
+    }
+    render_clear();
+    local_draw_frames(LOCAL_MAX_PLAYERS);
+    for(uint64_t i = 0; i < iters; i++) {
+        games[i % LOCAL_MAX_PLAYERS].score = (int)(i % 100000);
+        local_draw(games, LOCAL_MAX_PLAYERS);
+        render_flush();
+    }
+}
+
+// One batch of boards, each the bench board with a different cell flipped so
+// the lanes don't all agree. ns/op is per batch of EVAL_BATCH boards.
+static void benchEval(EvalImpl impl, BenchBoard *b, uint64_t iters) {
+    static EvalBatch batch;
+    unsigned int seed = 99u;
+    batch.count = 0;
+    for(int k = 0; k < EVAL_BATCH; k++) {
+        uint16_t rows[MATRIX_LENGTH-1];
+        for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+            rows[i] = 0;
+            for(int j = 0; j < MATRIX_WIDTH; j++) {
+                rows[i] |= (uint16_t)b->matrix[i][j] << j;
+            }
+        }
+        rows[nextRand(&seed) % (MATRIX_LENGTH-1)] ^= 1 << (nextRand(&seed) % MATRIX_WIDTH);
+        eval_add(&batch, rows, k % 5);
+    }
+    EvalImpl was = eval_current();
+    eval_use(impl);
+    for(uint64_t i = 0; i < iters; i++) {
+        eval_batch(&batch);
+        sink += batch.features[BOT_HOLES][i % EVAL_BATCH];
+    }
+    eval_use(was);
+}
+
+static void benchEvalScalar(BenchBoard *b, uint64_t iters) { benchEval(EVAL_SCALAR, b, iters); }
+static void benchEvalSse4(BenchBoard *b, uint64_t iters) { benchEval(EVAL_SSE4, b, iters); }
+static void benchEvalAvx2(BenchBoard *b, uint64_t iters) { benchEval(EVAL_AVX2, b, iters); }
+
+static const BenchCase renderCases[] = {
+    {"renderFull", benchRenderFull, false, "render"},
+    {"renderMove", benchRenderMove, false, "render"},
+    {"renderLocal", benchRenderLocal, false, "render"},
+};
+
+static const BenchCase cases[] = {
+    {"checkDown", benchCheckDown, false, "collision"},
+    {"checkLeft", benchCheckLeft, false, "collision"},
+    {"checkRight", benchCheckRight, false, "collision"},
+    {"toggleRed", benchToggleRed, false, "rotation"},
+    {"toggleGreen", benchToggleGreen, false, "rotation"},
+    {"toggleCyan", benchToggleCyan, false, "rotation"},
+    {"toggleBlue", benchToggleBlue, false, "rotation"},
+    {"toggleYellow", benchToggleYellow, false, "rotation"},
+    {"togglePurple", benchTogglePurple, false, "rotation"},
+    {"toggleOrange", benchToggleOrange, false, "rotation"},
+    {"matrixCopy", benchMatrixCopy, true, "baseline"},
+    {"checkLine", benchCheckLine, true, "lineclear"},
+    {"replaceLines", benchReplaceLines, true, "lineclear"},
+    {"newBlock", benchNewBlock, false, "spawn"},
+    {"encodeState", benchEncode, false, "network"},
+    {"drawSecondPlayer", benchDrawSecondPlayer, false, "network"},
+};
+
+// Skipped when the cpu (or the build) doesn't have the implementation.
+static const BenchCase evalCases[] = {
+    {"evalScalar", benchEvalScalar, false, "eval"},
+    {"evalSse4", benchEvalSse4, false, "eval"},
+    {"evalAvx2", benchEvalAvx2, false, "eval"},
+};
+
+// Set by bench perf when the counters could be opened.
+static PerfGroup *perf;
+static BenchPhase phases[16];
+static int numPhases;
+static const EvalImpl evalImpls[] = {EVAL_SCALAR, EVAL_SSE4, EVAL_AVX2};
+
+static void addPhase(const char *name, const PerfCounts *perOp) {
+    int p = 0;
+    while(p < numPhases && strcmp(phases[p].name, name) != 0) {
+        p++;
+    }
+    if(p == numPhases) {
+        if(numPhases == sizeof(phases) / sizeof(phases[0])) {
+            return;
+        }
+        memset(&phases[numPhases], 0, sizeof(BenchPhase));
+        phases[numPhases++].name = name;
+    }
+    perf_add(&phases[p].perOp, perOp);
+    phases[p].results++;
+}
+
+static void runCase(const BenchCase *bc, BenchBoard *b, uint64_t iters, BenchResult *r) {
+    double samples[BENCH_SAMPLES];
+    double sum = 0;
+    bc->fn(b, iters / 10 + 1);
+    // the counters cover all samples, the warm up above stays out
+    if(perf) {
+        perf_start(perf);
+    }
+    for(int s = 0; s < BENCH_SAMPLES; s++) {
+        uint64_t start = timer_now_ns();
+        bc->fn(b, iters);
+        samples[s] = (double)(timer_now_ns() - start) / iters;
+        sum += samples[s];
+    }
+    memset(&r->perOp, 0, sizeof(r->perOp));
+    if(perf) {
+        perf_stop(perf, &r->perOp);
+        for(int i = 0; i < PERF_COUNTERS; i++) {
+            r->perOp.v[i] /= (double)BENCH_SAMPLES * iters;
+        }
+        addPhase(bc->phase, &r->perOp);
+    }
+    double mean = sum / BENCH_SAMPLES;
+    double var = 0;
+    for(int s = 0; s < BENCH_SAMPLES; s++) {
+        var += (samples[s] - mean) * (samples[s] - mean);
+    }
+    r->name = bc->name;
+    r->board = b->name;
+    r->ns_per_op = mean;
+    r->stddev = sqrt(var / (BENCH_SAMPLES - 1));
+    r->samples = BENCH_SAMPLES;
+    r->iterations = iters;
+    r->bytes_per_op = 0;
+}
+
+static void printCounts(const PerfCounts *c) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        if(c->valid[i]) {
+            printf(" %13.2f", c->v[i]);
+        } else {
+            printf(" %13s", "-");
+        }
+    }
+    if(c->valid[PERF_CYCLES] && c->valid[PERF_INSTRUCTIONS] && c->v[PERF_CYCLES] > 0) {
+        printf(" %6.2f", c->v[PERF_INSTRUCTIONS] / c->v[PERF_CYCLES]);
+    }
+}
+
+static void report(FILE *fp, BenchResult *r) {
+    printf("%-18s %-14s %12.1f %10.1f %10.1f", r->name, r->board, r->ns_per_op, r->stddev, r->bytes_per_op);
+    if(perf) {
+        printCounts(&r->perOp);
+    }
+    printf("\n");
+    if(fp) {
+        fprintf(fp, "%s,%s,%.2f,%.2f,%d,%llu,%.1f", r->name, r->board, r->ns_per_op, r->stddev,
+                r->samples, (unsigned long long)r->iterations, r->bytes_per_op);
+        for(int i = 0; perf && i < PERF_COUNTERS; i++) {
+            fprintf(fp, ",%.3f", r->perOp.valid[i] ? r->perOp.v[i] : -1.0);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+static uint64_t termBytes(RenderBackend *backend, FILE *term) {
+    if(backend == &render_mem) {
+        return 0;
+    }
+    if(backend == &render_ansi) {
+        return render_ansi_bytes();
+    }
+    fflush(term);
+    return (uint64_t)ftell(term);
+}
+
+// Times each render case against a backend writing into a temporary file,
+// the file size gives the bytes a terminal would receive per frame.
+static void runRenderCases(FILE *fp, RenderBackend *backend, BenchBoard *b, uint64_t iters) {
+    FILE *term = tmpfile();
+    if(!term) {
+        return;
+    }
+    SCREEN *scr = NULL;
+    if(backend == &render_mem) {
+        // nothing to set up, measures the cost of producing a frame alone
+    } else if(backend == &render_ansi) {
+        render_ansi_set_fd(fileno(term));
+    } else {
+        scr = newterm(getenv("TERM") ? NULL : "xterm", term, stdin);
+        if(scr == NULL) {
+            fprintf(stderr, "newterm failed, skipping %s\n", backend->name);
+            fclose(term);
+            return;
+        }
+        resizeterm(RENDER_ROWS, RENDER_COLS);
+    }
+    RenderBackend *was = render_current();
+    render_use(backend);
+    int numCases = sizeof(renderCases) / sizeof(renderCases[0]);
+    for(int c = 0; c < numCases; c++) {
+        BenchResult r;
+        uint64_t before = termBytes(backend, term);
+        runCase(&renderCases[c], b, iters, &r);
+        uint64_t ops = (iters / 10 + 1) + (BENCH_SAMPLES * iters);
+        r.board = backend->name;
+        r.bytes_per_op = (double)(termBytes(backend, term) - before) / ops;
+        report(fp, &r);
+    }
+    render_use(was);
+    if(scr) {
+        endwin();
+        delscreen(scr);
+    } else if(backend == &render_ansi) {
+        render_ansi_set_fd(STDOUT_FILENO);
+    }
+    fclose(term);
+}
+
+int bench_main(int argc, char *argv[]) {
+    uint64_t iters = 20000;
+    const char *out = BENCH_DEFAULT_OUT;
+    PerfGroup group;
+    perf = NULL;
+    numPhases = 0;
+    if(argc > 1 && strcmp(argv[1], "perf") == 0) {
+        if(perf_open(&group)) {
+            fprintf(stderr, "hardware counters not available, timing only\n");
+        } else {
+            perf = &group;
+        }
+        argc--;
+        argv++;
+    }
+    if(argc > 1) {
+        iters = strtoull(argv[1], NULL, 10);
+        if(iters == 0) {
+            iters = 1;
+        }
+    }
+    if(argc > 2) {
+        out = argv[2];
+    } else {
+        mkdir("data");
+    }
+
+    static BenchBoard boards[] = {
+        {"empty", 0, {{false}}},
+        {"quarter", 25, {{false}}},
+        {"half", 50, {{false}}},
+        {"three_quarter", 75, {{false}}},
+        {"nearly_full", 92, {{false}}},
+    };
+    static BenchBoard lines = {"four_lines", 50, {{false}}};
+    int numBoards = sizeof(boards) / sizeof(boards[0]);
+    for(int i = 0; i < numBoards; i++) {
+        bench_make_board(boards[i].matrix, boards[i].fill, 0, 1234u + i);
+    }
+    bench_make_board(lines.matrix, lines.fill, 4, 4321u);
+
+    bool wasHeadless = headless;
+    headless = true;
+    makeProtos();
+
+    FILE *fp = fopen(out, "w+");
+    if(fp) {
+        fputs("name,board,ns_per_op,stddev,samples,iterations,bytes_per_op", fp);
+        for(int i = 0; perf && i < PERF_COUNTERS; i++) {
+            fprintf(fp, ",%s_per_op", perf_names[i]);
+        }
+        fputs("\n", fp);
+    }
+    printf("%-18s %-14s %12s %10s %10s", "name", "board", "ns/op", "stddev", "bytes/op");
+    for(int i = 0; perf && i < PERF_COUNTERS; i++) {
+        printf(" %13s", perf_names[i]);
+    }
+    printf(perf ? " %6s\n" : "\n", "ipc");
+    int numCases = sizeof(cases) / sizeof(cases[0]);
+    for(int c = 0; c < numCases; c++) {
+        for(int i = 0; i < numBoards; i++) {
+            BenchBoard *b = cases[c].lines ? &lines : &boards[i];
+            BenchResult r;
+            runCase(&cases[c], b, iters, &r);
+            report(fp, &r);
+            if(cases[c].lines) {
+                break;
+            }
+        }
+    }
+    int numEval = sizeof(evalCases) / sizeof(evalCases[0]);
+    for(int c = 0; c < numEval; c++) {
+        if(!eval_supported(evalImpls[c])) {
+            printf("%-18s not supported here, skipped\n", evalCases[c].name);
+            continue;
+        }
+        for(int i = 0; i < numBoards; i++) {
+            BenchResult r;
+            runCase(&evalCases[c], &boards[i], iters, &r);
+            report(fp, &r);
+        }
+    }
+
+    headless = false;
+    // the ANSI backend sizes itself from stdscr, so run it before curses exists
+    runRenderCases(fp, &render_mem, &boards[2], iters / 20 + 1);
+    runRenderCases(fp, &render_ansi, &boards[2], iters / 20 + 1);
+    runRenderCases(fp, &render_ncurses, &boards[2], iters / 20 + 1);
+    if(fp) {
+        fclose(fp);
+    } else {
+        fprintf(stderr, "unable to open %s\n", out);
+    }
+    if(perf) {
+        printf("\nper op, averaged over each phase's cases and boards\n%-18s", "phase");
+        for(int i = 0; i < PERF_COUNTERS; i++) {
+            printf(" %13s", perf_names[i]);
+        }
+        printf(" %6s\n", "ipc");
+        for(int p = 0; p < numPhases; p++) {
+            PerfCounts mean = phases[p].perOp;
+            for(int i = 0; i < PERF_COUNTERS; i++) {
+                mean.v[i] /= phases[p].results;
+            }
+            printf("%-18s", phases[p].name);
+            printCounts(&mean);
+            printf("\n");
+        }
+        perf_close(perf);
+        perf = NULL;
+    }
+    initMatrix(matrix_g);
+    headless = wasHeadless;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+
+#include "tetris.h"
+#include "perfctr.h"
+
+#define BENCH_SAMPLES 15
+#define BENCH_DEFAULT_OUT "data/bench.csv"
+
+// A board used by the benchmarks, fill is the percentage of rows (from the
+// bottom) that hold blocks.
+typedef struct BenchBoard {
+    const char *name;
+    int fill;
+    bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH];
+} BenchBoard;
+
+typedef struct BenchResult {
+    const char *name;
+    const char *board;
+    double ns_per_op;
+    double stddev;
+    int samples;
+    uint64_t iterations;
+    double bytes_per_op;
+    PerfCounts perOp;                    // only with bench perf
+} BenchResult;
+
+// Fills matrix with a reproducible board, every filled row keeps one hole so
+// no lines clear unless full_lines rows at the bottom are requested.
+void bench_make_board(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], int fill, int full_lines, unsigned int seed);
+
+// Command line entry: bench [perf] [iterations] [outfile]
+int bench_main(int argc, char *argv[]);
+
+#endif
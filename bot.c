@@ -0,0 +1,173 @@
+#include <float.h>
+
+#include "bot.h"
+#include "eval.h"
+
+#define SEARCH_BYTES(depth) \
+    ((depth) * (4 * MATRIX_WIDTH * sizeof(GameSim) + ARENA_ALIGN) + sizeof(EvalBatch) + ARENA_ALIGN)
+
+// Weights in the spirit of the well known four feature player, rescaled for
+// the 9 wide board.
+const BotWeights bot_default_weights = {{
+    [BOT_HEIGHT] = -0.51,
+    [BOT_HOLES] = -0.36,
+    [BOT_BUMPINESS] = -0.18,
+    [BOT_LINES] = 0.76,
+    [BOT_WELLS] = -0.05,
+    [BOT_TRANSITIONS] = 0,
+}};
+
+const char *bot_feature_names[BOT_FEATURES] = {
+    "height",
+    "holes",
+    "bumpiness",
+    "lines",
+    "wells",
+    "transitions",
+};
+
+void bot_features(const uint16_t rows[MATRIX_LENGTH-1], int lines, double f[BOT_FEATURES]) {
+    int heights[MATRIX_WIDTH];
+    int holes = 0;
+    int transitions = 0;
+    uint16_t seen = 0;
+    for(int j = 0; j < MATRIX_WIDTH; j++) {
+        heights[j] = 0;
+    }
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        uint16_t row = rows[i];
+        uint16_t fresh = row & ~seen;
+        // columns already covered from above that are empty here
+        holes += __builtin_popcount(seen & ~row);
+        seen |= row;
+        // bits 0 and 10 are the walls
+        uint16_t ext = (uint16_t)(row << 1) | 0x401;
+        transitions += __builtin_popcount((ext ^ (ext >> 1)) & 0x3ff);
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(fresh & (1 << j)) {
+                heights[j] = MATRIX_LENGTH-1 - i;
+            }
+        }
+    }
+    int height = 0;
+    int bumpiness = 0;
+    int wells = 0;
+    for(int j = 0; j < MATRIX_WIDTH; j++) {
+        height += heights[j];
+        if(j > 0) {
+            int d = heights[j] - heights[j-1];
+            bumpiness += d < 0 ? -d : d;
+        }
+        int left = j > 0 ? heights[j-1] : MATRIX_LENGTH-1;
+        int right = j < MATRIX_WIDTH-1 ? heights[j+1] : MATRIX_LENGTH-1;
+        int wall = left < right ? left : right;
+        if(wall > heights[j]) {
+            wells += wall - heights[j];
+        }
+    }
+    f[BOT_HEIGHT] = height;
+    f[BOT_HOLES] = holes;
+    f[BOT_BUMPINESS] = bumpiness;
+    f[BOT_LINES] = lines;
+    f[BOT_WELLS] = wells;
+    f[BOT_TRANSITIONS] = transitions;
+}
+
+static void packRows(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], uint16_t rows[MATRIX_LENGTH-1]) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        uint16_t row = 0;
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            row |= (uint16_t)matrix[i][j] << j;
+        }
+        rows[i] = row;
+    }
+}
+
+// Best score over the placements of g's falling piece, -DBL_MAX if there are
+// none or the arena ran out. Every reachable placement of the last ply goes
+// into one batch so the features are worked out together; earlier plies
+// recurse with the piece that follows. Scores are compared in rotation then
+// column order so ties go to the first one. The children and the batch come
+// from the arena and are dropped again before returning.
+static double search(const GameSim *g, const BotWeights *w, int depth, int lines, Arena *a, BotMove *move) {
+    size_t mark = arena_mark(a);
+    GameSim *next = arena_alloc(a, 4 * MATRIX_WIDTH * sizeof(GameSim));
+    EvalBatch *batch = depth == 1 ? arena_alloc(a, sizeof(EvalBatch)) : NULL;
+    if(next == NULL || (depth == 1 && batch == NULL)) {
+        arena_release(a, mark);
+        return -DBL_MAX;
+    }
+    // lane in the batch, or the child's score one ply down
+    int lane[4][MATRIX_WIDTH];
+    double score[4][MATRIX_WIDTH];
+    if(batch) {
+        batch->count = 0;
+    }
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < MATRIX_WIDTH; c++) {
+            GameSim *child = &next[r * MATRIX_WIDTH + c];
+            *child = *g;
+            int cleared = sim_place(child, r, c);
+            lane[r][c] = -1;
+            score[r][c] = -DBL_MAX;
+            if(cleared < 0) {
+                continue;
+            }
+            score[r][c] = -DBL_MAX / 2;
+            if(child->over) {
+                continue;
+            }
+            if(depth > 1) {
+                double s = search(child, w, depth - 1, lines + cleared, a, NULL);
+                if(s > score[r][c]) {
+                    score[r][c] = s;
+                }
+            } else {
+                uint16_t rows[MATRIX_LENGTH-1];
+                packRows(child->matrix, rows);
+                lane[r][c] = eval_add(batch, rows, lines + cleared);
+            }
+        }
+    }
+    if(batch) {
+        eval_batch(batch);
+    }
+
+    double best = -DBL_MAX;
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < MATRIX_WIDTH; c++) {
+            double s = lane[r][c] >= 0 ? eval_score(batch, lane[r][c], w) : score[r][c];
+            if(s == -DBL_MAX) {
+                continue;
+            }
+            if(best == -DBL_MAX || s > best) {
+                best = s;
+                if(move) {
+                    move->rotations = r;
+                    move->column = c;
+                    move->score = s;
+                }
+            }
+        }
+    }
+    arena_release(a, mark);
+    return best;
+}
+
+size_t bot_search_bytes(int depth) {
+    return SEARCH_BYTES(depth < 1 ? 1 : depth);
+}
+
+int bot_search(const GameSim *g, const BotWeights *w, int depth, Arena *nodes, BotMove *move) {
+    move->score = -DBL_MAX;
+    move->rotations = 0;
+    move->column = 0;
+    return search(g, w, depth < 1 ? 1 : depth, 0, nodes, move) == -DBL_MAX ? 1 : 0;
+}
+
+int bot_choose(const GameSim *g, const BotWeights *w, BotMove *move) {
+    unsigned char buffer[SEARCH_BYTES(1)];
+    Arena a;
+    arena_wrap(&a, buffer, sizeof(buffer));
+    return bot_search(g, w, 1, &a, move);
+}
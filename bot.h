@@ -0,0 +1,52 @@
+#ifndef BOT_H_
+#define BOT_H_
+
+#include <stdint.h>
+
+#include "sim.h"
+#include "arena.h"
+
+// Board features the bot scores a placement with, all taken after the lines
+// it clears are removed.
+typedef enum {
+    BOT_HEIGHT,      // sum of column heights
+    BOT_HOLES,       // empty cells with a block somewhere above them
+    BOT_BUMPINESS,   // sum of height differences between neighbouring columns
+    BOT_LINES,       // lines cleared by the placement
+    BOT_WELLS,       // sum of well depths, columns lower than both neighbours
+    BOT_TRANSITIONS, // filled/empty changes along each row, walls count as filled
+    BOT_FEATURES
+} BotFeature;
+
+typedef struct BotWeights {
+    double w[BOT_FEATURES];
+} BotWeights;
+
+typedef struct BotMove {
+    int rotations;
+    int column;
+    double score;
+} BotMove;
+
+extern const BotWeights bot_default_weights;
+
+extern const char *bot_feature_names[BOT_FEATURES];
+
+// Fills f from a bit-packed board (bit j of rows[i] is column j of row i).
+void bot_features(const uint16_t rows[MATRIX_LENGTH-1], int lines, double f[BOT_FEATURES]);
+
+// Tries every rotation and column for the falling piece and returns the best
+// scoring one in move, 1 if no placement is possible.
+int bot_choose(const GameSim *g, const BotWeights *w, BotMove *move);
+
+// Arena room bot_search needs for a given depth, each ply keeps a copy of the
+// game per placement and the last one a batch.
+size_t bot_search_bytes(int depth);
+
+// bot_choose looking depth pieces ahead (the falling one, then the next and
+// so on), scoring the board after the last one with the lines of all of them.
+// Copies come from nodes, which is left as it was found. Returns 1 if no
+// placement is possible or nodes is too small.
+int bot_search(const GameSim *g, const BotWeights *w, int depth, Arena *nodes, BotMove *move);
+
+#endif
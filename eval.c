@@ -0,0 +1,352 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EVAL_X86 1
+// MinGW's gcc doesn't keep the stack 32 byte aligned for spilled ymm
+// registers (gcc bug 54412), so Windows builds stop at SSE4.
+#ifndef _WIN32
+#define EVAL_HAS_AVX2 1
+#endif
+#endif
+
+const char *eval_impl_names[EVAL_IMPLS] = {
+    "auto",
+    "scalar",
+    "sse4",
+    "avx2",
+};
+
+static atomic_int active = EVAL_AUTO;
+
+int eval_add(EvalBatch *b, const uint16_t rows[MATRIX_LENGTH-1], int lines) {
+    if(b->count >= EVAL_BATCH) {
+        return -1;
+    }
+    int lane = b->count++;
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        b->rows[i][lane] = rows[i];
+    }
+    b->lines[lane] = (uint8_t)lines;
+    return lane;
+}
+
+double eval_score(const EvalBatch *b, int lane, const BotWeights *w) {
+    double score = 0;
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        score += w->w[k] * b->features[k][lane];
+    }
+    return score;
+}
+
+// One board at a time through bot_features, the reference the vector
+// versions have to match.
+static void batchScalar(EvalBatch *b) {
+    for(int lane = 0; lane < b->count; lane++) {
+        uint16_t rows[MATRIX_LENGTH-1];
+        double f[BOT_FEATURES];
+        for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+            rows[i] = b->rows[i][lane];
+        }
+        bot_features(rows, b->lines[lane], f);
+        for(int k = 0; k < BOT_FEATURES; k++) {
+            b->features[k][lane] = (int16_t)f[k];
+        }
+    }
+}
+
+#ifdef EVAL_X86
+// Set bits in each 16 bit lane, nibbles looked up with pshufb and the two
+// byte counts added.
+__attribute__((target("sse4.1")))
+static inline __m128i popcount8x16(__m128i x) {
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low = _mm_set1_epi8(0x0f);
+    __m128i c = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(x, low)),
+                             _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), low)));
+    return _mm_add_epi16(_mm_and_si128(c, _mm_set1_epi16(0xff)), _mm_srli_epi16(c, 8));
+}
+
+// Eight boards per pass, one 16 bit lane each. Walking down the rows, a
+// column's height is set the first time a block turns up in it and every
+// empty cell under an already seen column is a hole.
+__attribute__((target("sse4.1")))
+static void batchSse4(EvalBatch *b) {
+    const __m128i walls = _mm_set1_epi16(0x401);
+    const __m128i inside = _mm_set1_epi16(0x3ff);
+    const __m128i edge = _mm_set1_epi16(MATRIX_LENGTH-1);
+    for(int k = 0; k < b->count; k += 8) {
+        __m128i heights[MATRIX_WIDTH];
+        __m128i seen = _mm_setzero_si128();
+        __m128i holes = _mm_setzero_si128();
+        __m128i transitions = _mm_setzero_si128();
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            heights[j] = _mm_setzero_si128();
+        }
+        for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+            __m128i row = _mm_load_si128((const __m128i *)&b->rows[i][k]);
+            __m128i fresh = _mm_andnot_si128(seen, row);
+            holes = _mm_add_epi16(holes, popcount8x16(_mm_andnot_si128(row, seen)));
+            seen = _mm_or_si128(seen, row);
+            // walls on both sides, then one bit per neighbouring pair that differs
+            __m128i ext = _mm_or_si128(_mm_slli_epi16(row, 1), walls);
+            __m128i edges = _mm_and_si128(_mm_xor_si128(ext, _mm_srli_epi16(ext, 1)), inside);
+            transitions = _mm_add_epi16(transitions, popcount8x16(edges));
+            __m128i h = _mm_set1_epi16(MATRIX_LENGTH-1 - i);
+            for(int j = 0; j < MATRIX_WIDTH; j++) {
+                __m128i bit = _mm_set1_epi16(1 << j);
+                __m128i hit = _mm_cmpeq_epi16(_mm_and_si128(fresh, bit), bit);
+                heights[j] = _mm_or_si128(heights[j], _mm_and_si128(hit, h));
+            }
+        }
+        __m128i height = _mm_setzero_si128();
+        __m128i bumpiness = _mm_setzero_si128();
+        __m128i wells = _mm_setzero_si128();
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            height = _mm_add_epi16(height, heights[j]);
+            if(j > 0) {
+                __m128i d = _mm_or_si128(_mm_subs_epu16(heights[j], heights[j-1]),
+                                         _mm_subs_epu16(heights[j-1], heights[j]));
+                bumpiness = _mm_add_epi16(bumpiness, d);
+            }
+            __m128i left = j > 0 ? heights[j-1] : edge;
+            __m128i right = j < MATRIX_WIDTH-1 ? heights[j+1] : edge;
+            wells = _mm_add_epi16(wells, _mm_subs_epu16(_mm_min_epu16(left, right), heights[j]));
+        }
+        __m128i lines = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)&b->lines[k]));
+        _mm_store_si128((__m128i *)&b->features[BOT_HEIGHT][k], height);
+        _mm_store_si128((__m128i *)&b->features[BOT_HOLES][k], holes);
+        _mm_store_si128((__m128i *)&b->features[BOT_BUMPINESS][k], bumpiness);
+        _mm_store_si128((__m128i *)&b->features[BOT_LINES][k], lines);
+        _mm_store_si128((__m128i *)&b->features[BOT_WELLS][k], wells);
+        _mm_store_si128((__m128i *)&b->features[BOT_TRANSITIONS][k], transitions);
+    }
+}
+#endif
+
+#ifdef EVAL_HAS_AVX2
+__attribute__((target("avx2")))
+static inline __m256i popcount16x16(__m256i x) {
+    // pshufb looks up within each 128 bit half, so the table is repeated
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+                                _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+    return _mm256_add_epi16(_mm256_and_si256(c, _mm256_set1_epi16(0xff)), _mm256_srli_epi16(c, 8));
+}
+
+// Same as batchSse4, sixteen boards at a time.
+__attribute__((target("avx2")))
+static void batchAvx2(EvalBatch *b) {
+    const __m256i walls = _mm256_set1_epi16(0x401);
+    const __m256i inside = _mm256_set1_epi16(0x3ff);
+    const __m256i edge = _mm256_set1_epi16(MATRIX_LENGTH-1);
+    for(int k = 0; k < b->count; k += 16) {
+        __m256i heights[MATRIX_WIDTH];
+        __m256i seen = _mm256_setzero_si256();
+        __m256i holes = _mm256_setzero_si256();
+        __m256i transitions = _mm256_setzero_si256();
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            heights[j] = _mm256_setzero_si256();
+        }
+        for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+            __m256i row = _mm256_load_si256((const __m256i *)&b->rows[i][k]);
+            __m256i fresh = _mm256_andnot_si256(seen, row);
+            holes = _mm256_add_epi16(holes, popcount16x16(_mm256_andnot_si256(row, seen)));
+            seen = _mm256_or_si256(seen, row);
+            __m256i ext = _mm256_or_si256(_mm256_slli_epi16(row, 1), walls);
+            __m256i edges = _mm256_and_si256(_mm256_xor_si256(ext, _mm256_srli_epi16(ext, 1)), inside);
+            transitions = _mm256_add_epi16(transitions, popcount16x16(edges));
+            __m256i h = _mm256_set1_epi16(MATRIX_LENGTH-1 - i);
+            for(int j = 0; j < MATRIX_WIDTH; j++) {
+                __m256i bit = _mm256_set1_epi16(1 << j);
+                __m256i hit = _mm256_cmpeq_epi16(_mm256_and_si256(fresh, bit), bit);
+                heights[j] = _mm256_or_si256(heights[j], _mm256_and_si256(hit, h));
+            }
+        }
+        __m256i height = _mm256_setzero_si256();
+        __m256i bumpiness = _mm256_setzero_si256();
+        __m256i wells = _mm256_setzero_si256();
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            height = _mm256_add_epi16(height, heights[j]);
+            if(j > 0) {
+                __m256i d = _mm256_or_si256(_mm256_subs_epu16(heights[j], heights[j-1]),
+                                            _mm256_subs_epu16(heights[j-1], heights[j]));
+                bumpiness = _mm256_add_epi16(bumpiness, d);
+            }
+            __m256i left = j > 0 ? heights[j-1] : edge;
+            __m256i right = j < MATRIX_WIDTH-1 ? heights[j+1] : edge;
+            wells = _mm256_add_epi16(wells, _mm256_subs_epu16(_mm256_min_epu16(left, right), heights[j]));
+        }
+        __m256i lines = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&b->lines[k]));
+        _mm256_store_si256((__m256i *)&b->features[BOT_HEIGHT][k], height);
+        _mm256_store_si256((__m256i *)&b->features[BOT_HOLES][k], holes);
+        _mm256_store_si256((__m256i *)&b->features[BOT_BUMPINESS][k], bumpiness);
+        _mm256_store_si256((__m256i *)&b->features[BOT_LINES][k], lines);
+        _mm256_store_si256((__m256i *)&b->features[BOT_WELLS][k], wells);
+        _mm256_store_si256((__m256i *)&b->features[BOT_TRANSITIONS][k], transitions);
+    }
+}
+#endif
+
+int eval_supported(EvalImpl impl) {
+    switch(impl) {
+    case EVAL_AUTO:
+    case EVAL_SCALAR:
+        return 1;
+#ifdef EVAL_X86
+    case EVAL_SSE4:
+        return __builtin_cpu_supports("sse4.1");
+#endif
+#ifdef EVAL_HAS_AVX2
+    case EVAL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+int eval_use(EvalImpl impl) {
+    if(impl == EVAL_AUTO) {
+        impl = eval_supported(EVAL_AVX2) ? EVAL_AVX2 : eval_supported(EVAL_SSE4) ? EVAL_SSE4 : EVAL_SCALAR;
+    }
+    if(!eval_supported(impl)) {
+        return 1;
+    }
+    atomic_store(&active, impl);
+    return 0;
+}
+
+EvalImpl eval_current(void) {
+    if(atomic_load(&active) == EVAL_AUTO) {
+        eval_use(EVAL_AUTO);
+    }
+    return (EvalImpl)atomic_load(&active);
+}
+
+void eval_batch(EvalBatch *b) {
+    switch(eval_current()) {
+#ifdef EVAL_HAS_AVX2
+    case EVAL_AVX2:
+        batchAvx2(b);
+        break;
+#endif
+#ifdef EVAL_X86
+    case EVAL_SSE4:
+        batchSse4(b);
+        break;
+#endif
+    default:
+        batchScalar(b);
+        break;
+    }
+}
+
+static unsigned int nextRand(unsigned int *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7fff;
+}
+
+// Stacks of random height with holes in them, now and then pure noise or
+// full rows, so every feature sees its edge cases.
+static void randomBoard(unsigned int *seed, uint16_t rows[MATRIX_LENGTH-1]) {
+    uint16_t full = (1u << MATRIX_WIDTH) - 1;
+    int style = nextRand(seed) % 8;
+    memset(rows, 0, (MATRIX_LENGTH-1) * sizeof(uint16_t));
+    if(style == 0) {
+        return;
+    }
+    if(style == 1) {
+        for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+            rows[i] = nextRand(seed) & full;
+        }
+        return;
+    }
+    for(int j = 0; j < MATRIX_WIDTH; j++) {
+        int height = nextRand(seed) % MATRIX_LENGTH;
+        for(int i = MATRIX_LENGTH-1 - height; i < MATRIX_LENGTH-1; i++) {
+            if(nextRand(seed) % 6 != 0) {
+                rows[i] |= 1u << j;
+            }
+        }
+    }
+    if(style == 2) {
+        rows[MATRIX_LENGTH-2 - nextRand(seed) % 4] = full;
+    }
+}
+
+// Runs every implementation the cpu has over the same random batches and
+// compares each lane's features with bot_features. Returns the number of
+// lanes that differ.
+static int verify(int batches, unsigned int seed) {
+    static EvalBatch batch;
+    static int16_t want[BOT_FEATURES][EVAL_BATCH];
+    int bad[EVAL_IMPLS] = {0};
+    EvalImpl was = eval_current();
+    for(int n = 0; n < batches; n++) {
+        // partial batches too, so the lanes past count are never read
+        int count = n % 4 == 3 ? 1 + (int)(nextRand(&seed) % EVAL_BATCH) : EVAL_BATCH;
+        batch.count = 0;
+        for(int lane = 0; lane < count; lane++) {
+            uint16_t rows[MATRIX_LENGTH-1];
+            double f[BOT_FEATURES];
+            int lines = nextRand(&seed) % 5;
+            randomBoard(&seed, rows);
+            eval_add(&batch, rows, lines);
+            bot_features(rows, lines, f);
+            for(int k = 0; k < BOT_FEATURES; k++) {
+                want[k][lane] = (int16_t)f[k];
+            }
+        }
+        for(int impl = EVAL_SCALAR; impl < EVAL_IMPLS; impl++) {
+            if(!eval_supported(impl)) {
+                continue;
+            }
+            eval_use(impl);
+            memset(batch.features, 0x55, sizeof(batch.features));
+            eval_batch(&batch);
+            for(int lane = 0; lane < count; lane++) {
+                for(int k = 0; k < BOT_FEATURES; k++) {
+                    if(batch.features[k][lane] == want[k][lane]) {
+                        continue;
+                    }
+                    if(bad[impl]++ == 0) {
+                        printf("%s batch %d lane %d %s: %d, bot_features %d\n", eval_impl_names[impl], n, lane,
+                               bot_feature_names[k], batch.features[k][lane], want[k][lane]);
+                    }
+                }
+            }
+        }
+    }
+    eval_use(was);
+    int total = 0;
+    for(int impl = EVAL_SCALAR; impl < EVAL_IMPLS; impl++) {
+        if(!eval_supported(impl)) {
+            printf("%-7s not supported here, skipped\n", eval_impl_names[impl]);
+        } else if(bad[impl]) {
+            printf("%-7s %d features differ\n", eval_impl_names[impl], bad[impl]);
+        } else {
+            printf("%-7s ok, %d batches\n", eval_impl_names[impl], batches);
+        }
+        total += bad[impl];
+    }
+    return total;
+}
+
+// usage: tetris eval verify [batches] [seed]
+int eval_main(int argc, char *argv[]) {
+    if(argc < 2 || strcmp(argv[1], "verify") != 0) {
+        fprintf(stderr, "usage: eval verify [batches] [seed]\n");
+        return EXIT_FAILURE;
+    }
+    int batches = argc > 2 ? atoi(argv[2]) : 2000;
+    unsigned int seed = argc > 3 ? (unsigned int)atoi(argv[3]) : 1u;
+    return verify(batches > 0 ? batches : 1, seed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
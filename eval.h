@@ -0,0 +1,51 @@
+#ifndef EVAL_H_
+#define EVAL_H_
+
+#include <stdint.h>
+
+#include "bot.h"
+
+// Boards scored in one call, enough for every rotation and column of a piece.
+#define EVAL_BATCH 64
+
+typedef enum {
+    EVAL_AUTO,          // best the cpu supports
+    EVAL_SCALAR,
+    EVAL_SSE4,
+    EVAL_AVX2,
+    EVAL_IMPLS
+} EvalImpl;
+
+// Boards stored lane by lane: rows[i][k] is row i of board k, bit j set when
+// column j is filled, so one vector load holds the same row of 8 or 16
+// boards. Lanes past count are ignored.
+typedef struct EvalBatch {
+    _Alignas(32) uint16_t rows[MATRIX_LENGTH-1][EVAL_BATCH];
+    _Alignas(32) int16_t features[BOT_FEATURES][EVAL_BATCH];
+    uint8_t lines[EVAL_BATCH];
+    int count;
+} EvalBatch;
+
+extern const char *eval_impl_names[EVAL_IMPLS];
+
+// Adds a board (bit-packed like PackedState rows) and returns its lane, -1
+// when the batch is full.
+int eval_add(EvalBatch *b, const uint16_t rows[MATRIX_LENGTH-1], int lines);
+
+// Fills features for every board in the batch, the same values bot_features
+// gives one board at a time.
+void eval_batch(EvalBatch *b);
+
+// Weighted sum of a lane's features.
+double eval_score(const EvalBatch *b, int lane, const BotWeights *w);
+
+int eval_supported(EvalImpl impl);
+
+// Picks the implementation eval_batch uses, returns 1 if the cpu lacks it.
+int eval_use(EvalImpl impl);
+
+EvalImpl eval_current(void);
+
+int eval_main(int argc, char *argv[]);
+
+#endif
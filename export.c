@@ -0,0 +1,431 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "export.h"
+#include "bot.h"
+#include "perfctr.h"
+#include "replay.h"
+#include "scores.h"
+#include "state.h"
+#include "timer.h"
+
+#define EXPORT_MAX_THREADS 64
+
+static const struct {
+    const char *name;
+    uint32_t width;
+} layout[EXPORT_COLUMNS] = {
+    [EXPORT_BOARD] = {"board", sizeof(uint16_t) * (MATRIX_LENGTH-1)},
+    [EXPORT_PIECE] = {"piece", 1},
+    [EXPORT_NEXT] = {"next", 1},
+    [EXPORT_HELD] = {"held", 1},
+    [EXPORT_ROTATION] = {"rotation", 1},
+    [EXPORT_COLUMN] = {"column", 1},
+    [EXPORT_LINES] = {"lines", 1},
+    [EXPORT_SCORE] = {"score", 4},
+    [EXPORT_REMAINING] = {"remaining", 4},
+};
+
+static uint32_t alignUp(uint32_t n, uint32_t to) {
+    return (n + to - 1) / to * to;
+}
+
+int export_open(ExportFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    ExportHeader *h = &f->header;
+    memcpy(h->magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+    h->version = EXPORT_VERSION;
+    h->headerBytes = EXPORT_HEADER_BYTES;
+    h->blockRows = EXPORT_BLOCK_ROWS;
+    h->columnCount = EXPORT_COLUMNS;
+    // the row count takes the first EXPORT_ALIGN bytes of every block
+    uint32_t offset = EXPORT_ALIGN;
+    for(int c = 0; c < EXPORT_COLUMNS; c++) {
+        strncpy(h->columns[c].name, layout[c].name, sizeof(h->columns[c].name) - 1);
+        h->columns[c].offset = offset;
+        h->columns[c].width = layout[c].width;
+        offset += alignUp(h->blockRows * layout[c].width, EXPORT_ALIGN);
+    }
+    h->blockBytes = alignUp(offset, EXPORT_HEADER_BYTES);
+
+    f->fp = fopen(path, "wb");
+    if(!f->fp) {
+        return 1;
+    }
+    char zero[EXPORT_HEADER_BYTES] = {0};
+    if(fwrite(zero, sizeof(zero), 1, f->fp) != 1) {
+        fclose(f->fp);
+        return 1;
+    }
+    pthread_mutex_init(&f->lock, NULL);
+    return 0;
+}
+
+int export_close(ExportFile *f) {
+    int err = fseek(f->fp, 0, SEEK_SET) != 0 || fwrite(&f->header, sizeof(ExportHeader), 1, f->fp) != 1;
+    err |= fclose(f->fp) != 0;
+    pthread_mutex_destroy(&f->lock);
+    return err;
+}
+
+int export_block_init(ExportBlock *b, ExportFile *f) {
+    b->data = calloc(1, f->header.blockBytes);
+    b->rows = 0;
+    return b->data == NULL;
+}
+
+void export_block_free(ExportBlock *b) {
+    free(b->data);
+    b->data = NULL;
+}
+
+int export_flush(ExportFile *f, ExportBlock *b) {
+    if(b->rows == 0) {
+        return 0;
+    }
+    memcpy(b->data, &b->rows, sizeof(b->rows));
+    pthread_mutex_lock(&f->lock);
+    int err = fwrite(b->data, f->header.blockBytes, 1, f->fp) != 1;
+    if(!err) {
+        f->header.blocks++;
+        f->header.rows += b->rows;
+    }
+    pthread_mutex_unlock(&f->lock);
+    b->rows = 0;
+    return err;
+}
+
+int export_append(ExportFile *f, ExportBlock *b, const ExportRow *rows, uint32_t count) {
+    const ExportColumn *col = f->header.columns;
+    for(uint32_t i = 0; i < count; i++) {
+        const ExportRow *row = &rows[i];
+        uint32_t r = b->rows;
+        memcpy(b->data + col[EXPORT_BOARD].offset + r * sizeof(row->board), row->board, sizeof(row->board));
+        b->data[col[EXPORT_PIECE].offset + r] = row->piece;
+        b->data[col[EXPORT_NEXT].offset + r] = row->next;
+        b->data[col[EXPORT_HELD].offset + r] = row->held;
+        b->data[col[EXPORT_ROTATION].offset + r] = row->rotation;
+        b->data[col[EXPORT_COLUMN].offset + r] = row->column;
+        b->data[col[EXPORT_LINES].offset + r] = row->lines;
+        memcpy(b->data + col[EXPORT_SCORE].offset + r * 4, &row->score, 4);
+        memcpy(b->data + col[EXPORT_REMAINING].offset + r * 4, &row->remaining, 4);
+        if(++b->rows == f->header.blockRows && export_flush(f, b)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Rows of the game in progress, kept until its outcome is known.
+typedef struct GameRows {
+    ExportRow *rows;
+    uint32_t count;
+    uint32_t cap;
+} GameRows;
+
+static ExportRow *addRow(GameRows *gr, const GameSim *g) {
+    if(gr->count == gr->cap) {
+        uint32_t cap = gr->cap ? gr->cap * 2 : 1024;
+        ExportRow *rows = realloc(gr->rows, cap * sizeof(ExportRow));
+        if(rows == NULL) {
+            return NULL;
+        }
+        gr->rows = rows;
+        gr->cap = cap;
+    }
+    ExportRow *row = &gr->rows[gr->count++];
+    PackedState p;
+    state_pack(&p, g);
+    memcpy(row->board, p.rows, sizeof(row->board));
+    row->piece = g->t.color;
+    row->next = g->next;
+    row->held = g->heldExists ? g->held : EXPORT_NO_HELD;
+    return row;
+}
+
+static void setPlacement(ExportRow *row, const GameSim *g, int lines) {
+    int x = g->locked.current_xy[0].x;
+    for(int i = 1; i < 4; i++) {
+        if(g->locked.current_xy[i].x < x) {
+            x = g->locked.current_xy[i].x;
+        }
+    }
+    row->rotation = g->locked.current_orientation;
+    row->column = matrixtoblock(x);
+    row->lines = lines;
+}
+
+static int finishGame(ExportFile *f, ExportBlock *b, GameRows *gr, const GameSim *g, uint64_t *writeNs) {
+    for(uint32_t i = 0; i < gr->count; i++) {
+        gr->rows[i].score = g->score;
+        gr->rows[i].remaining = gr->count - 1 - i;
+    }
+    uint64_t start = timer_now_ns();
+    int err = export_append(f, b, gr->rows, gr->count);
+    *writeNs += timer_now_ns() - start;
+    gr->count = 0;
+    return err;
+}
+
+typedef struct SimJob {
+    ExportFile *file;
+    atomic_uint next;
+    unsigned int games;
+    unsigned int seed;
+    uint32_t maxPieces;
+    int depth;
+    atomic_int errors;
+    atomic_ullong writeNs;
+    atomic_ullong arenaPeak;
+    ScoreStore *scores;                  // NULL if it couldn't be opened
+    bool perf;                           // count cycles, misses... per worker
+    pthread_mutex_t perfLock;
+    PerfCounts counts;                   // all workers added up
+    PerfPhases phases;                   // and split by engine phase
+    int counted;                         // workers that had counters
+} SimJob;
+
+static void *simWorker(void *arg) {
+    SimJob *job = (SimJob *)arg;
+    ExportBlock block;
+    GameRows gr = {NULL, 0, 0};
+    Arena nodes;
+    uint64_t writeNs = 0;
+    if(export_block_init(&block, job->file)) {
+        atomic_fetch_add(&job->errors, 1);
+        return NULL;
+    }
+    if(arena_init(&nodes, bot_search_bytes(job->depth))) {
+        export_block_free(&block);
+        atomic_fetch_add(&job->errors, 1);
+        return NULL;
+    }
+    PerfGroup group;
+    PerfPhases phases;
+    bool counting = job->perf && perf_open(&group) == 0;
+    if(counting) {
+        perf_start(&group);
+        perf_phases_init(&phases, &group);
+        perfPhases = &phases;
+    }
+    unsigned int game;
+    while((game = atomic_fetch_add(&job->next, 1)) < job->games) {
+        GameSim g;
+        BotMove move;
+        sim_init(&g, job->seed + game, 1);
+        while(!g.over && g.pieces < job->maxPieces
+              && bot_search(&g, &bot_default_weights, job->depth, &nodes, &move) == 0) {
+            ExportRow *row = addRow(&gr, &g);
+            if(row == NULL) {
+                break;
+            }
+            int lines = sim_place(&g, move.rotations, move.column);
+            setPlacement(row, &g, lines > 0 ? lines : 0);
+            arena_reset(&nodes);
+        }
+        if(finishGame(job->file, &block, &gr, &g, &writeNs)) {
+            atomic_fetch_add(&job->errors, 1);
+        }
+        if(job->scores != NULL) {
+            ScoreRecord r;
+            memset(&r, 0, sizeof(r));
+            r.mode = SCORES_SIM;
+            r.level = g.level;
+            r.score = g.score;
+            r.pieces = g.pieces;
+            strcpy(r.player, "bot");
+            scores_submit(job->scores, &r, true);
+        }
+    }
+    if(export_flush(job->file, &block)) {
+        atomic_fetch_add(&job->errors, 1);
+    }
+    if(counting) {
+        PerfCounts counts;
+        perfPhases = NULL;
+        perf_stop(&group, &counts);
+        perf_close(&group);
+        pthread_mutex_lock(&job->perfLock);
+        perf_add(&job->counts, &counts);
+        perf_phases_add(&job->phases, &phases);
+        job->counted++;
+        pthread_mutex_unlock(&job->perfLock);
+    }
+    atomic_fetch_add(&job->writeNs, writeNs);
+    unsigned long long peak = atomic_load(&job->arenaPeak);
+    while(nodes.peak > peak && !atomic_compare_exchange_weak(&job->arenaPeak, &peak, nodes.peak)) {
+    }
+    arena_free(&nodes);
+    export_block_free(&block);
+    free(gr.rows);
+    return NULL;
+}
+
+static int exportSim(const char *path, unsigned int games, int threads, uint32_t maxPieces, int depth, bool perf) {
+    ExportFile f;
+    if(export_open(&f, path)) {
+        fprintf(stderr, "unable to write %s\n", path);
+        return 1;
+    }
+    SimJob job;
+    job.file = &f;
+    atomic_init(&job.next, 0);
+    job.games = games;
+    job.seed = 1;
+    job.maxPieces = maxPieces;
+    job.depth = depth;
+    atomic_init(&job.errors, 0);
+    atomic_init(&job.writeNs, 0);
+    atomic_init(&job.arenaPeak, 0);
+    job.perf = perf;
+    pthread_mutex_init(&job.perfLock, NULL);
+    memset(&job.counts, 0, sizeof(job.counts));
+    perf_phases_init(&job.phases, NULL);
+    job.counted = 0;
+    ScoreStore scores;
+    job.scores = scores_open(&scores, NULL, NULL) == 0 ? &scores : NULL;
+    if(job.scores == NULL) {
+        fprintf(stderr, "unable to open %s, scores not recorded\n", SCORES_LOG_FILE);
+    }
+
+    pthread_t ids[EXPORT_MAX_THREADS];
+    uint64_t start = timer_now_ns();
+    for(int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], NULL, simWorker, &job);
+    }
+    for(int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double secs = (timer_now_ns() - start) / 1e9;
+    double writeSecs = atomic_load(&job.writeNs) / 1e9;
+    uint64_t rows = f.header.rows;
+    int err = export_close(&f) || atomic_load(&job.errors);
+    printf("%llu rows from %u games on %d threads in %.2fs, %.0f rows/s\n", (unsigned long long)rows, games,
+           threads, secs, secs > 0 ? rows / secs : 0.0);
+    printf("writing took %.3fs of thread time, %.0f rows/s per thread\n", writeSecs,
+           writeSecs > 0 ? rows / writeSecs : 0.0);
+    printf("search arena peak %llu of %zu bytes per thread\n", atomic_load(&job.arenaPeak), bot_search_bytes(depth));
+    if(perf && job.counted == 0) {
+        printf("hardware counters not available\n");
+    } else if(perf && rows > 0) {
+        // per placed piece, everything the workers did: search, placement,
+        // writing rows and recording scores
+        printf("per row on %d threads:", job.counted);
+        for(int i = 0; i < PERF_COUNTERS; i++) {
+            if(job.counts.valid[i]) {
+                printf(" %s %.1f", perf_names[i], job.counts.v[i] / rows);
+            }
+        }
+        printf("\n");
+        // the bot's search places pieces too, so this is most of it
+        printf("per call of each phase, search included:\n");
+        perf_phases_dump(&job.phases, stdout);
+    }
+    pthread_mutex_destroy(&job.perfLock);
+    if(job.scores != NULL) {
+        scores_close(&scores);
+    }
+    return err;
+}
+
+static int exportReplays(const char *path, int count, char *files[]) {
+    ExportFile f;
+    ExportBlock block;
+    GameRows gr = {NULL, 0, 0};
+    uint64_t writeNs = 0;
+    if(export_open(&f, path) || export_block_init(&block, &f)) {
+        fprintf(stderr, "unable to write %s\n", path);
+        return 1;
+    }
+    int err = 0;
+    for(int i = 0; i < count; i++) {
+        Replay r;
+        if(replay_load(&r, files[i])) {
+            fprintf(stderr, "unable to read %s\n", files[i]);
+            err = 1;
+            continue;
+        }
+        GameSim g;
+        ReplayCursor c;
+        replay_start(&r, &g, &c);
+        for(uint32_t frame = 0; frame < r.header.frames && !g.over; frame++) {
+            GameSim before = g;
+            int score = g.score;
+            sim_step(&g, replay_next_input(&r, &c));
+            if(g.pieces != before.pieces) {
+                ExportRow *row = addRow(&gr, &before);
+                if(row == NULL) {
+                    break;
+                }
+                setPlacement(row, &g, (g.score - score) / 100);
+            }
+        }
+        err |= finishGame(&f, &block, &gr, &g, &writeNs);
+        replay_free(&r);
+    }
+    err |= export_flush(&f, &block);
+    printf("%llu rows from %d replays\n", (unsigned long long)f.header.rows, count);
+    err |= export_close(&f);
+    export_block_free(&block);
+    free(gr.rows);
+    return err;
+}
+
+static int info(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if(!fp) {
+        fprintf(stderr, "unable to read %s\n", path);
+        return 1;
+    }
+    ExportHeader h;
+    int ok = fread(&h, sizeof(h), 1, fp) == 1 && memcmp(h.magic, EXPORT_MAGIC, sizeof(EXPORT_MAGIC)) == 0;
+    fclose(fp);
+    if(!ok) {
+        fprintf(stderr, "%s is not a training data file\n", path);
+        return 1;
+    }
+    printf("version %u rows %llu blocks %llu of %u rows, %u bytes each\n", h.version,
+           (unsigned long long)h.rows, (unsigned long long)h.blocks, h.blockRows, h.blockBytes);
+    for(uint32_t c = 0; c < h.columnCount && c < EXPORT_COLUMNS; c++) {
+        printf("  %-10s offset %8u width %2u\n", h.columns[c].name, h.columns[c].offset, h.columns[c].width);
+    }
+    return 0;
+}
+
+int export_main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: export sim [games] [threads] [outfile] [maxpieces] [depth] [perf]\n"
+                        "       export replay <outfile> <replay>...\n"
+                        "       export info [file]\n");
+        return EXIT_FAILURE;
+    }
+    // the engine draws unless told not to
+    headless = true;
+    int err;
+    if(strcmp(argv[1], "sim") == 0) {
+        unsigned int games = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 100;
+        int threads = argc > 3 ? atoi(argv[3]) : 4;
+        const char *path = argc > 4 ? argv[4] : EXPORT_DEFAULT_FILE;
+        uint32_t maxPieces = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 10) : 10000;
+        int depth = argc > 6 ? atoi(argv[6]) : 1;
+        bool perf = argc > 7 && strcmp(argv[7], "perf") == 0;
+        if(threads < 1) {
+            threads = 1;
+        } else if(threads > EXPORT_MAX_THREADS) {
+            threads = EXPORT_MAX_THREADS;
+        }
+        if(depth < 1) {
+            depth = 1;
+        }
+        err = exportSim(path, games, threads, maxPieces, depth, perf);
+    } else if(strcmp(argv[1], "replay") == 0 && argc > 3) {
+        err = exportReplays(argv[2], argc - 3, argv + 3);
+    } else if(strcmp(argv[1], "info") == 0) {
+        err = info(argc > 2 ? argv[2] : EXPORT_DEFAULT_FILE);
+    } else {
+        fprintf(stderr, "unknown export command %s\n", argv[1]);
+        err = 1;
+    }
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#ifndef EXPORT_H_
+#define EXPORT_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tetris.h"
+
+// Training data file: one row per placed piece, stored column by column so a
+// reader can mmap the file and index it directly.
+//
+//   ExportHeader, padded to EXPORT_HEADER_BYTES
+//   block 0, block 1, ... each exactly header.blockBytes long
+//
+// A block holds up to header.blockRows rows. It starts with a uint32 row
+// count, then every column at header.columns[c].offset from the block start,
+// blockRows * width bytes each, so row r of column c in block b is at
+//   EXPORT_HEADER_BYTES + b * blockBytes + columns[c].offset + r * width.
+// Blocks written by different threads may be partly filled. Little endian.
+#define EXPORT_MAGIC "TETRAIN"
+#define EXPORT_VERSION 1
+#define EXPORT_HEADER_BYTES 4096
+#define EXPORT_BLOCK_ROWS 65536
+#define EXPORT_ALIGN 64
+#define EXPORT_NO_HELD 7
+#define EXPORT_DEFAULT_FILE "data/train.bin"
+
+typedef enum {
+    EXPORT_BOARD,        // uint16[25], bit j of row i is column j, before the piece
+    EXPORT_PIECE,        // uint8 color of the falling piece
+    EXPORT_NEXT,         // uint8 color of the next piece
+    EXPORT_HELD,         // uint8 held color, EXPORT_NO_HELD if none
+    EXPORT_ROTATION,     // uint8 orientation the piece locked in
+    EXPORT_COLUMN,       // uint8 leftmost column the piece locked in
+    EXPORT_LINES,        // uint8 lines the placement cleared
+    EXPORT_SCORE,        // uint32 final score of the game
+    EXPORT_REMAINING,    // uint32 pieces placed after this one before the game ended
+    EXPORT_COLUMNS
+} ExportColumnId;
+
+typedef struct ExportColumn {
+    char name[16];
+    uint32_t offset;
+    uint32_t width;      // bytes per row
+} ExportColumn;
+
+typedef struct ExportHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t blockRows;
+    uint32_t blockBytes;
+    uint64_t blocks;
+    uint64_t rows;
+    uint32_t columnCount;
+    uint32_t pad;
+    ExportColumn columns[EXPORT_COLUMNS];
+} ExportHeader;
+
+_Static_assert(sizeof(ExportHeader) <= EXPORT_HEADER_BYTES, "ExportHeader too big");
+
+// One row before it goes into a block.
+typedef struct ExportRow {
+    uint16_t board[MATRIX_LENGTH-1];
+    uint8_t piece;
+    uint8_t next;
+    uint8_t held;
+    uint8_t rotation;
+    uint8_t column;
+    uint8_t lines;
+    uint32_t score;
+    uint32_t remaining;
+} ExportRow;
+
+typedef struct ExportFile {
+    FILE *fp;
+    pthread_mutex_t lock;
+    ExportHeader header;
+} ExportFile;
+
+// A block being filled by one thread.
+typedef struct ExportBlock {
+    uint8_t *data;
+    uint32_t rows;
+} ExportBlock;
+
+int export_open(ExportFile *f, const char *path);
+
+// Writes the final header and closes the file.
+int export_close(ExportFile *f);
+
+int export_block_init(ExportBlock *b, ExportFile *f);
+
+void export_block_free(ExportBlock *b);
+
+// Appends rows, writing the block out whenever it fills. Safe to call from
+// several threads with one block each.
+int export_append(ExportFile *f, ExportBlock *b, const ExportRow *rows, uint32_t count);
+
+// Writes out a partly filled block.
+int export_flush(ExportFile *f, ExportBlock *b);
+
+// Command line entry: export <sim|replay|info> ...
+int export_main(int argc, char *argv[]);
+
+#endif
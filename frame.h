@@ -0,0 +1,15 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+// Layout of the text frame exchanged by client() and server(). Every field is
+// printable so the frame can be sent with strlen.
+#define FRAME_BOARD 0     // 225 '0'/'1' cells, row major
+#define FRAME_LEVEL 225   // 2 digits
+#define FRAME_SCORE 227   // 5 digits, space padded
+#define FRAME_OVER 232    // '1' once the sender's game is over
+#define FRAME_SEQ 233     // 8 hex digits, sender's sequence number
+#define FRAME_TIME 241    // 16 hex digits, sender's clock in ns when sent
+#define FRAME_ECHO 257    // 16 hex digits, FRAME_TIME received plus time held
+#define FRAME_LEN 274     // including the terminating '\0'
+
+#endif
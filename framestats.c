@@ -0,0 +1,57 @@
+
+#include "framestats.h"
+#include "timer.h"
+#include "render.h"
+
+void framestats_reset(FrameStats *fs) {
+    histogram_reset(&fs->input);
+    histogram_reset(&fs->tick);
+    histogram_reset(&fs->mutex);
+    histogram_reset(&fs->render);
+    perf_phases_init(&fs->phases, NULL);
+}
+
+void framestats_lock(FrameStats *fs, pthread_mutex_t *m) {
+    uint64_t start = timer_now_ns();
+    pthread_mutex_lock(m);
+    histogram_record(&fs->mutex, timer_now_ns() - start);
+}
+
+void framestats_row(Histogram *h, FrameStatsRow *row) {
+    row->p50 = histogram_percentile(h, 50);
+    row->p99 = histogram_percentile(h, 99);
+}
+
+static void drawRow(int y, int x, const char *name, const FrameStatsRow *row) {
+    render_printf(y, x, "%-6s%5llu %5llu", name,
+             (unsigned long long)(row->p50 / 1000),
+             (unsigned long long)(row->p99 / 1000));
+}
+
+void framestats_draw(const FrameStatsRow rows[FRAMESTATS_ROWS], int y, int x) {
+    render_printf(y, x, "us      p50   p99");
+    drawRow(y+1, x, "input", &rows[FRAMESTATS_INPUT]);
+    drawRow(y+2, x, "tick", &rows[FRAMESTATS_TICK]);
+    drawRow(y+3, x, "mutex", &rows[FRAMESTATS_MUTEX]);
+    drawRow(y+4, x, "render", &rows[FRAMESTATS_RENDER]);
+}
+
+void framestats_erase(int y, int x) {
+    for(int i = 0; i < 5; i++) {
+        render_printf(y+i, x, "                 ");
+    }
+}
+
+int framestats_dump(FrameStats *fs, const char *path) {
+    FILE *fp = fopen(path, "w+");
+    if(!fp) {
+        return 1;
+    }
+    histogram_dump(&fs->input, "input_to_draw_ns", fp);
+    histogram_dump(&fs->tick, "tick_ns", fp);
+    histogram_dump(&fs->mutex, "mutex_wait_ns", fp);
+    histogram_dump(&fs->render, "render_ns", fp);
+    perf_phases_dump(&fs->phases, fp);
+    fclose(fp);
+    return 0;
+}
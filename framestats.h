@@ -0,0 +1,55 @@
+#ifndef FRAMESTATS_H_
+#define FRAMESTATS_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "perfctr.h"
+
+#define FRAMESTATS_KEY 'i'
+#define FRAMESTATS_FILE "data/frame_stats.txt"
+#define FRAMESTATS_X 38
+#define FRAMESTATS_Y 18
+
+// Timings gathered around the play() loop, all in nanoseconds. tick and
+// mutex are recorded by play(), input and render by the render thread.
+typedef struct FrameStats {
+    Histogram input;   // key read by the render thread until a frame with it is flushed
+    Histogram tick;    // game logic for one pass of the loop, up to publishing the frame
+    Histogram mutex;   // waiting to acquire the global mutex
+    Histogram render;  // drawing one frame and flushing it
+    PerfPhases phases; // render, if the render thread has counters
+    bool overlay;
+} FrameStats;
+
+typedef enum {
+    FRAMESTATS_INPUT,
+    FRAMESTATS_TICK,
+    FRAMESTATS_MUTEX,
+    FRAMESTATS_RENDER,
+    FRAMESTATS_ROWS
+} FrameStatsRowId;
+
+// One overlay line, taken by the thread that records the histogram.
+typedef struct FrameStatsRow {
+    uint64_t p50;
+    uint64_t p99;
+} FrameStatsRow;
+
+void framestats_reset(FrameStats *fs);
+
+// pthread_mutex_lock that records how long the caller waited.
+void framestats_lock(FrameStats *fs, pthread_mutex_t *m);
+
+void framestats_row(Histogram *h, FrameStatsRow *row);
+
+// Draws the live overlay next to the board.
+void framestats_draw(const FrameStatsRow rows[FRAMESTATS_ROWS], int y, int x);
+
+void framestats_erase(int y, int x);
+
+int framestats_dump(FrameStats *fs, const char *path);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FSUTIL_H_
+#define FSUTIL_H_
+
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Moves from over to in one step, so a crash leaves either the old to or the
+// new one. Windows' rename() refuses to overwrite, MoveFileEx can.
+static inline int fs_replace(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : 1;
+#else
+    return rename(from, to) != 0;
+#endif
+}
+
+#endif
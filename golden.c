@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "golden.h"
+#include "tetris.h"
+#include "bench.h"
+#include "frame.h"
+#include "render.h"
+#include "replay.h"
+
+typedef void (*GoldenScene)();
+
+static void sceneEmpty() {
+    drawBoard(0, 1, 0);
+}
+
+static void scenePieces() {
+    drawBoard(0, 1, 0);
+    for(int c = RED; c <= ORANGE; c++) {
+        Color next = c;
+        newBlock((c + 1) % 7, &next, 0);
+    }
+    drawHeld(YELLOW, 0);
+}
+
+static void sceneHalf() {
+    bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    bench_make_board(matrix, 50, 2, 99u);
+    drawBoard(0, 1, 0);
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(matrix[i][j]) {
+                paint(i, blocktomatrix(j));
+            }
+        }
+    }
+    drawNext(ORANGE, 0);
+    drawHeld(GREEN, 0);
+    drawScoreLevel(12300, 13, 0);
+}
+
+static void sceneLineClear() {
+    bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    bench_make_board(matrix, 40, 3, 7u);
+    sceneHalf();
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(matrix[i][j]) {
+                paint(i, blocktomatrix(j));
+            } else {
+                whiteout(i, blocktomatrix(j));
+            }
+        }
+    }
+    checkLine(matrix);
+}
+
+static void sceneSecondPlayer() {
+    char frame[FRAME_LEN];
+    bool saved[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    memcpy(saved, matrix_g, sizeof(saved));
+    bench_make_board(matrix_g, 60, 0, 5u);
+    currentTetrimo.current_xy[0].x = 0;
+    int savedLevel = level;
+    int savedScore = score;
+    level = 7;
+    score = 4200;
+    encodeState(frame, false);
+    level = savedLevel;
+    score = savedScore;
+    memcpy(matrix_g, saved, sizeof(saved));
+
+    drawBoard(0, 1, 0);
+    drawBoard(0, 1, 55);
+    drawSecondPlayer(frame, NULL);
+}
+
+static const struct {
+    const char *name;
+    GoldenScene scene;
+} scenes[] = {
+    {"empty", sceneEmpty},
+    {"pieces", scenePieces},
+    {"half", sceneHalf},
+    {"line_clear", sceneLineClear},
+    {"second_player", sceneSecondPlayer},
+};
+
+// Draws every frame of the replay in dir the way a rollback game draws its
+// boards and writes or compares a hash of each. Returns the failures.
+static int goldenReplay(const char *dir, bool record) {
+    char path[256];
+    char framesPath[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, GOLDEN_REPLAY);
+    snprintf(framesPath, sizeof(framesPath), "%s/%s", dir, GOLDEN_REPLAY_FRAMES);
+    Replay r;
+    if(replay_load(&r, path) != 0) {
+        if(!record || replay_record_random(path, GOLDEN_REPLAY_LENGTH, GOLDEN_REPLAY_SEED) != 0 ||
+           replay_load(&r, path) != 0) {
+            printf("missing  %s\n", path);
+            return 1;
+        }
+    }
+    FILE *fp = fopen(framesPath, record ? "w" : "r");
+    if(fp == NULL) {
+        printf("missing  %s\n", framesPath);
+        replay_free(&r);
+        return 1;
+    }
+    GameSim g;
+    ReplayCursor c;
+    replay_start(&r, &g, &c);
+    render_clear();
+    drawBoard(0, g.level, 0);
+    int failures = 0;
+    for(uint32_t f = 0; f <= r.header.frames; f++) {
+        sim_draw(&g, 0);
+        eraseNext(g.next, 0);
+        drawNext(g.next, 0);
+        if(g.heldExists) {
+            drawHeld(g.held, 0);
+        }
+        render_flush();
+        unsigned long long hash = render_mem_hash();
+        if(record) {
+            fprintf(fp, "%016llx\n", hash);
+        } else {
+            unsigned long long want;
+            if(fscanf(fp, "%llx", &want) != 1) {
+                printf("FAILED   replay ends at frame %u, the game has %u\n", f, r.header.frames);
+                failures++;
+                break;
+            }
+            if(want != hash) {
+                printf("FAILED   replay frame %u\n", f);
+                failures++;
+                break;
+            }
+        }
+        if(f < r.header.frames) {
+            sim_step(&g, replay_next_input(&r, &c));
+        }
+    }
+    if(record) {
+        printf("recorded %s, %u frames\n", framesPath, r.header.frames + 1);
+    } else if(failures == 0) {
+        printf("ok       replay, %u frames\n", r.header.frames + 1);
+    }
+    fclose(fp);
+    replay_free(&r);
+    return failures;
+}
+
+int golden_main(int argc, char *argv[]) {
+    if(argc < 2 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "check") != 0)) {
+        fprintf(stderr, "usage: frames <record|check> [dir]\n");
+        return EXIT_FAILURE;
+    }
+    bool record = strcmp(argv[1], "record") == 0;
+    const char *dir = argc > 2 ? argv[2] : GOLDEN_DEFAULT_DIR;
+    if(record) {
+        mkdir(dir);
+    }
+
+    RenderBackend *was = render_current();
+    bool wasHeadless = headless;
+    headless = false;
+    render_use(&render_mem);
+
+    int failures = 0;
+    int numScenes = sizeof(scenes) / sizeof(scenes[0]);
+    for(int i = 0; i < numScenes; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.txt", dir, scenes[i].name);
+        render_clear();
+        scenes[i].scene();
+        render_flush();
+        if(record) {
+            if(render_mem_save(path)) {
+                fprintf(stderr, "unable to write %s\n", path);
+                failures++;
+            } else {
+                printf("recorded %s\n", path);
+            }
+            continue;
+        }
+        int row = render_mem_compare(path);
+        if(row == 0) {
+            printf("ok       %s\n", scenes[i].name);
+        } else if(row < 0) {
+            printf("missing  %s\n", path);
+            failures++;
+        } else {
+            printf("FAILED   %s row %d\n", scenes[i].name, row - 1);
+            printf("  got:   %s\n", render_mem_row(row - 1));
+            failures++;
+        }
+    }
+
+    failures += goldenReplay(dir, record);
+
+    headless = wasHeadless;
+    render_use(was);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#ifndef GOLDEN_H_
+#define GOLDEN_H_
+
+#define GOLDEN_DEFAULT_DIR "golden"
+#define GOLDEN_REPLAY "replay.trp"               // played back frame by frame
+#define GOLDEN_REPLAY_FRAMES "replay_frames.txt"  // hash of the screen after every frame
+#define GOLDEN_REPLAY_LENGTH 3000
+#define GOLDEN_REPLAY_SEED 7u
+
+// Command line entry: frames <record|check> [dir]
+// Draws a fixed set of scenes into the in-memory backend and either writes
+// them to dir or compares them with what is already there. Then plays the
+// replay in dir, drawing and hashing the screen after every frame, and
+// records or checks those hashes the same way. Recording makes the replay
+// first if dir has none.
+int golden_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include "histogram.h"
+
+static int bucketIndex(uint64_t value) {
+    if(value < HISTOGRAM_SUB_COUNT) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int magnitude = msb - HISTOGRAM_SUB_BITS + 1;
+    if(magnitude >= HISTOGRAM_MAGNITUDES) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int sub = (int)(value >> (msb - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_COUNT;
+    return (magnitude * HISTOGRAM_SUB_COUNT) + sub;
+}
+
+// Largest value that falls in the bucket.
+static uint64_t bucketUpper(int index) {
+    int magnitude = index / HISTOGRAM_SUB_COUNT;
+    uint64_t sub = index % HISTOGRAM_SUB_COUNT;
+    if(magnitude == 0) {
+        return sub;
+    }
+    uint64_t lower = (HISTOGRAM_SUB_COUNT + sub) << (magnitude - 1);
+    return lower + (1ULL << (magnitude - 1)) - 1;
+}
+
+void histogram_reset(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void histogram_record(Histogram *h, uint64_t value) {
+    h->counts[bucketIndex(value)]++;
+    h->total++;
+    h->sum += value;
+    if(value < h->min) {
+        h->min = value;
+    }
+    if(value > h->max) {
+        h->max = value;
+    }
+}
+
+uint64_t histogram_percentile(Histogram *h, double percentile) {
+    if(h->total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)((percentile / 100.0) * h->total + 0.5);
+    if(target < 1) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->counts[i];
+        if(seen >= target) {
+            uint64_t upper = bucketUpper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+double histogram_mean(Histogram *h) {
+    if(h->total == 0) {
+        return 0;
+    }
+    return (double)h->sum / h->total;
+}
+
+void histogram_merge(Histogram *into, const Histogram *from) {
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+    into->sum += from->sum;
+    if(from->min < into->min) {
+        into->min = from->min;
+    }
+    if(from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+void histogram_dump(Histogram *h, const char *name, FILE *fp) {
+    fprintf(fp, "%s count %llu min %llu mean %.0f p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu\n",
+            name, (unsigned long long)h->total,
+            (unsigned long long)(h->total ? h->min : 0), histogram_mean(h),
+            (unsigned long long)histogram_percentile(h, 50),
+            (unsigned long long)histogram_percentile(h, 90),
+            (unsigned long long)histogram_percentile(h, 99),
+            (unsigned long long)histogram_percentile(h, 99.9),
+            (unsigned long long)h->max);
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if(h->counts[i]) {
+            fprintf(fp, "%llu %llu\n", (unsigned long long)bucketUpper(i), (unsigned long long)h->counts[i]);
+        }
+    }
+}
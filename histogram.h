@@ -0,0 +1,38 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Log-linear buckets in the style of HdrHistogram: every power of two is split
+// into 32 sub buckets, so recorded values keep about 3% precision from 1ns up
+// to several hours. Recording is a couple of shifts and an increment.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAGNITUDES 40
+#define HISTOGRAM_BUCKETS (HISTOGRAM_MAGNITUDES * HISTOGRAM_SUB_COUNT)
+
+typedef struct Histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} Histogram;
+
+void histogram_reset(Histogram *h);
+
+void histogram_record(Histogram *h, uint64_t value);
+
+// Value at or below which the given percentage (0-100) of recordings fall.
+uint64_t histogram_percentile(Histogram *h, double percentile);
+
+double histogram_mean(Histogram *h);
+
+// Adds every recording in from to into.
+void histogram_merge(Histogram *into, const Histogram *from);
+
+// Writes a summary line and every non empty bucket as "upper_bound count".
+void histogram_dump(Histogram *h, const char *name, FILE *fp);
+
+#endif
@@ -0,0 +1,242 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "impair.h"
+#include "rollback.h"
+#include "timer.h"
+
+#define MS_NS 1000000ULL
+
+static unsigned int nextRandom(Impairment *im) {
+    im->rng = (im->rng * 1103515245u) + 12345u;
+    return (im->rng >> 8) & 0xffffff;
+}
+
+static bool chance(Impairment *im, int pct) {
+    return pct > 0 && (int)(nextRandom(im) % 100) < pct;
+}
+
+bool impair_enabled(const ImpairConfig *cfg) {
+    return cfg->lossPct > 0 || cfg->latencyMs > 0 || cfg->jitterMs > 0 || cfg->dupPct > 0;
+}
+
+void impair_init(Impairment *im, const ImpairConfig *cfg, bool ordered, unsigned int seed) {
+    memset(im, 0, sizeof(*im));
+    im->cfg = *cfg;
+    im->ordered = ordered;
+    im->rng = seed;
+}
+
+static void enqueue(Impairment *im, const unsigned char *p, int len, uint64_t due) {
+    if(im->count == IMPAIR_QUEUE) {
+        im->overflowed++;
+        return;
+    }
+    ImpairedPacket *q = &im->queue[im->count++];
+    q->due = due;
+    q->len = len;
+    memcpy(q->data, p, len);
+}
+
+static uint64_t arrival(Impairment *im, uint64_t now) {
+    int64_t ms = im->cfg.latencyMs;
+    if(im->cfg.jitterMs > 0) {
+        ms += (int64_t)(nextRandom(im) % (2 * im->cfg.jitterMs + 1)) - im->cfg.jitterMs;
+    }
+    return ms > 0 ? now + (uint64_t)ms * MS_NS : now;
+}
+
+void impair_push(Impairment *im, const unsigned char *p, int len, uint64_t now) {
+    if(len > IMPAIR_MAX_PACKET) {
+        im->overflowed++;
+        return;
+    }
+    uint64_t due = arrival(im, now);
+    if(chance(im, im->cfg.lossPct)) {
+        if(!im->ordered) {
+            im->dropped++;
+            return;
+        }
+        im->retransmitted++;
+        due += IMPAIR_RTO_MS * MS_NS;
+    }
+    if(im->ordered) {
+        // a stream delivers in order, so a late packet holds up the rest
+        if(due < im->lastDue) {
+            due = im->lastDue;
+        }
+        im->lastDue = due;
+        enqueue(im, p, len, due);
+        return;
+    }
+    enqueue(im, p, len, due);
+    if(chance(im, im->cfg.dupPct)) {
+        im->duplicated++;
+        enqueue(im, p, len, arrival(im, now));
+    }
+}
+
+int impair_pop(Impairment *im, uint64_t now, unsigned char *p) {
+    int first = -1;
+    for(int i = 0; i < im->count; i++) {
+        if(first < 0 || im->queue[i].due < im->queue[first].due) {
+            first = i;
+        }
+    }
+    if(first < 0 || im->queue[first].due > now) {
+        return 0;
+    }
+    int len = im->queue[first].len;
+    memcpy(p, im->queue[first].data, len);
+    memmove(&im->queue[first], &im->queue[first+1], (im->count - first - 1) * sizeof(ImpairedPacket));
+    im->count--;
+    return len;
+}
+
+typedef struct Side {
+    bool host;
+    bool udp;
+    bool shm;                            // whatever transport_join picks, shared memory on Linux
+    char port[6];
+    ImpairConfig cfg;
+    uint32_t frames;
+    unsigned int seed;
+    Transport net;
+    Rollback rb;
+    int err;
+} Side;
+
+// One player: random inputs at the real frame rate, then the end of match
+// handshake.
+static void *playSide(void *arg) {
+    Side *s = (Side *)arg;
+    headless = true;
+    Config config = {.port = s->port, .host = "127.0.0.1"};
+    if(s->udp) {
+        s->err = s->host ? transport_udp_host(&s->net, s->port, ROLLBACK_PACKET)
+                         : transport_udp_join(&s->net, config, ROLLBACK_PACKET);
+    } else if(s->shm) {
+        s->err = s->host ? transport_listen(&s->net, s->port, ROLLBACK_PACKET) || transport_accept(&s->net)
+                         : transport_join(&s->net, config, ROLLBACK_PACKET);
+    } else {
+        s->err = s->host ? transport_tcp_host(&s->net, s->port, ROLLBACK_PACKET)
+                         : transport_tcp_join(&s->net, config, ROLLBACK_PACKET);
+    }
+    if(s->err) {
+        return NULL;
+    }
+    transport_impair(&s->net, &s->cfg, s->seed);
+    // the joiner has to take the level from the host
+    rollback_open(&s->rb, &s->net, (unsigned int)atoi(s->port), s->host ? IMPAIR_LEVEL : 0);
+    unsigned int rng = s->seed;
+    uint64_t nextFrame = timer_now_ns();
+    while(s->rb.frame < s->frames && !s->rb.disconnected) {
+        rollback_receive(&s->rb);
+        if(rollback_stalled(&s->rb)) {
+            transport_wait(&s->net, 1);
+            continue;
+        }
+        rng = (rng * 1103515245u) + 12345u;
+        // a key every few frames, like a person
+        uint8_t input = ((rng >> 16) & 3) == 0 ? (uint8_t)(1 << ((rng >> 8) % 5)) : 0;
+        rollback_step(&s->rb, input);
+        nextFrame += SIM_FRAME_NS;
+        uint64_t now = timer_now_ns();
+        if(now < nextFrame) {
+            usleep((nextFrame - now) / 1000);
+        } else {
+            nextFrame = now;
+        }
+    }
+    if(!s->rb.disconnected) {
+        rollback_finish(&s->rb);
+    }
+    return NULL;
+}
+
+static void report(Side *s) {
+    Rollback *rb = &s->rb;
+    Impairment *im = &s->net.impairment;
+    printf("%-4s frames %6u stalls %6llu rollbacks %5llu resim %6llu p99 %5lluus\n",
+           s->host ? "host" : "join", rb->frame,
+           (unsigned long long)rb->stalls, (unsigned long long)rb->rollbacks,
+           (unsigned long long)rb->resimFrames,
+           (unsigned long long)(histogram_percentile(&rb->resim, 99) / 1000));
+    printf("     sent %6llu recv %6llu ignored %4llu dropped %5llu duplicated %4llu retransmitted %4llu resent %4llu\n",
+           (unsigned long long)s->net.sent, (unsigned long long)s->net.received,
+           (unsigned long long)s->net.ignored, (unsigned long long)im->dropped,
+           (unsigned long long)im->duplicated, (unsigned long long)im->retransmitted,
+           (unsigned long long)rb->resends);
+}
+
+static bool sameGame(const GameSim *a, const GameSim *b) {
+    PackedState pa;
+    PackedState pb;
+    state_pack(&pa, a);
+    state_pack(&pb, b);
+    return memcmp(&pa, &pb, sizeof(PackedState)) == 0 && a->pieces == b->pieces;
+}
+
+// usage: tetris impair [udp|tcp|shm] [frames] [loss%] [latency ms] [jitter ms] [dup%] [port]
+int impair_main(int argc, char *argv[]) {
+    const char *via = argc > 1 ? argv[1] : "udp";
+    bool udp = strcmp(via, "udp") == 0;
+    bool shm = strcmp(via, "shm") == 0;
+    uint32_t frames = argc > 2 ? (uint32_t)atoi(argv[2]) : 600;
+    ImpairConfig cfg;
+    cfg.lossPct = argc > 3 ? atoi(argv[3]) : 5;
+    cfg.latencyMs = argc > 4 ? atoi(argv[4]) : 40;
+    cfg.jitterMs = argc > 5 ? atoi(argv[5]) : 10;
+    cfg.dupPct = argc > 6 ? atoi(argv[6]) : 1;
+    int port = argc > 7 ? atoi(argv[7]) : IMPAIR_DEFAULT_PORT;
+
+    Side *sides = calloc(2, sizeof(Side));
+    if(sides == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for(int i = 0; i < 2; i++) {
+        sides[i].host = i == 0;
+        sides[i].udp = udp;
+        sides[i].shm = shm;
+        snprintf(sides[i].port, sizeof(sides[i].port), "%d", port);
+        sides[i].cfg = cfg;
+        sides[i].frames = frames;
+        sides[i].seed = 0x1234567u * (i + 1);
+    }
+    printf("%s loopback, %u frames, loss %d%% latency %dms jitter %dms dup %d%%\n",
+           udp ? "udp" : shm ? "shm" : "tcp", frames, cfg.lossPct, cfg.latencyMs, cfg.jitterMs, cfg.dupPct);
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, playSide, &sides[0]);
+    // give the host time to listen
+    usleep(100000);
+    pthread_create(&threads[1], NULL, playSide, &sides[1]);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    int status = EXIT_SUCCESS;
+    if(sides[0].err || sides[1].err) {
+        fprintf(stderr, "could not connect on port %d\n", port);
+        status = EXIT_FAILURE;
+    } else {
+        printf("joined over %s\n", sides[1].net.name);
+        report(&sides[0]);
+        report(&sides[1]);
+        bool same = sides[1].rb.level == IMPAIR_LEVEL &&
+                    sameGame(&sides[0].rb.local, &sides[1].rb.remote) &&
+                    sameGame(&sides[1].rb.local, &sides[0].rb.remote);
+        printf("games %s\n", same ? "match" : "DIFFER");
+        if(!same) {
+            status = EXIT_FAILURE;
+        }
+        for(int i = 0; i < 2; i++) {
+            rollback_free(&sides[i].rb);
+            transport_close(&sides[i].net);
+        }
+    }
+    free(sides);
+    return status;
+}
@@ -0,0 +1,57 @@
+#ifndef IMPAIR_H_
+#define IMPAIR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IMPAIR_QUEUE 256                 // packets held back at once, more are dropped
+#define IMPAIR_MAX_PACKET 288            // a classic 2-Player frame fits
+#define IMPAIR_RTO_MS 200                // a lost TCP segment turns up this much later
+#define IMPAIR_DEFAULT_PORT 9700
+#define IMPAIR_LEVEL 3                   // the host's start level
+
+typedef struct ImpairConfig {
+    int lossPct;
+    int latencyMs;                       // one way
+    int jitterMs;                        // latency varies by up to this much either way
+    int dupPct;
+} ImpairConfig;
+
+typedef struct ImpairedPacket {
+    uint64_t due;
+    int len;
+    unsigned char data[IMPAIR_MAX_PACKET];
+} ImpairedPacket;
+
+// Loss, latency, jitter and duplication for outgoing packets, so netplay can
+// be tried on loopback. Packets go in when sent and come out when due. For a
+// stream nothing may overtake, so a lost packet is retransmitted after
+// IMPAIR_RTO_MS and everything behind it waits, like TCP would.
+typedef struct Impairment {
+    ImpairConfig cfg;
+    bool ordered;
+    unsigned int rng;
+    ImpairedPacket queue[IMPAIR_QUEUE];
+    int count;
+    uint64_t lastDue;
+    uint64_t dropped;
+    uint64_t duplicated;
+    uint64_t retransmitted;
+    uint64_t overflowed;
+} Impairment;
+
+bool impair_enabled(const ImpairConfig *cfg);
+
+void impair_init(Impairment *im, const ImpairConfig *cfg, bool ordered, unsigned int seed);
+
+void impair_push(Impairment *im, const unsigned char *p, int len, uint64_t now);
+
+// Takes out the packet due first if it is due by now. Returns its length, 0
+// if nothing is due.
+int impair_pop(Impairment *im, uint64_t now, unsigned char *p);
+
+// Plays a rollback match between two threads over loopback through the shim
+// and checks both ended up with the same games.
+int impair_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,484 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _WIN32
+#define poll WSAPoll
+#else
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#include "loadgen.h"
+#include "timer.h"
+
+#ifdef _WIN32
+#define SEND_FLAGS 0
+#else
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+static double uniform(unsigned int *rng) {
+    *rng = (*rng * 1103515245u) + 12345u;
+    return ((*rng >> 8) & 0xffffff) / (double)0x1000000;
+}
+
+static void setNonBlocking(SOCKET s) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(s, FIONBIO, &mode);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
+
+// A half full board, what a player mid game sends. The telemetry fields are
+// stamped per exchange.
+static void makeFrame(char *frame, unsigned int *rng) {
+    for(int i = 0; i < 225; i++) {
+        frame[FRAME_BOARD + i] = i >= 112 && uniform(rng) < 0.7 ? '1' : '0';
+    }
+    memcpy(frame + FRAME_LEVEL, "01", 2);
+    memcpy(frame + FRAME_SCORE, " 1200", 5);
+    frame[FRAME_OVER] = '0';
+    memset(frame + FRAME_SEQ, '0', FRAME_LEN - 1 - FRAME_SEQ);
+    frame[FRAME_LEN - 1] = '\0';
+}
+
+// Same fields netstats_stamp() writes, without a NetStats per client.
+static void stamp(FakeClient *c, uint64_t now) {
+    char field[FRAME_LEN - FRAME_SEQ];
+    snprintf(field, sizeof(field), "%08x%016llx%016llx", (unsigned int)c->seq++, (unsigned long long)now, 0ULL);
+    memcpy(c->frame + FRAME_SEQ, field, FRAME_LEN - 1 - FRAME_SEQ);
+}
+
+static uint64_t sessionLength(LoadTest *t, unsigned int *rng) {
+    // (log) so tetris.h's log() macro doesn't expand
+    return (uint64_t)(-(log)(1.0 - uniform(rng)) * t->churn * 1e9);
+}
+
+static void closeClient(FakeClient *c) {
+    if(c->sock != INVALID_SOCKET) {
+        closesocket(c->sock);
+        c->sock = INVALID_SOCKET;
+    }
+    c->state = CLIENT_IDLE;
+}
+
+static void startExchange(LoadTest *t, LoadWorker *w, FakeClient *c, uint64_t now) {
+    if(c->sessionEnd != 0 && now >= c->sessionEnd) {
+        c->leaving = true;
+    }
+    c->frame[FRAME_OVER] = c->leaving ? '1' : '0';
+    c->started = now;
+    c->done = 0;
+    c->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(c->sock == INVALID_SOCKET) {
+        w->stats.connectErrors++;
+        return;
+    }
+    int one = 1;
+    setsockopt(c->sock, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(one));
+    setNonBlocking(c->sock);
+    struct sockaddr_in *addr = &t->addrs[c->match];
+    if(connect(c->sock, (struct sockaddr *)addr, sizeof(*addr)) == 0) {
+        c->state = CLIENT_SENDING;
+        histogram_record(&w->stats.connect, timer_now_ns() - c->started);
+        stamp(c, timer_now_ns());
+    } else if(wouldBlock()) {
+        c->state = CLIENT_CONNECTING;
+    } else {
+        w->stats.connectErrors++;
+        closeClient(c);
+    }
+}
+
+// Called once the answer is in, schedules the next exchange.
+static void finishExchange(LoadTest *t, LoadWorker *w, FakeClient *c, uint64_t now) {
+    closeClient(c);
+    if(c->done != FRAME_LEN - 1) {
+        w->stats.badFrames++;
+    } else {
+        w->stats.exchanges++;
+        histogram_record(&w->stats.rtt, now - c->sentAt);
+        histogram_record(&w->stats.exchange, now - c->started);
+    }
+    uint64_t interval = (uint64_t)(1e9 / t->rate);
+    c->nextSend += interval;
+    if(c->nextSend < now) {
+        // fell behind, the game loop would skip ahead too
+        w->stats.late++;
+        c->nextSend = now;
+    }
+    if(c->leaving) {
+        c->leaving = false;
+        c->seq = 0;
+        c->nextSend = now + LOADGEN_REJOIN_NS;
+        c->sessionEnd = c->nextSend + sessionLength(t, &w->rng);
+        w->stats.sessions++;
+    }
+}
+
+// Moves a client along after poll said its socket is ready.
+static void advance(LoadTest *t, LoadWorker *w, FakeClient *c, short revents, uint64_t now) {
+    if(c->state == CLIENT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->sock, SOL_SOCKET, SO_ERROR, (char *)&err, &len);
+        if(err != 0 || (revents & (POLLERR | POLLHUP))) {
+            w->stats.connectErrors++;
+            closeClient(c);
+            c->nextSend = now + (uint64_t)(1e9 / t->rate);
+            return;
+        }
+        histogram_record(&w->stats.connect, now - c->started);
+        c->state = CLIENT_SENDING;
+        stamp(c, now);
+    }
+    if(c->state == CLIENT_SENDING) {
+        int n = send(c->sock, c->frame + c->done, FRAME_LEN - 1 - c->done, SEND_FLAGS);
+        if(n < 0 && !wouldBlock()) {
+            w->stats.resets++;
+            closeClient(c);
+            return;
+        }
+        c->done += n > 0 ? n : 0;
+        if(c->done == FRAME_LEN - 1) {
+            c->state = CLIENT_RECEIVING;
+            c->sentAt = now;
+            c->done = 0;
+        }
+        return;
+    }
+    if(c->state == CLIENT_RECEIVING) {
+        // the host sends one frame and closes, so read until the end
+        int n = recv(c->sock, c->reply + c->done, FRAME_LEN - 1 - c->done, 0);
+        if(n > 0) {
+            c->done += n;
+            if(c->done < FRAME_LEN - 1) {
+                return;
+            }
+        } else if(n < 0 && wouldBlock()) {
+            return;
+        } else if(n < 0) {
+            w->stats.resets++;
+            closeClient(c);
+            return;
+        }
+        finishExchange(t, w, c, now);
+    }
+}
+
+static void *workerLoop(void *arg) {
+    LoadWorker *w = (LoadWorker *)arg;
+    LoadTest *t = w->test;
+    struct pollfd *fds = malloc(w->count * sizeof(struct pollfd));
+    int *owner = malloc(w->count * sizeof(int));
+    if(fds == NULL || owner == NULL) {
+        free(fds);
+        free(owner);
+        return NULL;
+    }
+    for(;;) {
+        uint64_t now = timer_now_ns();
+        if(now >= t->end) {
+            break;
+        }
+        uint64_t wake = now + 10000000ULL;
+        int n = 0;
+        for(int i = 0; i < w->count; i++) {
+            FakeClient *c = &w->clients[i];
+            if(c->state == CLIENT_IDLE && now >= c->nextSend) {
+                startExchange(t, w, c, now);
+                if(c->state == CLIENT_IDLE) {
+                    // failed to connect, try again next frame
+                    c->nextSend = now + (uint64_t)(1e9 / t->rate);
+                }
+            } else if(c->state != CLIENT_IDLE && now - c->started > LOADGEN_TIMEOUT_NS) {
+                w->stats.timeouts++;
+                closeClient(c);
+                c->nextSend = now;
+            }
+            if(c->state == CLIENT_IDLE) {
+                if(c->nextSend < wake) {
+                    wake = c->nextSend;
+                }
+                continue;
+            }
+            fds[n].fd = c->sock;
+            fds[n].events = c->state == CLIENT_RECEIVING ? POLLIN : POLLOUT;
+            fds[n].revents = 0;
+            owner[n++] = i;
+        }
+        int ms = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+        if(n == 0) {
+            if(ms > 0) {
+                usleep(ms * 1000);
+            }
+            continue;
+        }
+        if(poll(fds, n, ms) <= 0) {
+            continue;
+        }
+        now = timer_now_ns();
+        for(int k = 0; k < n; k++) {
+            if(fds[k].revents) {
+                advance(t, w, &w->clients[owner[k]], fds[k].revents, now);
+            }
+        }
+    }
+    for(int i = 0; i < w->count; i++) {
+        closeClient(&w->clients[i]);
+    }
+    free(fds);
+    free(owner);
+    return NULL;
+}
+
+// server()'s loop for one match without the game: accept, read the frame,
+// answer, close. Uses the same tcp_server calls, file logging included, so
+// the numbers are what a real host would manage.
+static void *hostLoop(void *arg) {
+    LoadHost *h = (LoadHost *)arg;
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
+    unsigned int rng = 1;
+    uint32_t seq = 0;
+    makeFrame(send, &rng);
+    for(;;) {
+        SOCKET c;
+        if(tcp_server_accept_connection(&h->listen, &c)) {
+            // shut down at the end of the run, the listening socket is closed
+            break;
+        }
+        uint64_t start = timer_now_ns();
+        memset(receive, 0, sizeof(receive));
+        if(tcp_server_receive_request(&c, receive)) {
+            h->errors++;
+            continue;
+        }
+        char field[FRAME_LEN - FRAME_SEQ];
+        snprintf(field, sizeof(field), "%08x%016llx%.16s", (unsigned int)seq++,
+                 (unsigned long long)start, receive[FRAME_TIME] ? receive + FRAME_TIME : "0000000000000000");
+        memcpy(send + FRAME_SEQ, field, FRAME_LEN - 1 - FRAME_SEQ);
+        if(tcp_server_send_response(&c, send)) {
+            h->errors++;
+            continue;
+        }
+        closesocket(c);
+        h->exchanges++;
+        histogram_record(&h->service, timer_now_ns() - start);
+    }
+    return NULL;
+}
+
+static int startHosts(LoadTest *t) {
+    t->hosts = calloc(t->matches, sizeof(LoadHost));
+    if(t->hosts == NULL) {
+        return 1;
+    }
+    for(int i = 0; i < t->matches; i++) {
+        LoadHost *h = &t->hosts[i];
+        histogram_reset(&h->service);
+        snprintf(h->port, sizeof(h->port), "%d", t->basePort + i);
+        if(tcp_server_create(&h->listen, h->port)) {
+            fprintf(stderr, "unable to listen on port %s\n", h->port);
+            return 1;
+        }
+        h->listening = true;
+        if(pthread_create(&h->thread, NULL, hostLoop, h) != 0) {
+            fprintf(stderr, "unable to start host %d\n", i);
+            closesocket(h->listen);
+            h->listening = false;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void stopHosts(LoadTest *t) {
+    if(t->hosts == NULL) {
+        return;
+    }
+    for(int i = 0; i < t->matches && t->hosts[i].listening; i++) {
+        // wakes accept, which then closes the socket
+        shutdown(t->hosts[i].listen, SD_BOTH);
+        pthread_join(t->hosts[i].thread, NULL);
+    }
+}
+
+static int resolve(LoadTest *t) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    t->addrs = calloc(t->matches, sizeof(struct sockaddr_in));
+    if(t->addrs == NULL) {
+        return 1;
+    }
+    for(int i = 0; i < t->matches; i++) {
+        struct addrinfo *res;
+        char port[12];
+        snprintf(port, sizeof(port), "%d", t->basePort + i);
+        if(getaddrinfo(t->host ? t->host : "127.0.0.1", port, &hints, &res) != 0) {
+            return 1;
+        }
+        memcpy(&t->addrs[i], res->ai_addr, sizeof(struct sockaddr_in));
+        freeaddrinfo(res);
+    }
+    return 0;
+}
+
+static void printHistogram(FILE *fp, const char *name, Histogram *h) {
+    fprintf(fp, "%-9s us p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f\n", name, histogram_percentile(h, 50) / 1e3,
+            histogram_percentile(h, 99) / 1e3, histogram_percentile(h, 99.9) / 1e3, h->total ? h->max / 1e3 : 0.0);
+}
+
+static void report(FILE *fp, LoadTest *t, LoadStats *s, double secs) {
+    fprintf(fp, "%d clients at %.0f frames/s against %d matches on %s for %.1fs", t->clients, t->rate, t->matches,
+            t->host ? t->host : "this machine", secs);
+    if(t->churn > 0) {
+        fprintf(fp, ", sessions of %.1fs on average", t->churn);
+    }
+    fprintf(fp, "\n");
+    if(t->hosts) {
+        uint64_t served = 0;
+        uint64_t errors = 0;
+        Histogram service;
+        histogram_reset(&service);
+        for(int i = 0; i < t->matches; i++) {
+            served += t->hosts[i].exchanges;
+            errors += t->hosts[i].errors;
+            histogram_merge(&service, &t->hosts[i].service);
+        }
+        fprintf(fp, "server    %llu frames answered (%.0f/s, %.0f/s per match) errors %llu\n",
+                (unsigned long long)served, served / secs, served / secs / t->matches, (unsigned long long)errors);
+        printHistogram(fp, "service", &service);
+    }
+    fprintf(fp, "clients   %llu exchanges (%.0f/s of %.0f/s wanted) late %llu sessions %llu\n",
+            (unsigned long long)s->exchanges, s->exchanges / secs, t->clients * t->rate,
+            (unsigned long long)s->late, (unsigned long long)s->sessions);
+    fprintf(fp, "errors    connect %llu timeout %llu reset %llu bad frames %llu\n",
+            (unsigned long long)s->connectErrors, (unsigned long long)s->timeouts,
+            (unsigned long long)s->resets, (unsigned long long)s->badFrames);
+    printHistogram(fp, "connect", &s->connect);
+    printHistogram(fp, "rtt", &s->rtt);
+    printHistogram(fp, "exchange", &s->exchange);
+}
+
+static void addStats(LoadStats *into, LoadStats *from) {
+    into->exchanges += from->exchanges;
+    into->connectErrors += from->connectErrors;
+    into->timeouts += from->timeouts;
+    into->resets += from->resets;
+    into->badFrames += from->badFrames;
+    into->late += from->late;
+    into->sessions += from->sessions;
+    histogram_merge(&into->connect, &from->connect);
+    histogram_merge(&into->rtt, &from->rtt);
+    histogram_merge(&into->exchange, &from->exchange);
+}
+
+int loadgen_main(int argc, char *argv[]) {
+    static LoadTest t;
+    memset(&t, 0, sizeof(t));
+    t.clients = argc > 1 ? atoi(argv[1]) : 100;
+    t.rate = argc > 2 ? atof(argv[2]) : 60;
+    t.seconds = argc > 3 ? atof(argv[3]) : 10;
+    t.churn = argc > 4 ? atof(argv[4]) : 0;
+    t.matches = argc > 5 ? atoi(argv[5]) : t.clients;
+    t.host = argc > 6 && strcmp(argv[6], "local") != 0 ? argv[6] : NULL;
+    t.basePort = argc > 7 ? atoi(argv[7]) : LOADGEN_DEFAULT_PORT;
+    if(t.clients < 1 || t.rate <= 0 || t.seconds <= 0 || t.churn < 0 || t.matches < 1
+       || t.matches > LOADGEN_MAX_MATCHES || t.basePort < 1 || t.basePort + t.matches > 65535) {
+        fprintf(stderr, "usage: loadgen [clients] [frames/s] [seconds] [churn seconds, 0 none] [matches 1-%d] "
+                        "[host or local] [port]\n", LOADGEN_MAX_MATCHES);
+        return EXIT_FAILURE;
+    }
+    // the tcp calls log to data/
+    mkdir("data");
+    WSADATA wsaData;
+    if(WSAStartup(MAKEWORD(2,2), &wsaData) != 0 || resolve(&t)) {
+        fprintf(stderr, "unable to resolve %s\n", t.host ? t.host : "127.0.0.1");
+        return EXIT_FAILURE;
+    }
+    int err = 0;
+    if(t.host == NULL && startHosts(&t)) {
+        err = 1;
+    }
+
+    FakeClient *clients = calloc(t.clients, sizeof(FakeClient));
+    int workers = t.clients < LOADGEN_WORKERS ? t.clients : LOADGEN_WORKERS;
+    if(!err && clients != NULL) {
+        unsigned int rng = 7;
+        uint64_t interval = (uint64_t)(1e9 / t.rate);
+        t.start = timer_now_ns();
+        t.end = t.start + (uint64_t)(t.seconds * 1e9);
+        for(int i = 0; i < t.clients; i++) {
+            FakeClient *c = &clients[i];
+            c->sock = INVALID_SOCKET;
+            c->match = i % t.matches;
+            // spread over the first frame so they don't all connect at once
+            c->nextSend = t.start + (uint64_t)(uniform(&rng) * interval);
+            c->sessionEnd = t.churn > 0 ? c->nextSend + sessionLength(&t, &rng) : 0;
+            makeFrame(c->frame, &rng);
+        }
+        int first = 0;
+        for(int k = 0; k < workers; k++) {
+            LoadWorker *w = &t.workers[k];
+            int count = t.clients / workers + (k < t.clients % workers);
+            w->test = &t;
+            w->clients = clients + first;
+            w->count = count;
+            w->rng = 1000u + k;
+            histogram_reset(&w->stats.connect);
+            histogram_reset(&w->stats.rtt);
+            histogram_reset(&w->stats.exchange);
+            first += count;
+            pthread_create(&w->thread, NULL, workerLoop, w);
+        }
+        for(int k = 0; k < workers; k++) {
+            pthread_join(t.workers[k].thread, NULL);
+        }
+    } else if(!err) {
+        err = 1;
+    }
+    double secs = (timer_now_ns() - t.start) / 1e9;
+    stopHosts(&t);
+
+    if(!err) {
+        static LoadStats total;
+        memset(&total, 0, sizeof(total));
+        histogram_reset(&total.connect);
+        histogram_reset(&total.rtt);
+        histogram_reset(&total.exchange);
+        for(int k = 0; k < workers; k++) {
+            addStats(&total, &t.workers[k].stats);
+        }
+        report(stdout, &t, &total, secs);
+        FILE *fp = fopen(LOADGEN_STATS_FILE, "w+");
+        if(fp) {
+            report(fp, &t, &total, secs);
+            histogram_dump(&total.connect, "connect_ns", fp);
+            histogram_dump(&total.rtt, "rtt_ns", fp);
+            histogram_dump(&total.exchange, "exchange_ns", fp);
+            fclose(fp);
+        }
+    }
+    free(clients);
+    free(t.hosts);
+    free(t.addrs);
+    WSACleanup();
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#ifndef LOADGEN_H_
+#define LOADGEN_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tcp_client.h"
+#include "tcp_server.h"
+#include "histogram.h"
+
+#define LOADGEN_DEFAULT_PORT 9500        // match n listens on this + n
+#define LOADGEN_MAX_MATCHES 4096
+#define LOADGEN_WORKERS 4                // threads driving the fake clients
+#define LOADGEN_TIMEOUT_NS 2000000000ULL // an exchange taking longer counts as an error
+#define LOADGEN_REJOIN_NS 500000000ULL   // pause between a client's sessions
+#define LOADGEN_STATS_FILE "data/loadgen_stats.txt"
+
+typedef enum {
+    CLIENT_IDLE,
+    CLIENT_CONNECTING,
+    CLIENT_SENDING,
+    CLIENT_RECEIVING
+} ClientState;
+
+// One fake player doing what client() does every frame: connect, send its
+// frame, read the answer, close. Driven without blocking so one worker
+// thread can run hundreds of them.
+typedef struct FakeClient {
+    SOCKET sock;
+    ClientState state;
+    int match;
+    uint32_t seq;
+    uint64_t nextSend;                   // when the next exchange is due
+    uint64_t sessionEnd;                 // 0 without churn
+    uint64_t started;                    // connect began
+    uint64_t sentAt;                     // frame fully written
+    bool leaving;                        // this exchange ends the session
+    int done;                            // bytes sent or received in this state
+    char frame[FRAME_LEN];
+    char reply[FRAME_LEN];
+} FakeClient;
+
+// Client side numbers, one set per worker thread, added up at the end.
+typedef struct LoadStats {
+    uint64_t exchanges;                  // answered with a well formed frame
+    uint64_t connectErrors;
+    uint64_t timeouts;
+    uint64_t resets;                     // failed mid exchange
+    uint64_t badFrames;
+    uint64_t late;                       // exchanges started after the next was due
+    uint64_t sessions;
+    Histogram connect;                   // connect() until writable, the setup cost
+    Histogram rtt;                       // frame written until the answer is read
+    Histogram exchange;                  // connect() until the answer is read
+} LoadStats;
+
+typedef struct LoadWorker {
+    pthread_t thread;
+    struct LoadTest *test;
+    FakeClient *clients;
+    int count;
+    unsigned int rng;
+    LoadStats stats;
+} LoadWorker;
+
+// A match's host, server()'s loop answering every frame with a fixed one.
+typedef struct LoadHost {
+    pthread_t thread;
+    char port[12];
+    SOCKET listen;
+    bool listening;
+    uint64_t exchanges;
+    uint64_t errors;
+    Histogram service;                   // accepted until the answer is sent
+} LoadHost;
+
+typedef struct LoadTest {
+    int clients;
+    double rate;                         // frames per second per client
+    double seconds;
+    double churn;                        // mean session length in seconds, 0 to never leave
+    int matches;
+    int basePort;
+    const char *host;                    // NULL to run the hosts in this process
+    struct sockaddr_in *addrs;           // one per match, resolved once
+    uint64_t start;
+    uint64_t end;
+    LoadWorker workers[LOADGEN_WORKERS];
+    LoadHost *hosts;
+} LoadTest;
+
+// Command line entry: loadgen [clients] [rate] [seconds] [churn] [matches] [host] [port]
+int loadgen_main(int argc, char *argv[]);
+
+#endif
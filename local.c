@@ -0,0 +1,191 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "local.h"
+#include "scores.h"
+#include "timer.h"
+
+// left, right, rotate, drop, hold
+static const int playerKeys[LOCAL_MAX_PLAYERS][5] = {
+    {'a', 'd', 'w', 's', 'q'},
+    {KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN, '\n'},
+    {'j', 'l', 'i', 'k', 'u'},
+    {'4', '6', '8', '5', '7'},
+};
+static const uint8_t keyBits[5] = {SIM_LEFT, SIM_RIGHT, SIM_ROTATE, SIM_DROP, SIM_HOLD};
+static const char pieceNames[] = "ZSIJOTL";
+
+void local_draw_frames(int players) {
+    for(int p = 0; p < players; p++) {
+        int offset = p * LOCAL_BOARD_COLS;
+        for(int i = 0; i < MATRIX_LENGTH - 1; i++) {
+            render_printf(i, 5 + offset, MATRIX);
+        }
+        render_printf(MATRIX_LENGTH - 1, 5 + offset, MATRIX_BOTTOM);
+    }
+    render_printf(31, 5, "P1 A D W S Q   P2 arrows Enter   P3 J L I K U   P4 4 6 8 5 7   ESC quits");
+}
+
+void local_draw(const GameSim *games, int players) {
+    for(int p = 0; p < players; p++) {
+        const GameSim *g = &games[p];
+        int offset = p * LOCAL_BOARD_COLS;
+        sim_draw((GameSim *)g, offset);
+        render_printf(28, 16 + offset, "Next: %c Hold: %c", pieceNames[g->next],
+                      g->heldExists ? pieceNames[g->held] : '-');
+        if(g->over) {
+            render_printf(29, 16 + offset, "GAME OVER");
+        } else {
+            render_printf(29, 16 + offset, "P%d       ", p + 1);
+        }
+    }
+}
+
+static uint8_t inputFor(int player, int key) {
+    if(key >= 0 && key < 128) {
+        key = tolower(key);
+    }
+    uint8_t input = 0;
+    for(int b = 0; b < 5; b++) {
+        if(key == playerKeys[player][b]) {
+            input |= keyBits[b];
+        }
+    }
+    return input;
+}
+
+static uint64_t drawFrame(View *v, const void *frame, const void *last) {
+    (void)v;
+    (void)last;
+    const LocalFrame *f = (const LocalFrame *)frame;
+    local_draw(f->games, f->players);
+    return 0;
+}
+
+// The boards are drawn by local_run before the view starts.
+static const ViewScreen localScreen = {sizeof(LocalFrame), NULL, drawFrame};
+
+static void dumpStats(LocalGame *lg) {
+    FILE *fp = fopen(LOCAL_STATS_FILE, "w");
+    if(!fp) {
+        return;
+    }
+    fprintf(fp, "players %d\n", lg->players);
+    fprintf(fp, "frames %u\n", lg->frame);
+    fprintf(fp, "frames_drawn %llu\n", (unsigned long long)lg->view.framesDrawn);
+    fprintf(fp, "frames_skipped %llu\n", (unsigned long long)lg->view.framesSkipped);
+    fprintf(fp, "keys_dropped %llu\n", (unsigned long long)lg->view.keysDropped);
+    histogram_dump(&lg->step, "step_ns", fp);
+    histogram_dump(&lg->stats.render, "draw_ns", fp);
+    perf_phases_dump(&lg->stats.phases, fp);
+    fclose(fp);
+}
+
+// Standings under the boards, best score first, and every score to the store.
+static void finish(LocalGame *lg) {
+    int order[LOCAL_MAX_PLAYERS];
+    for(int p = 0; p < lg->players; p++) {
+        order[p] = p;
+        char name[8];
+        snprintf(name, sizeof(name), "P%d", p + 1);
+        submitScore(SCORES_LOCAL, lg->games[p].score, lg->games[p].level, lg->games[p].pieces, name);
+    }
+    for(int i = 1; i < lg->players; i++) {
+        for(int j = i; j > 0 && lg->games[order[j]].score > lg->games[order[j - 1]].score; j--) {
+            int t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+    render_printf(31, 5, "%-80s", "");
+    for(int i = 0; i < lg->players; i++) {
+        render_printf(31, 5 + i * 20, "%d. P%d %6d", i + 1, order[i] + 1, lg->games[order[i]].score);
+    }
+    render_printf(33, 5, "(ESC to go back)");
+    render_flush();
+}
+
+void local_run(int players, unsigned int seed) {
+    LocalGame *lg = calloc(1, sizeof(LocalGame));
+    if(lg == NULL) {
+        return;
+    }
+    if(players < 2) {
+        players = 2;
+    } else if(players > LOCAL_MAX_PLAYERS) {
+        players = LOCAL_MAX_PLAYERS;
+    }
+    lg->players = players;
+    for(int p = 0; p < players; p++) {
+        sim_init(&lg->games[p], seed, level);
+    }
+    if(view_init(&lg->view, &localScreen)) {
+        free(lg);
+        return;
+    }
+    framestats_reset(&lg->stats);
+    histogram_reset(&lg->step);
+
+    render_clear();
+    local_draw_frames(players);
+    if(view_start(&lg->view, false, &lg->stats)) {
+        view_free(&lg->view);
+        free(lg);
+        return;
+    }
+
+    uint64_t nextFrame = timer_now_ns();
+    bool quit = false;
+    while(!quit) {
+        int keys[VIEW_KEYS];
+        int n = 0;
+        int key;
+        while(n < VIEW_KEYS && (key = view_key(&lg->view, 0, NULL)) != ERR) {
+            if(key == ESC_KEY) {
+                quit = true;
+            } else {
+                keys[n++] = key;
+            }
+        }
+
+        uint64_t start = timer_now_ns();
+        int playing = 0;
+        for(int p = 0; p < players; p++) {
+            uint8_t input = 0;
+            for(int i = 0; i < n; i++) {
+                input |= inputFor(p, keys[i]);
+            }
+            if(!lg->games[p].over) {
+                sim_step(&lg->games[p], input);
+            }
+            playing += !lg->games[p].over;
+        }
+        histogram_record(&lg->step, timer_now_ns() - start);
+
+        LocalFrame *f = (LocalFrame *)view_frame(&lg->view);
+        f->frame = ++lg->frame;
+        f->players = players;
+        memcpy(f->games, lg->games, players * sizeof(GameSim));
+        view_publish(&lg->view);
+        if(playing == 0) {
+            break;
+        }
+
+        nextFrame += SIM_FRAME_NS;
+        uint64_t now = timer_now_ns();
+        if(now < nextFrame) {
+            usleep((nextFrame - now) / 1000);
+        } else {
+            nextFrame = now;
+        }
+    }
+
+    view_stop(&lg->view);
+
+    finish(lg);
+    dumpStats(lg);
+    view_free(&lg->view);
+    free(lg);
+}
@@ -0,0 +1,46 @@
+#ifndef LOCAL_H_
+#define LOCAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+#include "histogram.h"
+#include "view.h"
+
+#define LOCAL_MAX_PLAYERS 4
+#define LOCAL_BOARD_COLS 37              // boards sit this far apart, four fit in RENDER_COLS
+#define LOCAL_STATS_FILE "data/local_stats.txt"
+
+// One finished frame of every game, published to the View.
+typedef struct LocalFrame {
+    uint32_t frame;
+    int players;
+    GameSim games[LOCAL_MAX_PLAYERS];
+} LocalFrame;
+
+// 2 to 4 players on one keyboard, each with their own GameSim started from
+// the same seed. The calling thread steps every game once per SIM_FRAME_NS
+// with the keys the View's render thread read, and publishes the boards to
+// it, so neither side waits for the other.
+typedef struct LocalGame {
+    int players;
+    GameSim games[LOCAL_MAX_PLAYERS];    // sim thread only
+    uint32_t frame;                      // sim thread only
+    View view;                           // frames are LocalFrames
+    FrameStats stats;                    // render is composing and flushing one frame
+    Histogram step;                      // stepping all games once
+} LocalGame;
+
+// Plays until every game is over or ESC, leaves the final boards and the
+// standings on screen.
+void local_run(int players, unsigned int seed);
+
+// Draws every board, its next/held piece and score at its offset. Doesn't
+// flush.
+void local_draw(const GameSim *games, int players);
+
+// Draws the empty boards before the first frame.
+void local_draw_frames(int players);
+
+#endif
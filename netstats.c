@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "netstats.h"
+#include "frame.h"
+#include "timer.h"
+#include "render.h"
+
+static bool parseHex(const char *s, int len, uint64_t *out) {
+    uint64_t v = 0;
+    for(int i = 0; i < len; i++) {
+        char c = s[i];
+        v <<= 4;
+        if(c >= '0' && c <= '9') {
+            v |= c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            v |= c - 'a' + 10;
+        } else {
+            return false;
+        }
+    }
+    *out = v;
+    return true;
+}
+
+static void countBytes(NetStats *ns, uint64_t now, uint64_t bytes) {
+    ns->windowBytes += bytes;
+    if(now - ns->windowStart >= NETSTATS_WINDOW_NS) {
+        ns->bytesPerSec = ns->windowBytes * 1e9 / (double)(now - ns->windowStart);
+        ns->windowStart = now;
+        ns->windowBytes = 0;
+    }
+}
+
+void netstats_init(NetStats *ns) {
+    memset(ns, 0, sizeof(*ns));
+    histogram_reset(&ns->rtt);
+    ns->start = timer_now_ns();
+    ns->windowStart = ns->start;
+}
+
+void netstats_stamp(NetStats *ns, char *frame) {
+    uint64_t now = timer_now_ns();
+    // echo each time once, plus the time we sat on it
+    uint64_t echo = 0;
+    if(ns->peerTime != 0 && !ns->echoed) {
+        echo = ns->peerTime + (now - ns->peerAt);
+        ns->echoed = true;
+    }
+    sprintf(frame + FRAME_SEQ, "%08x%016llx%016llx", (unsigned int)ns->sendSeq++,
+            (unsigned long long)now, (unsigned long long)echo);
+    ns->bytesSent += FRAME_LEN - 1;
+    countBytes(ns, now, FRAME_LEN - 1);
+}
+
+bool netstats_receive(NetStats *ns, char *frame) {
+    uint64_t now = timer_now_ns();
+    uint64_t seq, time, echo;
+    size_t len = strnlen(frame, FRAME_LEN);
+    ns->bytesReceived += len;
+    countBytes(ns, now, len);
+    if(len != FRAME_LEN - 1
+       || !parseHex(frame + FRAME_SEQ, 8, &seq)
+       || !parseHex(frame + FRAME_TIME, 16, &time)
+       || !parseHex(frame + FRAME_ECHO, 16, &echo)) {
+        ns->badFrames++;
+        return false;
+    }
+    ns->frames++;
+    if(!ns->received) {
+        ns->received = true;
+        ns->recvSeq = (uint32_t)seq;
+    } else if(seq > ns->recvSeq) {
+        ns->lost += seq - ns->recvSeq - 1;
+        ns->recvSeq = (uint32_t)seq;
+    } else {
+        ns->reordered++;
+    }
+    ns->peerTime = time;
+    ns->peerAt = now;
+    ns->echoed = false;
+    // the echo is our send time plus the peer's hold, so now minus it is
+    // the time spent on the network
+    if(echo != 0 && echo != ns->lastEcho && echo <= now) {
+        uint64_t rtt = now - echo;
+        histogram_record(&ns->rtt, rtt);
+        if(ns->rtt.total > 1) {
+            double d = rtt > ns->lastRtt ? (double)(rtt - ns->lastRtt) : (double)(ns->lastRtt - rtt);
+            ns->jitter += (d - ns->jitter) / 16.0;
+        }
+        ns->lastRtt = rtt;
+        ns->lastEcho = echo;
+    }
+    return true;
+}
+
+void netstats_error(NetStats *ns) {
+    ns->errors++;
+}
+
+void netstats_format(NetStats *ns, char lines[2][NETSTATS_LINE]) {
+    snprintf(lines[0], NETSTATS_LINE, "RTT %7.1fms jitter %6.1fms", ns->lastRtt / 1e6, ns->jitter / 1e6);
+    snprintf(lines[1], NETSTATS_LINE, "lost %5llu err %5llu %7.1fKB/s", (unsigned long long)(ns->lost + ns->badFrames),
+             (unsigned long long)ns->errors, ns->bytesPerSec / 1024.0);
+}
+
+void netstats_draw(NetStats *ns, int y, int x) {
+    char lines[2][NETSTATS_LINE];
+    netstats_format(ns, lines);
+    render_put(y, x, lines[0]);
+    render_put(y+1, x, lines[1]);
+}
+
+int netstats_dump(NetStats *ns, const char *path) {
+    FILE *fp = fopen(path, "w+");
+    if(!fp) {
+        return 1;
+    }
+    double secs = (timer_now_ns() - ns->start) / 1e9;
+    fprintf(fp, "duration_s %.3f\n", secs);
+    fprintf(fp, "frames_sent %u\n", (unsigned int)ns->sendSeq);
+    fprintf(fp, "frames_received %llu\n", (unsigned long long)ns->frames);
+    fprintf(fp, "frames_lost %llu\n", (unsigned long long)ns->lost);
+    fprintf(fp, "frames_reordered %llu\n", (unsigned long long)ns->reordered);
+    fprintf(fp, "frames_bad %llu\n", (unsigned long long)ns->badFrames);
+    fprintf(fp, "errors %llu\n", (unsigned long long)ns->errors);
+    fprintf(fp, "bytes_sent %llu\n", (unsigned long long)ns->bytesSent);
+    fprintf(fp, "bytes_received %llu\n", (unsigned long long)ns->bytesReceived);
+    fprintf(fp, "bytes_per_s %.1f\n", secs > 0 ? (ns->bytesSent + ns->bytesReceived) / secs : 0.0);
+    fprintf(fp, "jitter_ns %.0f\n", ns->jitter);
+    histogram_dump(&ns->rtt, "rtt_ns", fp);
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef NETSTATS_H_
+#define NETSTATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+#define NETSTATS_CLIENT_FILE "data/net_client_stats.txt"
+#define NETSTATS_SERVER_FILE "data/net_server_stats.txt"
+#define NETSTATS_WINDOW_NS 1000000000ULL
+#define NETSTATS_LINE 40
+
+// Telemetry for one side of a 2-Player session. RTT is measured from the
+// FRAME_TIME we sent to the frame that echoes it back, so no clock sync is
+// needed between the two machines. The echo is moved on by however long the
+// peer held the frame before answering (the client's pacer may wait up to
+// PACER_IDLE_MAX_NS), so RTT and jitter only cover the network.
+typedef struct NetStats {
+    uint32_t sendSeq;
+    uint32_t recvSeq;
+    bool received;
+    uint64_t peerTime;
+    uint64_t peerAt;                     // our clock when peerTime arrived
+    bool echoed;                         // peerTime went out in a frame already
+    uint64_t lastEcho;
+    Histogram rtt;
+    uint64_t lastRtt;
+    double jitter;
+    uint64_t frames;
+    uint64_t lost;
+    uint64_t reordered;
+    uint64_t badFrames;
+    uint64_t errors;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t start;
+    uint64_t windowStart;
+    uint64_t windowBytes;
+    double bytesPerSec;
+} NetStats;
+
+void netstats_init(NetStats *ns);
+
+// Writes sequence number, send time and echo into an encoded frame, call it
+// right before the frame goes on the wire.
+void netstats_stamp(NetStats *ns, char *frame);
+
+// Accounts for a received frame, returns false if it is malformed.
+bool netstats_receive(NetStats *ns, char *frame);
+
+// A connect, send or receive call failed.
+void netstats_error(NetStats *ns);
+
+// Two lines for the opponent panel.
+void netstats_format(NetStats *ns, char lines[2][NETSTATS_LINE]);
+
+void netstats_draw(NetStats *ns, int y, int x);
+
+int netstats_dump(NetStats *ns, const char *path);
+
+#endif
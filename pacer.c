@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "pacer.h"
+
+void pacer_init(Pacer *p, int rate) {
+    memset(p, 0, sizeof(*p));
+    p->minInterval = 1000000000ULL / (rate > 0 ? rate : PACER_DEFAULT_RATE);
+    p->interval = p->minInterval;
+    p->idle = p->minInterval;
+}
+
+bool pacer_due(Pacer *p, const char *frame, uint64_t now) {
+    if(!p->sentAny) {
+        return true;
+    }
+    uint64_t since = now - p->lastSend;
+    if(since < p->interval) {
+        return false;
+    }
+    return since >= p->idle || memcmp(frame, p->last, FRAME_SEQ) != 0;
+}
+
+uint64_t pacer_wait_ns(Pacer *p, const char *frame, uint64_t now) {
+    uint64_t since = now - p->lastSend;
+    uint64_t gap = memcmp(frame, p->last, FRAME_SEQ) != 0 ? p->interval : p->idle;
+    return gap > since ? gap - since : 0;
+}
+
+void pacer_sent(Pacer *p, const char *frame, uint64_t now) {
+    if(p->sentAny && memcmp(frame, p->last, FRAME_SEQ) == 0) {
+        p->polls++;
+    } else {
+        p->idle = p->interval;
+    }
+    memcpy(p->last, frame, FRAME_SEQ);
+    p->lastSend = now;
+    p->sentAny = true;
+    p->sent++;
+}
+
+void pacer_answered(Pacer *p, const char *reply, uint64_t took) {
+    if(reply == NULL || took > p->interval) {
+        p->interval *= 2;
+        if(p->interval > PACER_MAX_INTERVAL_NS) {
+            p->interval = PACER_MAX_INTERVAL_NS;
+        }
+        p->backoffs++;
+    } else if(p->interval > p->minInterval) {
+        p->interval -= p->interval / 8;
+        if(p->interval < p->minInterval) {
+            p->interval = p->minInterval;
+        }
+    }
+    // keep polling quickly while the host is changing, slow down when it isn't
+    if(reply != NULL && memcmp(reply, p->lastPeer, FRAME_SEQ) != 0) {
+        memcpy(p->lastPeer, reply, FRAME_SEQ);
+        p->idle = p->interval;
+    } else if(p->idle < PACER_IDLE_MAX_NS) {
+        p->idle *= 2;
+        if(p->idle > PACER_IDLE_MAX_NS) {
+            p->idle = PACER_IDLE_MAX_NS;
+        }
+    }
+    if(p->idle < p->interval) {
+        p->idle = p->interval;
+    }
+}
+
+void pacer_dump(Pacer *p, FILE *fp) {
+    fprintf(fp, "pacer_max_rate %.1f\n", 1e9 / p->minInterval);
+    fprintf(fp, "pacer_sent %llu\n", (unsigned long long)p->sent);
+    fprintf(fp, "pacer_polls %llu\n", (unsigned long long)p->polls);
+    fprintf(fp, "pacer_backoffs %llu\n", (unsigned long long)p->backoffs);
+    fprintf(fp, "pacer_interval_ns %llu\n", (unsigned long long)p->interval);
+}
@@ -0,0 +1,51 @@
+#ifndef PACER_H_
+#define PACER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "frame.h"
+
+#define PACER_DEFAULT_RATE 30            // frames per second at most
+#define PACER_MAX_INTERVAL_NS 500000000ULL   // backoff stops here
+#define PACER_IDLE_MAX_NS 200000000ULL   // slowest poll while neither side changes
+
+// Decides when client() exchanges a frame. A frame goes out when the game
+// state in it changed, but never closer together than interval. While
+// neither side changes the client still polls the host for its frame, slower
+// each time up to PACER_IDLE_MAX_NS. Exchanges that take longer than the
+// interval (or fail) mean the link can't keep up, so the interval doubles,
+// and shrinks back by an eighth per exchange that keeps up.
+typedef struct Pacer {
+    uint64_t minInterval;                // 1 / maximum rate
+    uint64_t interval;
+    uint64_t idle;                       // current poll gap without changes
+    uint64_t lastSend;
+    bool sentAny;
+    char last[FRAME_SEQ];                // state part of the last frame sent
+    char lastPeer[FRAME_SEQ];            // and of the last one received
+    uint64_t sent;
+    uint64_t polls;                      // sent without a local change
+    uint64_t backoffs;
+} Pacer;
+
+// rate is frames per second, 0 for PACER_DEFAULT_RATE.
+void pacer_init(Pacer *p, int rate);
+
+// Whether frame (encoded, telemetry not stamped yet) should go out now.
+bool pacer_due(Pacer *p, const char *frame, uint64_t now);
+
+// Nanoseconds until pacer_due becomes true for frame if nothing changes
+// meanwhile: the rest of the interval if frame differs from the last one
+// sent, otherwise until the next idle poll.
+uint64_t pacer_wait_ns(Pacer *p, const char *frame, uint64_t now);
+
+void pacer_sent(Pacer *p, const char *frame, uint64_t now);
+
+// The exchange finished after took ns, reply is NULL if it failed.
+void pacer_answered(Pacer *p, const char *reply, uint64_t took);
+
+void pacer_dump(Pacer *p, FILE *fp);
+
+#endif
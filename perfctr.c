@@ -0,0 +1,204 @@
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perfctr.h"
+
+const char *perf_names[PERF_COUNTERS] = {"cycles", "instructions", "cache_misses", "l1d_misses", "branch_misses"};
+const char *perf_phase_names[PERF_PHASES] = {"collision", "rotation", "line_clear", "spawn", "render"};
+
+_Thread_local PerfPhases *perfPhases = NULL;
+
+#ifdef __linux__
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int perf_open(PerfGroup *g) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        g->fd[i] = -1;
+    }
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // this thread, any cpu, the first counter leads the group
+        g->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : g->fd[0], 0);
+        if(i == 0 && g->fd[0] < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void perf_close(PerfGroup *g) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        if(g->fd[i] >= 0) {
+            close(g->fd[i]);
+            g->fd[i] = -1;
+        }
+    }
+}
+
+void perf_start(PerfGroup *g) {
+    ioctl(g->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void perf_read(PerfGroup *g, PerfCounts *c) {
+    memset(c, 0, sizeof(*c));
+    // nr, time enabled, time running, then one value per open counter in
+    // the order they joined the group
+    uint64_t buf[3 + PERF_COUNTERS];
+    if(read(g->fd[0], buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t)) || buf[2] == 0) {
+        return;
+    }
+    double scale = (double)buf[1] / buf[2];
+    uint64_t n = 0;
+    for(int i = 0; i < PERF_COUNTERS && n < buf[0]; i++) {
+        if(g->fd[i] >= 0) {
+            c->v[i] = buf[3 + n++] * scale;
+            c->valid[i] = true;
+        }
+    }
+}
+
+void perf_stop(PerfGroup *g, PerfCounts *c) {
+    ioctl(g->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    perf_read(g, c);
+}
+
+#elif defined(_WIN32)
+
+static uint64_t threadCycles(void) {
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    return cycles;
+}
+
+int perf_open(PerfGroup *g) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        g->fd[i] = -1;
+    }
+    g->fd[PERF_CYCLES] = 0;
+    g->base = 0;
+    return 0;
+}
+
+void perf_close(PerfGroup *g) {
+    g->fd[PERF_CYCLES] = -1;
+}
+
+void perf_start(PerfGroup *g) {
+    g->base = threadCycles();
+}
+
+void perf_read(PerfGroup *g, PerfCounts *c) {
+    memset(c, 0, sizeof(*c));
+    c->v[PERF_CYCLES] = (double)(threadCycles() - g->base);
+    c->valid[PERF_CYCLES] = true;
+}
+
+void perf_stop(PerfGroup *g, PerfCounts *c) {
+    perf_read(g, c);
+}
+
+#else
+
+int perf_open(PerfGroup *g) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        g->fd[i] = -1;
+    }
+    return 1;
+}
+
+void perf_close(PerfGroup *g) {
+    (void)g;
+}
+
+void perf_start(PerfGroup *g) {
+    (void)g;
+}
+
+void perf_read(PerfGroup *g, PerfCounts *c) {
+    (void)g;
+    memset(c, 0, sizeof(*c));
+}
+
+void perf_stop(PerfGroup *g, PerfCounts *c) {
+    perf_read(g, c);
+}
+
+#endif
+
+void perf_add(PerfCounts *sum, const PerfCounts *c) {
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        sum->v[i] += c->v[i];
+        sum->valid[i] = sum->valid[i] || c->valid[i];
+    }
+}
+
+void perf_phases_init(PerfPhases *p, PerfGroup *g) {
+    memset(p, 0, sizeof(*p));
+    p->group = g;
+}
+
+void perf_phases_add(PerfPhases *sum, const PerfPhases *p) {
+    for(int i = 0; i < PERF_PHASES; i++) {
+        perf_add(&sum->sum[i], &p->sum[i]);
+        sum->calls[i] += p->calls[i];
+    }
+}
+
+void perf_phases_dump(const PerfPhases *p, FILE *fp) {
+    for(int i = 0; i < PERF_PHASES; i++) {
+        if(p->calls[i] == 0) {
+            continue;
+        }
+        fprintf(fp, "phase %s calls %llu", perf_phase_names[i], (unsigned long long)p->calls[i]);
+        for(int k = 0; k < PERF_COUNTERS; k++) {
+            if(p->sum[i].valid[k]) {
+                fprintf(fp, " %s %.1f", perf_names[k], p->sum[i].v[k] / p->calls[i]);
+            }
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+void perf_phase_enter(PerfPhases *p) {
+    perf_read(p->group, &p->at);
+}
+
+void perf_phase_leave(PerfPhases *p, PerfPhase phase) {
+    PerfCounts now;
+    perf_read(p->group, &now);
+    for(int i = 0; i < PERF_COUNTERS; i++) {
+        if(now.valid[i] && p->at.valid[i]) {
+            p->sum[phase].v[i] += now.v[i] - p->at.v[i];
+            p->sum[phase].valid[i] = true;
+        }
+    }
+    p->calls[phase]++;
+}
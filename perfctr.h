@@ -0,0 +1,101 @@
+#ifndef PERFCTR_H_
+#define PERFCTR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,                   // last level cache
+    PERF_L1D_MISSES,                     // L1 data cache read misses
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS
+} PerfCounter;
+
+typedef enum {
+    PERF_PHASE_COLLISION,                // moving and dropping the piece
+    PERF_PHASE_ROTATION,
+    PERF_PHASE_LINE_CLEAR,               // settling the piece, clearing lines, scoring
+    PERF_PHASE_SPAWN,                    // next piece and hold
+    PERF_PHASE_RENDER,                   // composing and flushing a frame
+    PERF_PHASES
+} PerfPhase;
+
+// Hardware counters of the calling thread, user space only, opened with
+// Linux perf_event_open. They count as one group so every counter covers the
+// same instructions, and are scaled up by enabled/running time if the kernel
+// had to multiplex them. Without a PMU (most VMs) perf_open fails and the
+// caller goes on without counters. On Windows only cycles are there, from
+// QueryThreadCycleTime, and they include the thread's time in the kernel.
+typedef struct PerfGroup {
+    int fd[PERF_COUNTERS];               // -1 for counters this cpu doesn't have
+    uint64_t base;                       // Windows: thread cycles at perf_start
+} PerfGroup;
+
+typedef struct PerfCounts {
+    double v[PERF_COUNTERS];
+    bool valid[PERF_COUNTERS];
+} PerfCounts;
+
+// Counters split by engine phase for one thread. The group keeps running;
+// every phase reads it on the way in and adds the difference on the way out.
+typedef struct PerfPhases {
+    PerfGroup *group;
+    PerfCounts at;                       // read when the current phase began
+    PerfCounts sum[PERF_PHASES];
+    uint64_t calls[PERF_PHASES];
+} PerfPhases;
+
+extern const char *perf_names[PERF_COUNTERS];
+extern const char *perf_phase_names[PERF_PHASES];
+
+// Where the calling thread's phases are added up, NULL (the default) skips
+// them for the cost of a test.
+extern _Thread_local PerfPhases *perfPhases;
+
+// Returns 1 if not even the cycle counter can be opened.
+int perf_open(PerfGroup *g);
+
+void perf_close(PerfGroup *g);
+
+// Zeroes and starts the counters.
+void perf_start(PerfGroup *g);
+
+// Stops the counters and reads them into c.
+void perf_stop(PerfGroup *g, PerfCounts *c);
+
+// Reads the counters into c without stopping them.
+void perf_read(PerfGroup *g, PerfCounts *c);
+
+// Adds c to a sum that started zeroed.
+void perf_add(PerfCounts *sum, const PerfCounts *c);
+
+// Zeroes p for a group that was opened and started.
+void perf_phases_init(PerfPhases *p, PerfGroup *g);
+
+void perf_phases_add(PerfPhases *sum, const PerfPhases *p);
+
+// One line per phase that ran, each counter per call.
+void perf_phases_dump(const PerfPhases *p, FILE *fp);
+
+void perf_phase_enter(PerfPhases *p);
+
+void perf_phase_leave(PerfPhases *p, PerfPhase phase);
+
+// Bracket a phase on the calling thread, nothing happens unless perfPhases
+// is set.
+static inline void perf_phase_begin(void) {
+    if(perfPhases != NULL) {
+        perf_phase_enter(perfPhases);
+    }
+}
+
+static inline void perf_phase_end(PerfPhase phase) {
+    if(perfPhases != NULL) {
+        perf_phase_leave(perfPhases, phase);
+    }
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "perft.h"
+#include "timer.h"
+
+#define PERFT_HASH_SIZE (PERFT_MAX_STATES*2)
+#define PERFT_LOCK_HASH_SIZE (PERFT_MAX_LOCKS*2)
+
+typedef struct PerftSlot {
+    uint64_t key;
+    uint32_t stamp;
+} PerftSlot;
+
+// Scratch for one level of the search, allocated once per run.
+typedef struct PerftLevel {
+    tetrimo queue[PERFT_MAX_STATES];
+    tetrimo locks[PERFT_MAX_LOCKS];
+    PerftSlot visited[PERFT_HASH_SIZE];
+    PerftSlot locked[PERFT_LOCK_HASH_SIZE];
+    uint32_t stamp;
+} PerftLevel;
+
+static uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Packs a block into 16 bits, rows -8..24 and columns -8..23 are representable.
+// Rotations near the top can push blocks above the matrix, so those rows count.
+static bool cellCode(block_coords b, uint64_t *code) {
+    int col = matrixtoblock(b.x);
+    if(b.y < -8 || b.y > 24 || col < -8 || col > 23) {
+        return false;
+    }
+    *code = (uint64_t)(((b.y+8) << 5) | (col+8));
+    return true;
+}
+
+// Key for a piece state: block order and orientation both matter to toggle*.
+static bool stateKey(tetrimo *t, uint64_t *key) {
+    uint64_t k = 0;
+    for(int i = 0; i < 4; i++) {
+        uint64_t code;
+        if(!cellCode(t->current_xy[i], &code)) {
+            return false;
+        }
+        k = (k << 14) | code;
+    }
+    *key = (k << 2) | (uint64_t)t->current_orientation;
+    return true;
+}
+
+// Key for a lock position: just the set of cells, so it is sorted.
+static uint64_t lockKey(tetrimo *t) {
+    uint64_t codes[4];
+    for(int i = 0; i < 4; i++) {
+        if(!cellCode(t->current_xy[i], &codes[i])) {
+            codes[i] = 0x3fff;
+        }
+    }
+    for(int i = 1; i < 4; i++) {
+        for(int j = i; j > 0 && codes[j-1] > codes[j]; j--) {
+            uint64_t tmp = codes[j];
+            codes[j] = codes[j-1];
+            codes[j-1] = tmp;
+        }
+    }
+    return (codes[0] << 42) | (codes[1] << 28) | (codes[2] << 14) | codes[3];
+}
+
+// Returns true if key was not in the table yet.
+static bool insert(PerftSlot *table, int size, uint32_t stamp, uint64_t key) {
+    int mask = size - 1;
+    int i = (int)(mix(key) & mask);
+    while(table[i].stamp == stamp) {
+        if(table[i].key == key) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    table[i].stamp = stamp;
+    table[i].key = key;
+    return true;
+}
+
+static bool aboveMatrix(tetrimo *t) {
+    for(int i = 0; i < 4; i++) {
+        int col = matrixtoblock(t->current_xy[i].x);
+        if(t->current_xy[i].y < 0 || col < 0 || col >= MATRIX_WIDTH) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Breadth first search over every state of one piece using the same moves as
+// play(): left, right, toggle and down. Fills level->locks and returns the count.
+static int generateLocks(PerftLevel *level, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color c, uint64_t *nodes) {
+    level->stamp++;
+    Color next = c;
+    tetrimo spawn = newBlock(c, &next, 0);
+    int head = 0;
+    int tail = 0;
+    int numLocks = 0;
+    uint64_t key;
+
+    if(stateKey(&spawn, &key)) {
+        insert(level->visited, PERFT_HASH_SIZE, level->stamp, key);
+        level->queue[tail++] = spawn;
+    }
+    while(head < tail) {
+        tetrimo t = level->queue[head++];
+        (*nodes)++;
+        for(int move = 0; move < 4; move++) {
+            tetrimo u = t;
+            if(move == 0) {
+                update(LEFT, &u, matrix);
+            } else if(move == 1) {
+                update(RIGHT, &u, matrix);
+            } else if(move == 2) {
+                u.toggle(&u, matrix);
+            } else if(!update(DOWN, &u, matrix)) {
+                if(numLocks < PERFT_MAX_LOCKS
+                   && insert(level->locked, PERFT_LOCK_HASH_SIZE, level->stamp, lockKey(&u))) {
+                    level->locks[numLocks++] = u;
+                }
+                continue;
+            }
+            if(tail < PERFT_MAX_STATES && stateKey(&u, &key)
+               && insert(level->visited, PERFT_HASH_SIZE, level->stamp, key)) {
+                level->queue[tail++] = u;
+            }
+        }
+    }
+    return numLocks;
+}
+
+static uint64_t search(PerftLevel *levels, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *seq, int seqlen, int ply, int depth, uint64_t *nodes) {
+    PerftLevel *level = &levels[ply];
+    int numLocks = generateLocks(level, matrix, seq[ply % seqlen], nodes);
+    if(ply == depth - 1) {
+        return numLocks;
+    }
+    uint64_t leaves = 0;
+    bool child[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    for(int i = 0; i < numLocks; i++) {
+        // a lock above the matrix ends the game, so it is a leaf
+        if(aboveMatrix(&level->locks[i])) {
+            leaves++;
+            continue;
+        }
+        memcpy(child, matrix, sizeof(child));
+        updateMatrix(level->locks[i], child);
+        checkLine(child);
+        leaves += search(levels, child, seq, seqlen, ply + 1, depth, nodes);
+    }
+    return leaves;
+}
+
+int perft_run(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *seq, int seqlen, int depth, PerftResult *result) {
+    if(depth < 1 || depth > PERFT_MAX_DEPTH || seqlen < 1) {
+        return 1;
+    }
+    PerftLevel *levels = calloc(depth, sizeof(PerftLevel));
+    if(levels == NULL) {
+        return 1;
+    }
+    bool wasHeadless = headless;
+    bool *wasTopOut = topOut;
+    bool stuck = false;
+    topOut = &stuck;
+    bool board[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    memcpy(board, matrix, sizeof(board));
+    headless = true;
+
+    result->nodes = 0;
+    uint64_t start = timer_now_ns();
+    result->leaves = search(levels, board, seq, seqlen, 0, depth, &result->nodes);
+    result->elapsed_ns = timer_now_ns() - start;
+
+    headless = wasHeadless;
+    topOut = wasTopOut;
+    free(levels);
+    return 0;
+}
+
+Color perft_parse_piece(char c) {
+    switch(c) {
+        case 'R':
+        case 'r':
+            return RED;
+        case 'G':
+        case 'g':
+            return GREEN;
+        case 'C':
+        case 'c':
+            return CYAN;
+        case 'B':
+        case 'b':
+            return BLUE;
+        case 'Y':
+        case 'y':
+            return YELLOW;
+        case 'P':
+        case 'p':
+            return PURPLE;
+        case 'O':
+        case 'o':
+            return ORANGE;
+        default:
+            return RANDOM;
+    }
+}
+
+int perft_main(int argc, char *argv[]) {
+    if(argc < 3) {
+        fprintf(stderr, "usage: perft <depth> <pieces RGCBYPO> [savefile]\n");
+        return EXIT_FAILURE;
+    }
+    int depth = atoi(argv[1]);
+    int seqlen = strlen(argv[2]);
+    Color seq[PERFT_MAX_DEPTH];
+    if(seqlen > PERFT_MAX_DEPTH) {
+        seqlen = PERFT_MAX_DEPTH;
+    }
+    for(int i = 0; i < seqlen; i++) {
+        seq[i] = perft_parse_piece(argv[2][i]);
+        if(seq[i] == RANDOM) {
+            fprintf(stderr, "unknown piece '%c'\n", argv[2][i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH];
+    initMatrix(matrix);
+    if(argc > 3) {
+        FILE *fp = fopen(argv[3], "r");
+        if(!fp) {
+            fprintf(stderr, "unable to open %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+        fclose(fp);
+        Color current, next, held;
+        int d, s, l, sc;
+        bool heldExists, heldLast;
+        headless = true;
+        loadFile(argv[3], matrix, &current, &d, &s, &l, &sc, &next, &heldExists, &heldLast, &held);
+        headless = false;
+    }
+
+    PerftResult result;
+    if(perft_run(matrix, seq, seqlen, depth, &result)) {
+        fprintf(stderr, "depth must be between 1 and %d\n", PERFT_MAX_DEPTH);
+        return EXIT_FAILURE;
+    }
+    double secs = result.elapsed_ns / 1e9;
+    printf("depth %d leaves %llu nodes %llu time %.3fs nps %.0f\n",
+           depth, (unsigned long long)result.leaves, (unsigned long long)result.nodes,
+           secs, secs > 0 ? result.nodes / secs : 0.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include <stdint.h>
+
+#include "tetris.h"
+
+#define PERFT_MAX_DEPTH 8
+#define PERFT_MAX_STATES 4096
+#define PERFT_MAX_LOCKS 1024
+
+// Results of a perft run. leaves is the number of distinct lock positions
+// reachable at the requested depth, nodes is every piece state visited on the
+// way there.
+typedef struct PerftResult {
+    uint64_t leaves;
+    uint64_t nodes;
+    uint64_t elapsed_ns;
+} PerftResult;
+
+// Counts lock positions reachable on matrix for the first depth pieces of seq
+// (the sequence repeats if it is shorter than depth). matrix is not modified.
+int perft_run(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *seq, int seqlen, int depth, PerftResult *result);
+
+// Parses a piece letter (R G C B Y P O) into its Color, RANDOM if unknown.
+Color perft_parse_piece(char c);
+
+// Command line entry: perft <depth> <pieces> [savefile]
+int perft_main(int argc, char *argv[]);
+
+#endif
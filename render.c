@@ -0,0 +1,65 @@
+#include <ncurses.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "render.h"
+
+static RenderBackend *backend = &render_ncurses;
+
+static void ncursesInit() {
+}
+
+static void ncursesPut(int y, int x, const char *s) {
+    mvaddstr(y, x, s);
+}
+
+static void ncursesClear() {
+    clear();
+}
+
+static void ncursesFlush() {
+    refresh();
+}
+
+RenderBackend render_ncurses = {
+    "ncurses",
+    ncursesInit,
+    ncursesPut,
+    ncursesClear,
+    ncursesFlush,
+};
+
+void render_use(RenderBackend *b) {
+    backend = b;
+    backend->init();
+}
+
+RenderBackend *render_current() {
+    return backend;
+}
+
+void render_put(int y, int x, const char *s) {
+    backend->put(y, x, s);
+}
+
+void render_printf(int y, int x, const char *fmt, ...) {
+    char buf[RENDER_COLS + 1];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    backend->put(y, x, buf);
+}
+
+void render_clear() {
+    backend->clearScreen();
+}
+
+void render_flush() {
+    backend->flush();
+}
+
+int render_getch() {
+    backend->flush();
+    return wgetch(stdscr);
+}
@@ -0,0 +1,73 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RENDER_ROWS 64
+#define RENDER_COLS 160
+
+// Everything the game draws goes through one of these. put() only updates
+// the backend's idea of the screen, flush() sends it to the terminal.
+typedef struct RenderBackend {
+    const char *name;
+    void (*init)();
+    void (*put)(int y, int x, const char *s);
+    void (*clearScreen)();
+    void (*flush)();
+} RenderBackend;
+
+// Draws with mvprintw and refreshes through curses.
+extern RenderBackend render_ncurses;
+
+// Keeps its own screen grid and writes only the cells that changed, as raw
+// ANSI escapes, with a single write() per flush.
+extern RenderBackend render_ansi;
+
+// Draws into an in-memory grid and never touches the terminal, for golden
+// frame comparisons and measuring render cost without a TTY.
+extern RenderBackend render_mem;
+
+void render_use(RenderBackend *backend);
+
+RenderBackend *render_current();
+
+void render_put(int y, int x, const char *s);
+
+void render_printf(int y, int x, const char *fmt, ...);
+
+void render_clear();
+
+void render_flush();
+
+// Flushes the frame, then waits for a key with wgetch.
+int render_getch();
+
+// Makes the ANSI backend's descriptor interpret escapes, which a Windows
+// console only does with virtual terminal processing on. Returns 1 if it
+// can't, the backend would print them as text.
+int render_ansi_enable();
+
+// Output descriptor for the ANSI backend, stdout by default.
+void render_ansi_set_fd(int fd);
+
+// Bytes the ANSI backend has written since it was initialised.
+uint64_t render_ansi_bytes();
+
+// Current contents of the in-memory grid, one row per call.
+const char *render_mem_row(int y);
+
+// Number of render_flush() calls since the backend was initialised.
+uint64_t render_mem_frames();
+
+// FNV-1a hash of the whole grid, cheap enough to record for every frame.
+uint64_t render_mem_hash();
+
+// Writes the grid as text, trailing spaces and empty rows at the end trimmed.
+int render_mem_save(const char *path);
+
+// Compares the grid with a file written by render_mem_save. Returns 0 if they
+// match, -1 if the file can't be read, otherwise the first differing row + 1.
+int render_mem_compare(const char *path);
+
+#endif
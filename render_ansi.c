@@ -0,0 +1,162 @@
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#endif
+
+#include "render.h"
+
+// A cursor move is at most "\x1b[RR;CCCH", so gaps shorter than this are
+// cheaper to reprint from the grid than to jump over.
+#define ANSI_MOVE_COST 9
+#define ANSI_BUFLEN ((RENDER_ROWS * RENDER_COLS * (ANSI_MOVE_COST + 1)) + 64)
+
+static char cur[RENDER_ROWS][RENDER_COLS];
+static char prev[RENDER_ROWS][RENDER_COLS];
+static bool dirty[RENDER_ROWS];
+static bool cleared;
+static bool hidden;
+static int rows = RENDER_ROWS;
+static int cols = RENDER_COLS;
+static int fd = STDOUT_FILENO;
+static uint64_t bytes;
+static char out[ANSI_BUFLEN];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void ansiInit() {
+    pthread_mutex_lock(&lock);
+    rows = RENDER_ROWS;
+    cols = RENDER_COLS;
+    if(stdscr != NULL) {
+        int y, x;
+        getmaxyx(stdscr, y, x);
+        rows = y < RENDER_ROWS ? y : RENDER_ROWS;
+        cols = x < RENDER_COLS ? x : RENDER_COLS;
+    }
+    memset(cur, ' ', sizeof(cur));
+    memset(prev, ' ', sizeof(prev));
+    cleared = true;
+    hidden = false;
+    bytes = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void ansiPut(int y, int x, const char *s) {
+    if(y < 0 || y >= rows) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    for(; *s && x < cols; s++, x++) {
+        if(x >= 0) {
+            cur[y][x] = *s;
+        }
+    }
+    dirty[y] = true;
+    pthread_mutex_unlock(&lock);
+}
+
+static void ansiClear() {
+    pthread_mutex_lock(&lock);
+    memset(cur, ' ', sizeof(cur));
+    memset(prev, ' ', sizeof(prev));
+    cleared = true;
+    pthread_mutex_unlock(&lock);
+}
+
+static int moveTo(char *p, int y, int x) {
+    return sprintf(p, "\x1b[%d;%dH", y + 1, x + 1);
+}
+
+static void ansiFlush() {
+    pthread_mutex_lock(&lock);
+    int len = 0;
+    int cy = -1;
+    int cx = -1;
+    if(!hidden) {
+        len += sprintf(out + len, "\x1b[?25l");
+        hidden = true;
+    }
+    if(cleared) {
+        len += sprintf(out + len, "\x1b[H\x1b[2J");
+        cy = 0;
+        cx = 0;
+        for(int y = 0; y < rows; y++) {
+            dirty[y] = true;
+        }
+        cleared = false;
+    }
+    for(int y = 0; y < rows; y++) {
+        if(!dirty[y]) {
+            continue;
+        }
+        dirty[y] = false;
+        for(int x = 0; x < cols; x++) {
+            if(cur[y][x] == prev[y][x]) {
+                continue;
+            }
+            if(cy == y && x >= cx && x - cx < ANSI_MOVE_COST) {
+                // the skipped cells are unchanged, so rewriting them is safe
+                memcpy(out + len, &cur[y][cx], x - cx);
+                len += x - cx;
+            } else {
+                len += moveTo(out + len, y, x);
+            }
+            out[len++] = cur[y][x];
+            prev[y][x] = cur[y][x];
+            cy = y;
+            cx = x + 1;
+            if(cx >= cols) {
+                cy = -1;
+            }
+        }
+    }
+    int done = 0;
+    while(done < len) {
+        int n = write(fd, out + done, len - done);
+        if(n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    bytes += done;
+    pthread_mutex_unlock(&lock);
+}
+
+RenderBackend render_ansi = {
+    "ansi",
+    ansiInit,
+    ansiPut,
+    ansiClear,
+    ansiFlush,
+};
+
+int render_ansi_enable() {
+#ifdef _WIN32
+    // the console prints escapes as text unless told to interpret them
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+    HANDLE h = (HANDLE)_get_osfhandle(fd);
+    DWORD mode;
+    if(h == INVALID_HANDLE_VALUE || !GetConsoleMode(h, &mode)) {
+        return 1;
+    }
+    if(!SetConsoleMode(h, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+void render_ansi_set_fd(int f) {
+    fd = f;
+}
+
+uint64_t render_ansi_bytes() {
+    return bytes;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "render.h"
+
+static char grid[RENDER_ROWS][RENDER_COLS + 1];
+static uint64_t frames;
+
+static void memInit() {
+    for(int y = 0; y < RENDER_ROWS; y++) {
+        memset(grid[y], ' ', RENDER_COLS);
+        grid[y][RENDER_COLS] = '\0';
+    }
+    frames = 0;
+}
+
+static void memPut(int y, int x, const char *s) {
+    if(y < 0 || y >= RENDER_ROWS) {
+        return;
+    }
+    for(; *s && x < RENDER_COLS; s++, x++) {
+        if(x >= 0) {
+            grid[y][x] = *s;
+        }
+    }
+}
+
+static void memClear() {
+    for(int y = 0; y < RENDER_ROWS; y++) {
+        memset(grid[y], ' ', RENDER_COLS);
+    }
+}
+
+static void memFlush() {
+    frames++;
+}
+
+RenderBackend render_mem = {
+    "mem",
+    memInit,
+    memPut,
+    memClear,
+    memFlush,
+};
+
+const char *render_mem_row(int y) {
+    return grid[y];
+}
+
+uint64_t render_mem_frames() {
+    return frames;
+}
+
+uint64_t render_mem_hash() {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(int y = 0; y < RENDER_ROWS; y++) {
+        for(int x = 0; x < RENDER_COLS; x++) {
+            h ^= (unsigned char)grid[y][x];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+static int rowLength(int y) {
+    int len = RENDER_COLS;
+    while(len > 0 && grid[y][len-1] == ' ') {
+        len--;
+    }
+    return len;
+}
+
+int render_mem_save(const char *path) {
+    FILE *fp = fopen(path, "w+");
+    if(!fp) {
+        return 1;
+    }
+    int last = RENDER_ROWS;
+    while(last > 0 && rowLength(last-1) == 0) {
+        last--;
+    }
+    for(int y = 0; y < last; y++) {
+        fwrite(grid[y], 1, rowLength(y), fp);
+        fputc('\n', fp);
+    }
+    fclose(fp);
+    return 0;
+}
+
+int render_mem_compare(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if(!fp) {
+        return -1;
+    }
+    char line[RENDER_COLS + 2];
+    int result = 0;
+    for(int y = 0; y < RENDER_ROWS && result == 0; y++) {
+        int len = 0;
+        if(fgets(line, sizeof(line), fp)) {
+            len = strcspn(line, "\r\n");
+        }
+        if(len != rowLength(y) || memcmp(line, grid[y], len) != 0) {
+            result = y + 1;
+        }
+    }
+    fclose(fp);
+    return result;
+}
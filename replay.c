@@ -0,0 +1,406 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "timer.h"
+
+#define RUN_SHORT ((1 << (8 - REPLAY_RUN_BITS)) - 1)
+#define INPUT_MASK ((1 << REPLAY_RUN_BITS) - 1)
+
+static int reserve(void **buf, size_t *cap, size_t need, size_t size) {
+    if(need <= *cap) {
+        return 0;
+    }
+    size_t n = *cap ? *cap * 2 : 1024;
+    while(n < need) {
+        n *= 2;
+    }
+    void *p = realloc(*buf, n * size);
+    if(p == NULL) {
+        return 1;
+    }
+    *buf = p;
+    *cap = n;
+    return 0;
+}
+
+static int putByte(Replay *r, uint8_t b) {
+    if(reserve((void **)&r->stream, &r->streamCap, r->header.streamBytes + 1, 1)) {
+        return 1;
+    }
+    r->stream[r->header.streamBytes++] = b;
+    return 0;
+}
+
+static int flushRun(Replay *r) {
+    if(r->runLength == 0) {
+        return 0;
+    }
+    uint32_t run = r->runLength;
+    r->runLength = 0;
+    if(run <= RUN_SHORT) {
+        return putByte(r, r->runInput | (run - 1) << REPLAY_RUN_BITS);
+    }
+    if(putByte(r, r->runInput | RUN_SHORT << REPLAY_RUN_BITS)) {
+        return 1;
+    }
+    run -= RUN_SHORT + 1;
+    while(run >= 0x80) {
+        if(putByte(r, (run & 0x7f) | 0x80)) {
+            return 1;
+        }
+        run >>= 7;
+    }
+    return putByte(r, run);
+}
+
+uint8_t replay_next_input(Replay *r, ReplayCursor *c) {
+    if(c->remaining == 0) {
+        if(c->offset >= r->header.streamBytes) {
+            return 0;
+        }
+        uint8_t b = r->stream[c->offset++];
+        c->input = b & INPUT_MASK;
+        c->remaining = (b >> REPLAY_RUN_BITS) + 1;
+        if(c->remaining == RUN_SHORT + 1) {
+            uint32_t extra = 0;
+            int shift = 0;
+            uint8_t v;
+            do {
+                v = c->offset < r->header.streamBytes ? r->stream[c->offset++] : 0;
+                extra |= (uint32_t)(v & 0x7f) << shift;
+                shift += 7;
+            } while((v & 0x80) && shift < 32);
+            c->remaining += extra;
+        }
+    }
+    c->remaining--;
+    return c->input;
+}
+
+void replay_init(Replay *r, unsigned int seed, int level) {
+    memset(r, 0, sizeof(*r));
+    memcpy(r->header.magic, REPLAY_MAGIC, 4);
+    r->header.version = REPLAY_VERSION;
+    r->header.keyInterval = REPLAY_KEY_INTERVAL;
+    r->header.seed = seed;
+    r->header.level = level;
+}
+
+void replay_free(Replay *r) {
+    free(r->stream);
+    free(r->keys);
+    r->stream = NULL;
+    r->keys = NULL;
+}
+
+int replay_record(Replay *r, const GameSim *g, uint8_t input) {
+    ReplayHeader *h = &r->header;
+    if(g->pieces >= h->keyframes * h->keyInterval) {
+        if(flushRun(r) || reserve((void **)&r->keys, &r->keysCap, h->keyframes + 1, sizeof(ReplayKeyframe))) {
+            return 1;
+        }
+        ReplayKeyframe *k = &r->keys[h->keyframes++];
+        k->frame = h->frames;
+        k->piece = g->pieces;
+        k->offset = h->streamBytes;
+        state_pack(&k->state, g);
+    }
+    input &= INPUT_MASK;
+    if(r->runLength > 0 && input != r->runInput && flushRun(r)) {
+        return 1;
+    }
+    r->runInput = input;
+    r->runLength++;
+    h->frames++;
+    h->pieces = g->pieces;
+    return 0;
+}
+
+int replay_save(Replay *r, const char *path) {
+    if(flushRun(r)) {
+        return 1;
+    }
+    FILE *fp = fopen(path, "wb");
+    if(!fp) {
+        return 1;
+    }
+    size_t ok = fwrite(&r->header, sizeof(ReplayHeader), 1, fp);
+    ok += fwrite(r->stream, 1, r->header.streamBytes, fp) == r->header.streamBytes;
+    ok += fwrite(r->keys, sizeof(ReplayKeyframe), r->header.keyframes, fp) == r->header.keyframes;
+    fclose(fp);
+    return ok == 3 ? 0 : 1;
+}
+
+int replay_load(Replay *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    FILE *fp = fopen(path, "rb");
+    if(!fp) {
+        return 1;
+    }
+    ReplayHeader *h = &r->header;
+    if(fread(h, sizeof(ReplayHeader), 1, fp) != 1
+       || memcmp(h->magic, REPLAY_MAGIC, 4) != 0
+       || h->version != REPLAY_VERSION
+       || h->keyInterval == 0) {
+        fclose(fp);
+        return 1;
+    }
+    r->stream = malloc(h->streamBytes + 1);
+    r->keys = malloc(h->keyframes * sizeof(ReplayKeyframe) + 1);
+    r->streamCap = h->streamBytes;
+    r->keysCap = h->keyframes;
+    if(r->stream == NULL || r->keys == NULL
+       || fread(r->stream, 1, h->streamBytes, fp) != h->streamBytes
+       || fread(r->keys, sizeof(ReplayKeyframe), h->keyframes, fp) != h->keyframes) {
+        fclose(fp);
+        replay_free(r);
+        return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+void replay_start(Replay *r, GameSim *g, ReplayCursor *c) {
+    sim_init(g, r->header.seed, r->header.level);
+    memset(c, 0, sizeof(*c));
+}
+
+static void fromKey(Replay *r, uint32_t k, GameSim *g, ReplayCursor *c) {
+    ReplayKeyframe *key = &r->keys[k];
+    sim_init(g, r->header.seed, r->header.level);
+    state_unpack(g, &key->state);
+    g->pieces = key->piece;
+    c->offset = key->offset;
+    c->remaining = 0;
+}
+
+int replay_seek_frame(Replay *r, uint32_t frame, GameSim *g) {
+    if(r->header.keyframes == 0 || frame > r->header.frames) {
+        return 1;
+    }
+    // last keyframe at or before frame
+    uint32_t lo = 0;
+    uint32_t hi = r->header.keyframes;
+    while(hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if(r->keys[mid].frame <= frame) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    ReplayCursor c;
+    fromKey(r, lo, g, &c);
+    for(uint32_t f = r->keys[lo].frame; f < frame; f++) {
+        sim_step(g, replay_next_input(r, &c));
+    }
+    return 0;
+}
+
+int replay_seek_piece(Replay *r, uint32_t piece, GameSim *g) {
+    uint32_t k = piece / r->header.keyInterval;
+    if(k >= r->header.keyframes) {
+        return 1;
+    }
+    ReplayCursor c;
+    fromKey(r, k, g, &c);
+    uint32_t end = k + 1 < r->header.keyframes ? r->keys[k+1].frame : r->header.frames;
+    for(uint32_t f = r->keys[k].frame; f < end && g->pieces < piece; f++) {
+        sim_step(g, replay_next_input(r, &c));
+    }
+    return g->pieces == piece ? 0 : 1;
+}
+
+static void printBoard(GameSim *g) {
+    char rows[MATRIX_LENGTH-1][MATRIX_WIDTH+1];
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            rows[i][j] = g->matrix[i][j] ? '#' : '.';
+        }
+        rows[i][MATRIX_WIDTH] = '\0';
+    }
+    for(int i = 0; i < 4; i++) {
+        int y = g->t.current_xy[i].y;
+        int x = matrixtoblock(g->t.current_xy[i].x);
+        if(y >= 0 && y < MATRIX_LENGTH-1 && x >= 0 && x < MATRIX_WIDTH) {
+            rows[y][x] = '@';
+        }
+    }
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        printf("|%s|\n", rows[i]);
+    }
+    printf("score %d level %d pieces %u\n", g->score, g->level, g->pieces);
+}
+
+// Lowest column of the board, ties broken by rng.
+static int lowestColumn(GameSim *g, unsigned int rng) {
+    int best = 0;
+    int bestDepth = -1;
+    for(int k = 0; k < MATRIX_WIDTH; k++) {
+        int j = (k + rng) % MATRIX_WIDTH;
+        int depth = 0;
+        while(depth < MATRIX_LENGTH-1 && !g->matrix[depth][j]) {
+            depth++;
+        }
+        if(depth > bestDepth) {
+            best = j;
+            bestDepth = depth;
+        }
+    }
+    return best;
+}
+
+// Records a game where every piece gets a random rotation and is steered to
+// the lowest column, for trying the format out.
+int replay_record_random(const char *path, uint32_t frames, unsigned int seed) {
+    Replay r;
+    GameSim g;
+    replay_init(&r, seed, 1);
+    sim_init(&g, seed, 1);
+    unsigned int rng = seed ^ 0x5bd1e995u;
+    uint32_t piece = UINT32_MAX;
+    int rotations = 0;
+    int target = 0;
+    int lastX = -1;
+    for(uint32_t f = 0; f < frames && !g.over; f++) {
+        if(g.pieces != piece) {
+            piece = g.pieces;
+            rng = (rng * 1103515245u) + 12345u;
+            rotations = (rng >> 16) & 3;
+            target = lowestColumn(&g, rng >> 20);
+        }
+        int x = MATRIX_WIDTH;
+        for(int i = 0; i < 4; i++) {
+            int col = matrixtoblock(g.t.current_xy[i].x);
+            x = col < x ? col : x;
+        }
+        uint8_t input = 0;
+        if(rotations > 0 && f % 2 == 0) {
+            input = SIM_ROTATE;
+            rotations--;
+        } else if(x < target) {
+            input = SIM_RIGHT;
+        } else if(x > target) {
+            input = SIM_LEFT;
+        }
+        // drop once there, or when the wall or a block is in the way
+        if(rotations == 0 && (x == target || x == lastX)) {
+            input |= SIM_DROP;
+        }
+        lastX = x;
+        if(replay_record(&r, &g, input)) {
+            replay_free(&r);
+            return 1;
+        }
+        sim_step(&g, input);
+    }
+    int err = replay_save(&r, path);
+    printf("recorded %u frames %u pieces into %u bytes\n", r.header.frames, r.header.pieces,
+           (unsigned int)(sizeof(ReplayHeader) + r.header.streamBytes + r.header.keyframes * sizeof(ReplayKeyframe)));
+    replay_free(&r);
+    return err;
+}
+
+static void info(Replay *r) {
+    ReplayHeader *h = &r->header;
+    size_t total = sizeof(ReplayHeader) + h->streamBytes + h->keyframes * sizeof(ReplayKeyframe);
+    printf("seed %u level %u frames %u pieces %u\n", h->seed, h->level, h->frames, h->pieces);
+    printf("inputs %u bytes (%.3f per frame)\n", h->streamBytes, h->frames ? h->streamBytes / (double)h->frames : 0.0);
+    printf("keyframes %u every %u pieces, %u bytes\n", h->keyframes, h->keyInterval,
+           (unsigned int)(h->keyframes * sizeof(ReplayKeyframe)));
+    printf("total %u bytes\n", (unsigned int)total);
+}
+
+// Replays the whole game once and checks every keyframe and a seek to every
+// 7th frame against it, then seeks to every piece.
+static int verify(Replay *r) {
+    GameSim full;
+    GameSim seek;
+    PackedState a;
+    PackedState b;
+    ReplayCursor c;
+    uint32_t k = 0;
+    uint64_t seekNs = 0;
+    uint32_t seeks = 0;
+    replay_start(r, &full, &c);
+    for(uint32_t f = 0; f <= r->header.frames; f++) {
+        state_pack(&a, &full);
+        if(k < r->header.keyframes && r->keys[k].frame == f) {
+            if(memcmp(&a, &r->keys[k].state, sizeof(a)) != 0 || r->keys[k].piece != full.pieces) {
+                printf("keyframe %u at frame %u does not match\n", k, f);
+                return 1;
+            }
+            k++;
+        }
+        if(f % 7 == 0) {
+            uint64_t start = timer_now_ns();
+            replay_seek_frame(r, f, &seek);
+            seekNs += timer_now_ns() - start;
+            seeks++;
+            state_pack(&b, &seek);
+            if(memcmp(&a, &b, sizeof(a)) != 0) {
+                printf("seek to frame %u does not match\n", f);
+                return 1;
+            }
+        }
+        if(f < r->header.frames) {
+            sim_step(&full, replay_next_input(r, &c));
+        }
+    }
+    for(uint32_t p = 0; p < r->header.pieces; p++) {
+        if(replay_seek_piece(r, p, &seek)) {
+            printf("seek to piece %u failed\n", p);
+            return 1;
+        }
+    }
+    printf("ok %u keyframes, %u seeks averaging %.1fus\n", k, seeks, seeks ? seekNs / 1e3 / seeks : 0.0);
+    return 0;
+}
+
+int replay_main(int argc, char *argv[]) {
+    if(argc < 3) {
+        fprintf(stderr, "usage: replay record <file> <frames> [seed]\n"
+                        "       replay info <file>\n"
+                        "       replay seek <file> <frame>\n"
+                        "       replay verify <file>\n");
+        return EXIT_FAILURE;
+    }
+    if(strcmp(argv[1], "record") == 0) {
+        uint32_t frames = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 100000;
+        unsigned int seed = argc > 4 ? (unsigned int)strtoul(argv[4], NULL, 10) : 1;
+        if(replay_record_random(argv[2], frames, seed)) {
+            fprintf(stderr, "unable to write %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    Replay r;
+    if(replay_load(&r, argv[2])) {
+        fprintf(stderr, "unable to read %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    int err = 0;
+    if(strcmp(argv[1], "info") == 0) {
+        info(&r);
+    } else if(strcmp(argv[1], "seek") == 0 && argc > 3) {
+        GameSim g;
+        uint64_t start = timer_now_ns();
+        err = replay_seek_frame(&r, (uint32_t)strtoul(argv[3], NULL, 10), &g);
+        uint64_t elapsed = timer_now_ns() - start;
+        if(!err) {
+            printBoard(&g);
+            printf("seek took %.1fus\n", elapsed / 1e3);
+        } else {
+            fprintf(stderr, "frame out of range, replay has %u frames\n", r.header.frames);
+        }
+    } else if(strcmp(argv[1], "verify") == 0) {
+        err = verify(&r);
+    } else {
+        fprintf(stderr, "unknown replay command %s\n", argv[1]);
+        err = 1;
+    }
+    replay_free(&r);
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
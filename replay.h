@@ -0,0 +1,97 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+#include "state.h"
+
+// A replay is the seed, the starting level and one input byte per frame of a
+// GameSim. Inputs are run length coded, most frames press nothing:
+//   byte = input | (run - 1) << 5            runs of 1 to 7
+//   byte = input | 7 << 5, varint(run - 8)   longer runs
+// Every REPLAY_KEY_INTERVAL pieces a keyframe stores the packed state and
+// where its inputs start in the stream, so seeking re-simulates at most that
+// many pieces. Runs never cross a keyframe.
+//
+// File: ReplayHeader, the input stream, then the keyframes. All fields are
+// little endian.
+#define REPLAY_MAGIC "TRPL"
+#define REPLAY_VERSION 1
+#define REPLAY_KEY_INTERVAL 32
+#define REPLAY_RUN_BITS 5
+#define REPLAY_DEFAULT_FILE "data/replay.trp"
+
+typedef struct ReplayHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t keyInterval;
+    uint32_t seed;
+    uint32_t level;
+    uint32_t frames;
+    uint32_t pieces;
+    uint32_t keyframes;
+    uint32_t streamBytes;
+} ReplayHeader;
+
+typedef struct ReplayKeyframe {
+    uint32_t frame;
+    uint32_t piece;
+    uint32_t offset;       // into the input stream
+    PackedState state;     // before this frame's input
+} ReplayKeyframe;
+
+_Static_assert(sizeof(ReplayHeader) == 32, "ReplayHeader layout changed");
+_Static_assert(sizeof(ReplayKeyframe) == 84, "ReplayKeyframe layout changed");
+
+// Position in the input stream while replaying.
+typedef struct ReplayCursor {
+    uint32_t offset;
+    uint8_t input;
+    uint32_t remaining;
+} ReplayCursor;
+
+typedef struct Replay {
+    ReplayHeader header;
+    uint8_t *stream;
+    size_t streamCap;
+    ReplayKeyframe *keys;
+    size_t keysCap;
+    uint8_t runInput;      // writer: run not yet in the stream
+    uint32_t runLength;
+} Replay;
+
+void replay_init(Replay *r, unsigned int seed, int level);
+
+void replay_free(Replay *r);
+
+// Records input for the frame about to be simulated on g. Call before
+// sim_step(g, input).
+int replay_record(Replay *r, const GameSim *g, uint8_t input);
+
+int replay_save(Replay *r, const char *path);
+
+int replay_load(Replay *r, const char *path);
+
+// Starts g and c at the first frame.
+void replay_start(Replay *r, GameSim *g, ReplayCursor *c);
+
+// Input for the next frame, 0 past the end.
+uint8_t replay_next_input(Replay *r, ReplayCursor *c);
+
+// Puts g in the state before frame, from the nearest earlier keyframe.
+int replay_seek_frame(Replay *r, uint32_t frame, GameSim *g);
+
+// Puts g at the first frame of piece (pieces locked so far), the keyframe is
+// found by division.
+int replay_seek_piece(Replay *r, uint32_t piece, GameSim *g);
+
+// Records a game of up to frames frames by a simple bot that rotates, walks
+// to the lowest column and drops, and saves it to path.
+int replay_record_random(const char *path, uint32_t frames, unsigned int seed);
+
+// Command line entry: replay <record|info|seek|verify> <file> [...]
+int replay_main(int argc, char *argv[]);
+
+#endif
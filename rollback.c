@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rollback.h"
+#include "timer.h"
+#include "render.h"
+
+#define REMOTE_SLOT(f) ((f) % (2 * ROLLBACK_WINDOW))
+
+static void put32(unsigned char *p, int64_t v) {
+    p[0] = (v >> 24) & 0xff;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+// -1 goes out as 0xffffffff and comes back as -1
+static int64_t get32(const unsigned char *p) {
+    return (int32_t)(((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+// Newer in 8 bit serial arithmetic, so the sequence can wrap.
+static bool newer(uint8_t a, uint8_t b) {
+    return (int8_t)(a - b) > 0;
+}
+
+static void sendPacket(Rollback *rb) {
+    unsigned char p[ROLLBACK_PACKET];
+    // the newest input in the packet is for the frame just simulated
+    int64_t last = (int64_t)rb->frame - 1;
+    // everything the opponent hasn't acknowledged, never less than the
+    // redundancy; the stall check keeps it within the window
+    int64_t n = last - rb->localAcked;
+    if(n < ROLLBACK_REDUNDANCY) {
+        n = ROLLBACK_REDUNDANCY;
+    }
+    if(n > ROLLBACK_WINDOW) {
+        n = ROLLBACK_WINDOW;
+    }
+    if(n > last + 1) {
+        n = last + 1;
+    }
+    memset(p, 0, sizeof(p));
+    put32(p, last);
+    put32(p + 4, rb->remoteConfirmed);
+    p[8] = (unsigned char)n;
+    for(int k = 0; k < n; k++) {
+        p[ROLLBACK_INPUTS+k] = rb->localInputs[(last - n + 1 + k) % ROLLBACK_WINDOW];
+    }
+    p[ROLLBACK_CTRL] = rb->ctrlSeq;
+    p[ROLLBACK_CTRL+1] = rb->ctrlMsg;
+    p[ROLLBACK_CTRL+2] = rb->peerCtrlSeq;
+    p[ROLLBACK_CTRL+3] = (unsigned char)rb->level;
+    if(transport_send(rb->net, p)) {
+        rb->disconnected = true;
+    }
+    rb->lastSend = timer_now_ns();
+}
+
+static void startGames(Rollback *rb, int level) {
+    rb->level = level;
+    sim_init(&rb->local, rb->seed, level);
+    sim_init(&rb->remote, rb->seed, level);
+    replay_free(&rb->replay);
+    replay_init(&rb->replay, rb->seed, level);
+}
+
+// Returns the earliest already simulated frame whose prediction was wrong,
+// or rb->frame if nothing needs to be re-simulated. Packets can come twice
+// or out of order, only the next missing input is ever taken.
+static uint32_t applyPacket(Rollback *rb, const unsigned char *p) {
+    uint32_t rollbackFrom = rb->frame;
+    if(rb->level == 0 && p[ROLLBACK_CTRL+3] != 0) {
+        // nothing is simulated yet, so the games can start over
+        startGames(rb, p[ROLLBACK_CTRL+3]);
+    }
+    int64_t last = get32(p);
+    int64_t ack = get32(p + 4);
+    int n = p[8] <= ROLLBACK_WINDOW ? p[8] : ROLLBACK_WINDOW;
+    if(last > rb->remoteLast) {
+        rb->remoteLast = last;
+    }
+    if(ack > rb->localAcked) {
+        rb->localAcked = ack;
+    }
+    for(int k = 0; k < n; k++) {
+        int64_t f = last - n + 1 + k;
+        if(f < 0 || f != rb->remoteConfirmed + 1) {
+            continue;
+        }
+        uint8_t input = p[ROLLBACK_INPUTS+k];
+        if(f < rb->frame && rb->remoteInputs[REMOTE_SLOT(f)] != input && f < rollbackFrom) {
+            rollbackFrom = (uint32_t)f;
+        }
+        rb->remoteInputs[REMOTE_SLOT(f)] = input;
+        rb->remoteConfirmed = f;
+    }
+    uint8_t seq = p[ROLLBACK_CTRL];
+    if(newer(seq, rb->peerCtrlSeq)) {
+        rb->peerCtrlSeq = seq;
+        if(p[ROLLBACK_CTRL+1] == ROLLBACK_CTRL_OVER) {
+            rb->remoteOver = true;
+        }
+    }
+    uint8_t ctrlAck = p[ROLLBACK_CTRL+2];
+    if(newer(ctrlAck, rb->ctrlAcked)) {
+        rb->ctrlAcked = ctrlAck;
+    }
+    return rollbackFrom;
+}
+
+static uint8_t remoteInput(Rollback *rb, uint32_t f) {
+    if((int64_t)f > rb->remoteConfirmed) {
+        // predict the opponent pressed nothing
+        rb->remoteInputs[REMOTE_SLOT(f)] = 0;
+    }
+    return rb->remoteInputs[REMOTE_SLOT(f)];
+}
+
+static void saveSnapshot(Rollback *rb, uint32_t f) {
+    PackedState p;
+    state_pack(&p, &rb->remote);
+    state_ring_save(&rb->snapshots, f, &p);
+    rb->snapshotPieces[f % STATE_RING_SIZE] = rb->remote.pieces;
+}
+
+static void resimulate(Rollback *rb, uint32_t from) {
+    uint64_t start = timer_now_ns();
+    PackedState p;
+    state_ring_load(&rb->snapshots, from, &p);
+    state_unpack(&rb->remote, &p);
+    rb->remote.pieces = rb->snapshotPieces[from % STATE_RING_SIZE];
+    for(uint32_t f = from; f < rb->frame; f++) {
+        saveSnapshot(rb, f);
+        sim_step(&rb->remote, remoteInput(rb, f));
+        rb->resimFrames++;
+    }
+    rb->rollbacks++;
+    histogram_record(&rb->resim, timer_now_ns() - start);
+}
+
+void rollback_open(Rollback *rb, Transport *net, unsigned int seed, int level) {
+    memset(rb, 0, sizeof(*rb));
+    rb->net = net;
+    rb->seed = seed;
+    rb->remoteConfirmed = -1;
+    rb->remoteLast = -1;
+    rb->localAcked = -1;
+    rb->lastReceive = timer_now_ns();
+    histogram_reset(&rb->resim);
+    // the joiner draws level 1 boards until the host's level arrives
+    startGames(rb, level > 0 ? level : 1);
+    rb->level = level;
+}
+
+void rollback_receive(Rollback *rb) {
+    uint32_t rollbackFrom = rb->frame;
+    unsigned char p[TRANSPORT_MAX_PACKET];
+    int r;
+    while(!rb->disconnected && (r = transport_recv(rb->net, p)) != 0) {
+        if(r < 0) {
+            rb->disconnected = true;
+            break;
+        }
+        rb->lastReceive = timer_now_ns();
+        uint32_t from = applyPacket(rb, p);
+        if(from < rollbackFrom) {
+            rollbackFrom = from;
+        }
+    }
+    // over UDP silence is the only sign the opponent left
+    if(timer_now_ns() - rb->lastReceive > ROLLBACK_TIMEOUT_MS * 1000000ULL) {
+        rb->disconnected = true;
+    }
+    if(rollbackFrom < rb->frame) {
+        resimulate(rb, rollbackFrom);
+    }
+}
+
+bool rollback_stalled(Rollback *rb) {
+    // don't run further ahead than the snapshots reach back, or than the
+    // unacknowledged inputs fit in a packet
+    if(rb->level > 0 && (int64_t)rb->frame - rb->remoteConfirmed < ROLLBACK_WINDOW &&
+       (int64_t)rb->frame - rb->localAcked < ROLLBACK_WINDOW) {
+        return false;
+    }
+    rb->stalls++;
+    // both sides may be waiting on a lost packet
+    if(rb->frame > 0 && timer_now_ns() - rb->lastSend >= SIM_FRAME_NS) {
+        sendPacket(rb);
+        rb->resends++;
+    }
+    return true;
+}
+
+void rollback_step(Rollback *rb, uint8_t input) {
+    rb->localInputs[rb->frame % ROLLBACK_WINDOW] = input;
+    replay_record(&rb->replay, &rb->local, input);
+    sim_step(&rb->local, input);
+    saveSnapshot(rb, rb->frame);
+    sim_step(&rb->remote, remoteInput(rb, rb->frame));
+    rb->frame++;
+    sendPacket(rb);
+}
+
+void rollback_finish(Rollback *rb) {
+    rb->ctrlSeq++;
+    rb->ctrlMsg = ROLLBACK_CTRL_OVER;
+    sendPacket(rb);
+    uint64_t until = timer_now_ns() + ROLLBACK_LINGER_MS * 1000000ULL;
+    while(!rb->disconnected && timer_now_ns() < until) {
+        rollback_receive(rb);
+        if(rb->ctrlAcked == rb->ctrlSeq && rb->remoteOver && rb->remoteConfirmed >= rb->remoteLast) {
+            break;
+        }
+        if(timer_now_ns() - rb->lastSend >= SIM_FRAME_NS) {
+            sendPacket(rb);
+            rb->resends++;
+        }
+        transport_wait(rb->net, 1);
+    }
+    if(!rb->disconnected) {
+        // acknowledges the opponent's over, it may still be waiting for that
+        sendPacket(rb);
+    }
+}
+
+void rollback_free(Rollback *rb) {
+    replay_free(&rb->replay);
+}
+
+static void drawPreview(GameSim *g) {
+    eraseNext(g->next, 0);
+    drawNext(g->next, 0);
+    for(int i = 12; i < 16; i++) {
+        render_printf(i, 39, "             ");
+    }
+    if(g->heldExists) {
+        drawHeld(g->held, 0);
+    }
+}
+
+static void drawFrame(Rollback *rb) {
+    sim_draw(&rb->local, 0);
+    sim_draw(&rb->remote, 55);
+    drawPreview(&rb->local);
+    render_printf(28, 60, "rollbacks %6llu resim p99 %5lluus",
+                  (unsigned long long)rb->rollbacks,
+                  (unsigned long long)(histogram_percentile(&rb->resim, 99) / 1000));
+    render_printf(29, 60, "frame %7u behind %3lld stalls %5llu", rb->frame,
+                  (long long)(rb->frame - 1 - rb->remoteConfirmed),
+                  (unsigned long long)rb->stalls);
+    render_printf(30, 60, "%s sent %7llu recv %7llu resent %5llu", rb->net->name,
+                  (unsigned long long)rb->net->sent,
+                  (unsigned long long)rb->net->received,
+                  (unsigned long long)rb->resends);
+    render_flush();
+}
+
+void rollback_run(Transport *net, unsigned int seed, int level) {
+    Rollback *rb = malloc(sizeof(Rollback));
+    if(rb == NULL) {
+        return;
+    }
+    rollback_open(rb, net, seed, level);
+
+    render_clear();
+    drawBoard(0, rb->local.level, 0);
+    drawBoard(0, rb->remote.level, 55);
+    timeout(0);
+
+    bool quit = false;
+    uint64_t nextFrame = timer_now_ns();
+    while(!quit && !rb->disconnected) {
+        rollback_receive(rb);
+        if(rb->remoteOver || rb->local.over) {
+            break;
+        }
+        if(rollback_stalled(rb)) {
+            transport_wait(rb->net, 1);
+            continue;
+        }
+
+        uint8_t input = 0;
+        int key;
+        while((key = wgetch(stdscr)) != ERR) {
+            if(key == ESC_KEY) {
+                quit = true;
+            }
+            input |= sim_input_for_key(key);
+        }
+        rollback_step(rb, input);
+
+        drawFrame(rb);
+        nextFrame += SIM_FRAME_NS;
+        uint64_t now = timer_now_ns();
+        if(now < nextFrame) {
+            usleep((nextFrame - now) / 1000);
+        } else {
+            nextFrame = now;
+        }
+    }
+    if(!rb->disconnected) {
+        rollback_finish(rb);
+    }
+    score = rb->local.score;
+    timeout(delay);
+    replay_save(&rb->replay, REPLAY_DEFAULT_FILE);
+    rollback_free(rb);
+    free(rb);
+}
+
+// The impairment shim, if asked for, works on what this side sends.
+static void impairIfAsked(Transport *net) {
+    if(impair_enabled(&impairment)) {
+        transport_impair(net, &impairment, (unsigned int)timer_now_ns());
+    }
+}
+
+int rollback_host(char *port) {
+    Transport net;
+    render_printf(13, 26, "WAITING FOR OPPONENT");
+    render_flush();
+    int err = udpTransport ? transport_udp_host(&net, port, ROLLBACK_PACKET)
+                           : transport_listen(&net, port, ROLLBACK_PACKET) || transport_accept(&net);
+    if(err) {
+        return 1;
+    }
+    impairIfAsked(&net);
+    rollback_run(&net, (unsigned int)atoi(port), level);
+    transport_close(&net);
+    return 0;
+}
+
+int rollback_join(Config config) {
+    Transport net;
+    int err = udpTransport ? transport_udp_join(&net, config, ROLLBACK_PACKET)
+                           : transport_join(&net, config, ROLLBACK_PACKET);
+    if(err) {
+        return 1;
+    }
+    impairIfAsked(&net);
+    // the games start at the host's level, whatever ours is
+    rollback_run(&net, (unsigned int)atoi(config.port), 0);
+    transport_close(&net);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef ROLLBACK_H_
+#define ROLLBACK_H_
+
+#include <stdint.h>
+
+#include "tcp_client.h"
+#include "tcp_server.h"
+#include "histogram.h"
+#include "sim.h"
+#include "state.h"
+#include "replay.h"
+#include "transport.h"
+
+// Both players simulate both games from the same seed and only exchange
+// inputs. Local inputs apply immediately; the opponent is predicted to press
+// nothing and when their real inputs arrive late the opponent's game is
+// restored from a snapshot and re-simulated up to the current frame.
+#define ROLLBACK_WINDOW 32      // frames of opponent history kept, about 0.5s
+#define ROLLBACK_REDUNDANCY 8   // fewest inputs repeated in every packet
+#define ROLLBACK_INPUTS 9       // offset of the inputs in a packet
+#define ROLLBACK_CTRL (ROLLBACK_INPUTS + ROLLBACK_WINDOW)   // seq, message, ack, start level
+#define ROLLBACK_PACKET (ROLLBACK_CTRL + 4)
+#define ROLLBACK_TIMEOUT_MS 3000         // nothing heard for this long and the opponent is gone
+#define ROLLBACK_LINGER_MS 1000          // how long the end of a match is repeated for
+
+// Control messages, sent until the other side acknowledges them.
+#define ROLLBACK_CTRL_OVER 0x01
+
+_Static_assert(ROLLBACK_WINDOW <= STATE_RING_SIZE, "snapshot ring too small for the rollback window");
+_Static_assert(ROLLBACK_PACKET <= TRANSPORT_MAX_PACKET, "rollback packet too big for the transport");
+
+// Every packet carries the sender's last frame, the last opponent frame it
+// has (an ack), and its inputs from just after that ack up to the last
+// frame, at least ROLLBACK_REDUNDANCY of them. A lost datagram is covered by
+// the next one, so UDP needs no retransmits for inputs. Control messages
+// ride along with a sequence number and are repeated until acknowledged.
+// Both games start at the host's level, which the joiner takes from the
+// first packet before it simulates anything.
+typedef struct Rollback {
+    unsigned int seed;
+    int level;                           // start level of both games, 0 until the joiner knows it
+    GameSim local;
+    GameSim remote;
+    StateRing snapshots;                 // opponent state before each frame
+    uint32_t snapshotPieces[STATE_RING_SIZE];    // and its piece count, which isn't packed
+    uint8_t localInputs[ROLLBACK_WINDOW];
+    uint8_t remoteInputs[2 * ROLLBACK_WINDOW];   // the opponent can be a window ahead as well as behind
+    uint32_t frame;                      // next frame to simulate
+    int64_t remoteConfirmed;             // last opponent frame received, -1 before any
+    int64_t remoteLast;                  // last frame the opponent has simulated
+    int64_t localAcked;                  // last of our frames the opponent has
+    bool remoteOver;
+    uint8_t ctrlSeq;                     // our last control message
+    uint8_t ctrlMsg;
+    uint8_t ctrlAcked;
+    uint8_t peerCtrlSeq;                 // their last control message we took
+    Transport *net;
+    bool disconnected;
+    uint64_t lastSend;
+    uint64_t lastReceive;
+    uint64_t rollbacks;
+    uint64_t resimFrames;
+    uint64_t stalls;
+    uint64_t resends;                    // packets repeated while stalled or lingering
+    Histogram resim;
+    Replay replay;                       // local game, saved to REPLAY_DEFAULT_FILE
+} Rollback;
+
+// level is the host's start level, or 0 on the joining side.
+void rollback_open(Rollback *rb, Transport *net, unsigned int seed, int level);
+
+// Takes in whatever the opponent sent and re-simulates if a prediction was
+// wrong.
+void rollback_receive(Rollback *rb);
+
+// True if the opponent is too far behind to simulate another frame, or the
+// joiner doesn't know the start level yet. Keeps repeating the last packet
+// meanwhile, in case it was lost.
+bool rollback_stalled(Rollback *rb);
+
+// Simulates the next frame of both games and sends the local input.
+void rollback_step(Rollback *rb, uint8_t input);
+
+// Tells the opponent the match is over and waits until it knows, has sent
+// all its inputs, or ROLLBACK_LINGER_MS passes.
+void rollback_finish(Rollback *rb);
+
+void rollback_free(Rollback *rb);
+
+// Plays a rollback session over a connected transport. seed must match on
+// both sides, level is as for rollback_open. Returns when either game is
+// over or ESC is pressed.
+void rollback_run(Transport *net, unsigned int seed, int level);
+
+// Waits for an opponent on port, then plays.
+int rollback_host(char *port);
+
+// Connects to a host, then plays.
+int rollback_join(Config config);
+
+#endif
@@ -0,0 +1,641 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scores.h"
+#include "timer.h"
+#include "fsutil.h"
+
+#define NODE_MAX_BYTES (sizeof(ScoreNode) + SCORES_SKIP_HEIGHT * sizeof(ScoreNode *) + ARENA_ALIGN)
+
+static const char *keyNames[SCORES_KEYS] = {"score", "level", "date", "player"};
+static const char *modeNames[] = {"solo", "2p", "sim", "local"};
+
+static uint32_t fnv(const unsigned char *p, size_t n, uint32_t h) {
+    for(size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t checksum(const ScoreRecord *r) {
+    return fnv((const unsigned char *)r + sizeof(r->check), sizeof(*r) - sizeof(r->check), 2166136261u);
+}
+
+static uint32_t nameHash(const char *name) {
+    return fnv((const unsigned char *)name, strnlen(name, SCORES_NAME_LEN), 2166136261u);
+}
+
+static uint64_t keyOf(const ScoreRecord *r, ScoreKey by) {
+    switch(by) {
+        case SCORES_BY_SCORE:
+            return r->score;
+        case SCORES_BY_LEVEL:
+            return (uint64_t)r->level << 32 | r->score;
+        case SCORES_BY_DATE:
+            return (uint64_t)r->date;
+        default:
+            return (uint64_t)nameHash(r->player) << 32 | r->score;
+    }
+}
+
+// Best first: the higher key, on a tie the record that got there first.
+static bool before(uint64_t key, uint32_t rec, uint64_t otherKey, uint32_t otherRec) {
+    return key > otherKey || (key == otherKey && rec < otherRec);
+}
+
+static int readRecord(ScoreStore *s, uint32_t rec, ScoreRecord *r) {
+    if(fseeko(s->read, (off_t)rec * sizeof(ScoreRecord), SEEK_SET) != 0
+       || fread(r, sizeof(ScoreRecord), 1, s->read) != 1) {
+        return 1;
+    }
+    return r->check != checksum(r);
+}
+
+static void clearLists(ScoreStore *s) {
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        memset(s->heads[k]->next, 0, SCORES_SKIP_HEIGHT * sizeof(ScoreNode *));
+    }
+    arena_reset(&s->nodes);
+}
+
+static int randomHeight(ScoreStore *s) {
+    int h = 1;
+    while(h < SCORES_SKIP_HEIGHT) {
+        s->rng = (s->rng * 1103515245u) + 12345u;
+        if(((s->rng >> 16) & 3) != 0) {
+            break;
+        }
+        h++;
+    }
+    return h;
+}
+
+// Caller holds lock and has made sure the arena has room.
+static void listInsert(ScoreStore *s, ScoreKey by, uint64_t key, uint32_t rec) {
+    int h = randomHeight(s);
+    ScoreNode *n = arena_alloc(&s->nodes, sizeof(ScoreNode) + h * sizeof(ScoreNode *));
+    n->key = key;
+    n->rec = rec;
+    n->height = h;
+    ScoreNode *at = s->heads[by];
+    for(int l = SCORES_SKIP_HEIGHT - 1; l >= 0; l--) {
+        while(at->next[l] != NULL && before(at->next[l]->key, at->next[l]->rec, key, rec)) {
+            at = at->next[l];
+        }
+        if(l < h) {
+            n->next[l] = at->next[l];
+            at->next[l] = n;
+        }
+    }
+}
+
+// Merges the skiplists into the sorted arrays. Only the writer (or open,
+// before the writer runs) changes the index, so it can read it unlocked and
+// only needs the lock to swap the new arrays in.
+static int fold(ScoreStore *s) {
+    uint32_t total = s->count;
+    if(total == s->indexed) {
+        return 0;
+    }
+    uint64_t *keys[SCORES_KEYS] = {NULL};
+    uint32_t *recs[SCORES_KEYS] = {NULL};
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        keys[k] = malloc(total * sizeof(uint64_t));
+        recs[k] = malloc(total * sizeof(uint32_t));
+        if(keys[k] == NULL || recs[k] == NULL) {
+            for(int j = 0; j <= k; j++) {
+                free(keys[j]);
+                free(recs[j]);
+            }
+            return 1;
+        }
+        uint32_t i = 0;
+        uint32_t out = 0;
+        const ScoreNode *n = s->heads[k]->next[0];
+        while(i < s->indexed || n != NULL) {
+            if(n == NULL || (i < s->indexed && before(s->keys[k][i], s->recs[k][i], n->key, n->rec))) {
+                keys[k][out] = s->keys[k][i];
+                recs[k][out++] = s->recs[k][i++];
+            } else {
+                keys[k][out] = n->key;
+                recs[k][out++] = n->rec;
+                n = n->next[0];
+            }
+        }
+    }
+    pthread_mutex_lock(&s->lock);
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        uint64_t *oldKeys = s->keys[k];
+        uint32_t *oldRecs = s->recs[k];
+        s->keys[k] = keys[k];
+        s->recs[k] = recs[k];
+        keys[k] = oldKeys;
+        recs[k] = oldRecs;
+    }
+    s->indexed = total;
+    clearLists(s);
+    pthread_mutex_unlock(&s->lock);
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        free(keys[k]);
+        free(recs[k]);
+    }
+    return 0;
+}
+
+// Writes the sorted arrays next to the index and renames them over it, so a
+// crash leaves either the old index or the new one. Writer only.
+static int saveIndex(ScoreStore *s) {
+    ScoreIndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SCORES_INDEX_MAGIC, sizeof(SCORES_INDEX_MAGIC));
+    h.version = SCORES_INDEX_VERSION;
+    h.count = s->indexed;
+    if(h.count > 0) {
+        ScoreRecord last;
+        pthread_mutex_lock(&s->lock);
+        int err = readRecord(s, h.count - 1, &last);
+        pthread_mutex_unlock(&s->lock);
+        if(err) {
+            return 1;
+        }
+        h.lastCheck = last.check;
+    }
+    char tmp[sizeof(s->indexPath) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", s->indexPath);
+    FILE *fp = fopen(tmp, "wb");
+    if(!fp) {
+        return 1;
+    }
+    int err = fwrite(&h, sizeof(h), 1, fp) != 1;
+    for(int k = 0; k < SCORES_KEYS && !err; k++) {
+        err = fwrite(s->keys[k], sizeof(uint64_t), h.count, fp) != h.count
+              || fwrite(s->recs[k], sizeof(uint32_t), h.count, fp) != h.count;
+    }
+    if(fclose(fp) != 0 || err) {
+        remove(tmp);
+        return 1;
+    }
+    if(fs_replace(tmp, s->indexPath) != 0) {
+        return 1;
+    }
+    s->saved = h.count;
+    return 0;
+}
+
+// Loads the index if it is sound and covers no more than the first records
+// of the log, otherwise leaves it empty to be rebuilt.
+static void loadIndex(ScoreStore *s, FILE *log, uint32_t records) {
+    FILE *fp = fopen(s->indexPath, "rb");
+    if(!fp) {
+        s->rebuilt = records > 0;
+        return;
+    }
+    ScoreIndexHeader h;
+    ScoreRecord last;
+    bool ok = fread(&h, sizeof(h), 1, fp) == 1
+              && memcmp(h.magic, SCORES_INDEX_MAGIC, sizeof(SCORES_INDEX_MAGIC)) == 0
+              && h.version == SCORES_INDEX_VERSION && h.count <= records;
+    if(ok && h.count > 0) {
+        ok = fseeko(log, (off_t)(h.count - 1) * sizeof(ScoreRecord), SEEK_SET) == 0
+             && fread(&last, sizeof(last), 1, log) == 1 && last.check == h.lastCheck;
+    }
+    for(int k = 0; k < SCORES_KEYS && ok; k++) {
+        s->keys[k] = malloc((h.count + 1) * sizeof(uint64_t));
+        s->recs[k] = malloc((h.count + 1) * sizeof(uint32_t));
+        ok = s->keys[k] != NULL && s->recs[k] != NULL
+             && fread(s->keys[k], sizeof(uint64_t), h.count, fp) == h.count
+             && fread(s->recs[k], sizeof(uint32_t), h.count, fp) == h.count;
+    }
+    fclose(fp);
+    if(ok) {
+        s->indexed = h.count;
+        s->saved = h.count;
+    } else {
+        for(int k = 0; k < SCORES_KEYS; k++) {
+            free(s->keys[k]);
+            free(s->recs[k]);
+            s->keys[k] = NULL;
+            s->recs[k] = NULL;
+        }
+        s->rebuilt = records > 0;
+    }
+}
+
+// Adds record number count to the skiplists, merging first when they are
+// full. Writer only.
+static int indexRecord(ScoreStore *s, const ScoreRecord *r) {
+    if(s->count - s->indexed >= SCORES_MERGE_AT
+       || s->nodes.size - s->nodes.used < SCORES_KEYS * NODE_MAX_BYTES) {
+        if(fold(s)) {
+            return 1;
+        }
+        if(s->indexed - s->saved >= SCORES_SAVE_AT) {
+            saveIndex(s);
+        }
+    }
+    pthread_mutex_lock(&s->lock);
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        listInsert(s, k, keyOf(r, k), s->count);
+    }
+    s->count++;
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+static void *writer(void *arg) {
+    ScoreStore *s = (ScoreStore *)arg;
+    ScoreRecord *batch = malloc(SCORES_QUEUE * sizeof(ScoreRecord));
+    pthread_mutex_lock(&s->queueLock);
+    while(batch != NULL) {
+        while(s->queued == 0 && !s->stop) {
+            pthread_cond_wait(&s->wake, &s->queueLock);
+        }
+        if(s->queued == 0) {
+            break;
+        }
+        int n = s->queued;
+        for(int i = 0; i < n; i++) {
+            batch[i] = s->queue[(s->queueHead + i) % SCORES_QUEUE];
+        }
+        s->queueHead = (s->queueHead + n) % SCORES_QUEUE;
+        s->queued = 0;
+        s->busy = true;
+        pthread_cond_broadcast(&s->room);
+        pthread_mutex_unlock(&s->queueLock);
+
+        // records only go in the index once they are in the log
+        size_t written = fwrite(batch, sizeof(ScoreRecord), n, s->log);
+        if(fflush(s->log) != 0) {
+            written = 0;
+        }
+        for(size_t i = 0; i < written && !s->failed; i++) {
+            // without the record numbers lining up the index is no use, the
+            // next open rebuilds it
+            s->failed = indexRecord(s, &batch[i]) != 0;
+        }
+
+        pthread_mutex_lock(&s->queueLock);
+        s->busy = false;
+        pthread_cond_broadcast(&s->room);
+    }
+    pthread_mutex_unlock(&s->queueLock);
+    free(batch);
+    if(!s->failed && fold(s) == 0 && s->indexed != s->saved) {
+        saveIndex(s);
+    }
+    return NULL;
+}
+
+int scores_open(ScoreStore *s, const char *logPath, const char *indexPath) {
+    memset(s, 0, sizeof(*s));
+    snprintf(s->logPath, sizeof(s->logPath), "%s", logPath != NULL ? logPath : SCORES_LOG_FILE);
+    snprintf(s->indexPath, sizeof(s->indexPath), "%s", indexPath != NULL ? indexPath : SCORES_INDEX_FILE);
+    s->rng = 1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_mutex_init(&s->queueLock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    pthread_cond_init(&s->room, NULL);
+    if(arena_init(&s->nodes, (size_t)SCORES_MERGE_AT * SCORES_KEYS * 64)) {
+        return 1;
+    }
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        s->heads[k] = calloc(1, sizeof(ScoreNode) + SCORES_SKIP_HEIGHT * sizeof(ScoreNode *));
+        if(s->heads[k] == NULL) {
+            scores_close(s);
+            return 1;
+        }
+        s->heads[k]->height = SCORES_SKIP_HEIGHT;
+    }
+
+    FILE *fp = fopen(s->logPath, "r+b");
+    if(!fp) {
+        fp = fopen(s->logPath, "w+b");
+    }
+    s->read = fopen(s->logPath, "rb");
+    if(!fp || !s->read) {
+        if(fp) {
+            fclose(fp);
+        }
+        scores_close(s);
+        return 1;
+    }
+    fseeko(fp, 0, SEEK_END);
+    off_t size = ftello(fp);
+    uint32_t records = (uint32_t)(size / (off_t)sizeof(ScoreRecord));
+    loadIndex(s, fp, records);
+
+    // everything past the index is checked again, the first record that
+    // doesn't add up is where the last run stopped writing
+    s->count = s->indexed;
+    fseeko(fp, (off_t)s->indexed * sizeof(ScoreRecord), SEEK_SET);
+    ScoreRecord r;
+    while(s->count < records && fread(&r, sizeof(r), 1, fp) == 1 && r.check == checksum(&r)) {
+        if(indexRecord(s, &r)) {
+            fclose(fp);
+            scores_close(s);
+            return 1;
+        }
+    }
+    off_t good = (off_t)s->count * sizeof(ScoreRecord);
+    if(good != size) {
+        fflush(fp);
+        if(ftruncate(fileno(fp), good) == 0) {
+            s->truncated = size - good;
+        }
+    }
+    fclose(fp);
+    if(s->rebuilt || s->indexed - s->saved >= SCORES_SAVE_AT) {
+        fold(s);
+        saveIndex(s);
+    }
+
+    s->log = fopen(s->logPath, "ab");
+    if(!s->log) {
+        scores_close(s);
+        return 1;
+    }
+    if(pthread_create(&s->writer, NULL, writer, s) != 0) {
+        scores_close(s);
+        return 1;
+    }
+    s->running = true;
+    return 0;
+}
+
+void scores_close(ScoreStore *s) {
+    if(s->running) {
+        pthread_mutex_lock(&s->queueLock);
+        s->stop = true;
+        pthread_cond_signal(&s->wake);
+        pthread_mutex_unlock(&s->queueLock);
+        pthread_join(s->writer, NULL);
+        s->running = false;
+    }
+    if(s->log) {
+        fclose(s->log);
+        s->log = NULL;
+    }
+    if(s->read) {
+        fclose(s->read);
+        s->read = NULL;
+    }
+    for(int k = 0; k < SCORES_KEYS; k++) {
+        free(s->keys[k]);
+        free(s->recs[k]);
+        free(s->heads[k]);
+        s->keys[k] = NULL;
+        s->recs[k] = NULL;
+        s->heads[k] = NULL;
+    }
+    arena_free(&s->nodes);
+    pthread_mutex_destroy(&s->lock);
+    pthread_mutex_destroy(&s->queueLock);
+    pthread_cond_destroy(&s->wake);
+    pthread_cond_destroy(&s->room);
+}
+
+int scores_submit(ScoreStore *s, ScoreRecord *r, bool wait) {
+    if(r->date == 0) {
+        r->date = (int64_t)time(NULL);
+    }
+    r->check = checksum(r);
+    pthread_mutex_lock(&s->queueLock);
+    while(s->queued == SCORES_QUEUE) {
+        if(!wait) {
+            s->dropped++;
+            pthread_mutex_unlock(&s->queueLock);
+            return 1;
+        }
+        pthread_cond_wait(&s->room, &s->queueLock);
+    }
+    s->queue[(s->queueHead + s->queued) % SCORES_QUEUE] = *r;
+    s->queued++;
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->queueLock);
+    return 0;
+}
+
+void scores_sync(ScoreStore *s) {
+    pthread_mutex_lock(&s->queueLock);
+    while(s->queued > 0 || s->busy) {
+        pthread_cond_wait(&s->room, &s->queueLock);
+    }
+    pthread_mutex_unlock(&s->queueLock);
+}
+
+int scores_top(ScoreStore *s, ScoreKey by, const char *player, int k, ScoreRecord *out) {
+    if(k > SCORES_MAX_TOP) {
+        k = SCORES_MAX_TOP;
+    }
+    uint64_t start = UINT64_MAX;
+    uint32_t hash = 0;
+    if(by == SCORES_BY_PLAYER) {
+        hash = nameHash(player);
+        start = (uint64_t)hash << 32 | 0xffffffffu;
+    }
+    pthread_mutex_lock(&s->lock);
+    const uint64_t *keys = s->keys[by];
+    const uint32_t *recs = s->recs[by];
+    // first entry at or below start in the array, then in the skiplist
+    uint32_t lo = 0;
+    uint32_t hi = s->indexed;
+    while(lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(keys[mid] > start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const ScoreNode *n = s->heads[by];
+    for(int l = SCORES_SKIP_HEIGHT - 1; l >= 0; l--) {
+        while(n->next[l] != NULL && n->next[l]->key > start) {
+            n = n->next[l];
+        }
+    }
+    n = n->next[0];
+
+    int found = 0;
+    uint32_t i = lo;
+    while(found < k && (i < s->indexed || n != NULL)) {
+        uint64_t key;
+        uint32_t rec;
+        if(n == NULL || (i < s->indexed && before(keys[i], recs[i], n->key, n->rec))) {
+            key = keys[i];
+            rec = recs[i++];
+        } else {
+            key = n->key;
+            rec = n->rec;
+            n = n->next[0];
+        }
+        if(by == SCORES_BY_PLAYER && (uint32_t)(key >> 32) != hash) {
+            break;
+        }
+        if(readRecord(s, rec, &out[found]) != 0) {
+            continue;
+        }
+        // names can share a hash
+        if(by == SCORES_BY_PLAYER && strncmp(out[found].player, player, SCORES_NAME_LEN) != 0) {
+            continue;
+        }
+        found++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return found;
+}
+
+static void printRecords(const ScoreRecord *r, int n) {
+    printf("%4s %10s %5s %7s  %-16s %-5s %s\n", "rank", "score", "level", "pieces", "date", "mode", "player");
+    for(int i = 0; i < n; i++) {
+        char date[32];
+        time_t t = (time_t)r[i].date;
+        struct tm *tm = localtime(&t);
+        if(tm == NULL || strftime(date, sizeof(date), "%Y-%m-%d %H:%M", tm) == 0) {
+            snprintf(date, sizeof(date), "%lld", (long long)r[i].date);
+        }
+        printf("%4d %10u %5u %7u  %-16s %-5s %.*s\n", i + 1, r[i].score, r[i].level, r[i].pieces, date,
+               r[i].mode < SCORES_MODES ? modeNames[r[i].mode] : "?", SCORES_NAME_LEN, r[i].player);
+    }
+}
+
+static int scoresTop(int argc, char *argv[]) {
+    ScoreKey by = SCORES_BY_SCORE;
+    const char *player = NULL;
+    int arg = 0;
+    if(argc > arg && !isdigit((unsigned char)argv[arg][0])) {
+        for(by = 0; by < SCORES_KEYS && strcmp(argv[arg], keyNames[by]) != 0; by++) {
+        }
+        if(by == SCORES_KEYS) {
+            fprintf(stderr, "unknown key %s\n", argv[arg]);
+            return 1;
+        }
+        arg++;
+        if(by == SCORES_BY_PLAYER) {
+            if(argc <= arg) {
+                fprintf(stderr, "usage: scores top player name [k]\n");
+                return 1;
+            }
+            player = argv[arg++];
+        }
+    }
+    int k = argc > arg ? atoi(argv[arg]) : 10;
+    if(k <= 0 || k > SCORES_MAX_TOP) {
+        k = 10;
+    }
+    ScoreStore s;
+    if(scores_open(&s, NULL, NULL)) {
+        fprintf(stderr, "unable to open %s\n", SCORES_LOG_FILE);
+        return 1;
+    }
+    ScoreRecord top[SCORES_MAX_TOP];
+    int n = scores_top(&s, by, player, k, top);
+    printf("%u games\n", s.count);
+    printRecords(top, n);
+    scores_close(&s);
+    return 0;
+}
+
+static double openTimed(ScoreStore *s, const char *log, const char *idx) {
+    uint64_t start = timer_now_ns();
+    if(scores_open(s, log, idx)) {
+        return -1;
+    }
+    return (timer_now_ns() - start) / 1e9;
+}
+
+static int scoresBench(uint32_t records, int queries) {
+    const char *log = "data/scores_bench.log";
+    const char *idx = "data/scores_bench.idx";
+    remove(log);
+    remove(idx);
+    ScoreStore s;
+    if(openTimed(&s, log, idx) < 0) {
+        fprintf(stderr, "unable to open %s\n", log);
+        return 1;
+    }
+
+    unsigned int rng = 1;
+    uint64_t start = timer_now_ns();
+    for(uint32_t i = 0; i < records; i++) {
+        ScoreRecord r;
+        memset(&r, 0, sizeof(r));
+        rng = rng * 1103515245u + 12345u;
+        r.score = (rng >> 8) % 1000000;
+        r.level = 1 + r.score / 10000;
+        r.pieces = r.score / 40;
+        r.mode = SCORES_SIM;
+        r.date = 1600000000 + i;
+        snprintf(r.player, sizeof(r.player), "bot%03u", (rng >> 4) % 1000);
+        scores_submit(&s, &r, true);
+    }
+    scores_sync(&s);
+    double secs = (timer_now_ns() - start) / 1e9;
+    printf("inserted %u records in %.3fs, %.0f/s\n", records, secs, secs > 0 ? records / secs : 0.0);
+
+    ScoreRecord top[10];
+    for(int by = 0; by < SCORES_KEYS; by++) {
+        start = timer_now_ns();
+        int n = 0;
+        for(int q = 0; q < queries; q++) {
+            char player[SCORES_NAME_LEN];
+            snprintf(player, sizeof(player), "bot%03d", q % 1000);
+            n += scores_top(&s, by, player, 10, top);
+        }
+        double us = (timer_now_ns() - start) / 1e3 / (queries > 0 ? queries : 1);
+        printf("top 10 by %-6s %8.1fus per query, %d records\n", keyNames[by], us, n);
+    }
+
+    start = timer_now_ns();
+    scores_close(&s);
+    printf("close %.3fs\n", (timer_now_ns() - start) / 1e9);
+    printf("open with index %.3fs\n", openTimed(&s, log, idx));
+    scores_close(&s);
+
+    // a record cut short, as if the game died halfway through writing it
+    FILE *fp = fopen(log, "ab");
+    if(fp) {
+        fwrite("torn", 1, 4, fp);
+        fclose(fp);
+    }
+    remove(idx);
+    double rebuild = openTimed(&s, log, idx);
+    printf("rebuild from log %.3fs, %u records, %llu bytes cut off\n", rebuild, s.count,
+           (unsigned long long)s.truncated);
+    scores_close(&s);
+    return 0;
+}
+
+int scores_main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: scores top [score|level|date|player name] [k]\n"
+                        "       scores bench [records] [queries]\n"
+                        "       scores rebuild\n");
+        return 1;
+    }
+    if(strcmp(argv[1], "top") == 0) {
+        return scoresTop(argc - 2, argv + 2);
+    }
+    if(strcmp(argv[1], "bench") == 0) {
+        uint32_t records = argc > 2 ? (uint32_t)atol(argv[2]) : 1000000;
+        int queries = argc > 3 ? atoi(argv[3]) : 1000;
+        return scoresBench(records, queries);
+    }
+    if(strcmp(argv[1], "rebuild") == 0) {
+        remove(SCORES_INDEX_FILE);
+        ScoreStore s;
+        if(scores_open(&s, NULL, NULL)) {
+            fprintf(stderr, "unable to open %s\n", SCORES_LOG_FILE);
+            return 1;
+        }
+        printf("%u records indexed, %llu bytes cut off the log\n", s.count, (unsigned long long)s.truncated);
+        scores_close(&s);
+        return 0;
+    }
+    fprintf(stderr, "unknown scores command %s\n", argv[1]);
+    return 1;
+}
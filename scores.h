@@ -0,0 +1,133 @@
+#ifndef SCORES_H_
+#define SCORES_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+
+// High scores of every finished game, kept in two files:
+//
+//   data/scores.log    ScoreRecords back to back, only ever appended to.
+//                      Record n is at n * sizeof(ScoreRecord).
+//   data/scores.idx    for each ScoreKey, the records sorted best first:
+//                      ScoreIndexHeader, then per key count uint64 keys and
+//                      count uint32 record numbers.
+//
+// The log is the only thing that has to survive. Each record carries a
+// checksum, so a write cut short by a crash is found and cut off on the next
+// open, and the index only covers records that were already in the log when
+// it was saved. Records appended since are put in a skiplist per key; once
+// enough have piled up they are merged into the sorted arrays, and the arrays
+// are written out every so often and on close. A missing or stale index is
+// rebuilt from the log. Native byte order.
+#define SCORES_LOG_FILE "data/scores.log"
+#define SCORES_INDEX_FILE "data/scores.idx"
+#define SCORES_INDEX_MAGIC "TETSCOR"
+#define SCORES_INDEX_VERSION 1
+#define SCORES_NAME_LEN 24
+#define SCORES_QUEUE 4096                // records waiting for the writer thread
+#define SCORES_MERGE_AT 16384            // skiplist entries per key before merging
+#define SCORES_SAVE_AT 262144            // records merged before the index is written again
+#define SCORES_SKIP_HEIGHT 16
+#define SCORES_MAX_TOP 1000
+
+typedef enum {
+    SCORES_SOLO,
+    SCORES_2P,
+    SCORES_SIM,
+    SCORES_LOCAL,
+    SCORES_MODES
+} ScoreMode;
+
+typedef enum {
+    SCORES_BY_SCORE,
+    SCORES_BY_LEVEL,                     // then by score
+    SCORES_BY_DATE,                      // newest first
+    SCORES_BY_PLAYER,                    // one player's games by score
+    SCORES_KEYS
+} ScoreKey;
+
+typedef struct ScoreRecord {
+    uint32_t check;                      // FNV-1a of the rest of the record
+    uint16_t mode;                       // ScoreMode
+    uint16_t level;
+    int64_t date;                        // seconds since 1970
+    uint32_t score;
+    uint32_t pieces;                     // 0 where the game doesn't count them
+    char player[SCORES_NAME_LEN];        // NUL padded
+} ScoreRecord;
+
+typedef struct ScoreIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;                      // records covered
+    uint32_t lastCheck;                  // check of record count-1, to spot a different log
+    uint32_t reserved;
+} ScoreIndexHeader;
+
+typedef struct ScoreNode {
+    uint64_t key;
+    uint32_t rec;
+    uint32_t height;
+    struct ScoreNode *next[];
+} ScoreNode;
+
+typedef struct ScoreStore {
+    pthread_mutex_t lock;                // index and record lookups
+    pthread_mutex_t queueLock;           // queue, kept apart so submits never wait on a query
+    pthread_cond_t wake;                 // work for the writer
+    pthread_cond_t room;                 // space in the queue, or the writer went idle
+    pthread_t writer;
+    bool running;
+    bool stop;
+    char logPath[256];
+    char indexPath[256];
+    FILE *log;                           // appended to by the writer only
+    FILE *read;                          // record lookups, under lock
+    uint32_t count;                      // records in the log
+    uint32_t indexed;                    // records in keys/recs
+    uint32_t saved;                      // records in the index file
+    uint64_t *keys[SCORES_KEYS];
+    uint32_t *recs[SCORES_KEYS];
+    ScoreNode *heads[SCORES_KEYS];       // skiplists of records indexed..count-1
+    Arena nodes;
+    unsigned int rng;
+    ScoreRecord queue[SCORES_QUEUE];
+    int queueHead;
+    int queued;
+    bool busy;                           // writer is between taking and indexing a batch
+    bool failed;                         // out of memory, records since are only in the log
+    uint64_t dropped;                    // submits that found the queue full
+    uint64_t truncated;                  // bytes cut off the log when it was opened
+    bool rebuilt;                        // the index had to be rebuilt from the log
+} ScoreStore;
+
+// Opens or creates the log and index at the given paths (NULL for the
+// defaults), repairs a torn log and starts the writer thread. Returns 1 on
+// error.
+int scores_open(ScoreStore *s, const char *logPath, const char *indexPath);
+
+// Waits for the queue to drain, saves the index and stops the writer.
+void scores_close(ScoreStore *s);
+
+// Fills in date and check and hands r to the writer thread. With wait false
+// this never blocks on I/O and returns 1 if the queue is full, with wait true
+// it waits for room instead.
+int scores_submit(ScoreStore *s, ScoreRecord *r, bool wait);
+
+// Waits until everything submitted so far is in the log and the index.
+void scores_sync(ScoreStore *s);
+
+// Copies up to k records into out, best first by the given key. player is
+// only used for SCORES_BY_PLAYER. Returns the number copied.
+int scores_top(ScoreStore *s, ScoreKey by, const char *player, int k, ScoreRecord *out);
+
+// Command line entry: scores top [score|level|date|player name] [k]
+//                     scores bench [records] [queries]
+//                     scores rebuild
+int scores_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include "sim.h"
+#include "perfctr.h"
+
+// Same generator on every platform, rand() differs between C libraries.
+static Color simRand(GameSim *g) {
+    g->rng = (g->rng * 1103515245u) + 12345u;
+    return ((g->rng >> 16) & 0x7fff) % 7;
+}
+
+static int gravityFrames(GameSim *g) {
+    int frames = g->delay / SIM_FRAME_MS;
+    return frames > 0 ? frames : 1;
+}
+
+static int lock(GameSim *g) {
+    for(int i = 0; i < 4; i++) {
+        if(g->t.current_xy[i].y <= 0) {
+            g->over = true;
+        }
+    }
+    if(g->over) {
+        return 0;
+    }
+    perf_phase_begin();
+    updateMatrix(g->t, g->matrix);
+    g->locked = g->t;
+    int lines = checkLine(g->matrix);
+    if(lines) {
+        addScore(lines, &g->score, &g->level, &g->speedcnt, &g->delay);
+    }
+    perf_phase_end(PERF_PHASE_LINE_CLEAR);
+    perf_phase_begin();
+    g->t = newBlock(simRand(g), &g->next, 0);
+    perf_phase_end(PERF_PHASE_SPAWN);
+    g->heldLast = false;
+    g->pieces++;
+    return lines;
+}
+
+static int leftmost(const tetrimo *t) {
+    int x = t->current_xy[0].x;
+    for(int i = 1; i < 4; i++) {
+        if(t->current_xy[i].x < x) {
+            x = t->current_xy[i].x;
+        }
+    }
+    return matrixtoblock(x);
+}
+
+void sim_init(GameSim *g, unsigned int seed, int level) {
+    bool wasHeadless = headless;
+    headless = true;
+    memset(g, 0, sizeof(*g));
+    g->rng = seed;
+    g->level = 1;
+    g->delay = INITIAL_DELAY;
+    while(g->level < level) {
+        addScore(10, &g->score, &g->level, &g->speedcnt, &g->delay);
+    }
+    g->score = 0;
+    g->speedcnt = 0;
+    initMatrix(g->matrix);
+    g->next = simRand(g);
+    g->t = newBlock(simRand(g), &g->next, 0);
+    headless = wasHeadless;
+}
+
+void sim_step(GameSim *g, uint8_t input) {
+    if(g->over) {
+        return;
+    }
+    bool wasHeadless = headless;
+    bool *wasTopOut = topOut;
+    bool stuck = false;
+    topOut = &stuck;
+    headless = true;
+
+    if((input & SIM_HOLD) && !g->heldLast) {
+        perf_phase_begin();
+        g->heldLast = true;
+        if(g->heldExists) {
+            g->next = g->held;
+        }
+        g->held = g->t.color;
+        g->heldExists = true;
+        g->t = newBlock(simRand(g), &g->next, 0);
+        perf_phase_end(PERF_PHASE_SPAWN);
+    }
+    if(input & SIM_ROTATE) {
+        perf_phase_begin();
+        g->t.toggle(&g->t, g->matrix);
+        perf_phase_end(PERF_PHASE_ROTATION);
+    }
+    bool fall = (input & SIM_DROP) != 0;
+    if(++g->gravity >= gravityFrames(g)) {
+        g->gravity = 0;
+        fall = true;
+    }
+    bool landed = false;
+    if((input & (SIM_LEFT | SIM_RIGHT)) || fall) {
+        perf_phase_begin();
+        if(input & SIM_LEFT) {
+            update(LEFT, &g->t, g->matrix);
+        }
+        if(input & SIM_RIGHT) {
+            update(RIGHT, &g->t, g->matrix);
+        }
+        landed = fall && !update(DOWN, &g->t, g->matrix);
+        perf_phase_end(PERF_PHASE_COLLISION);
+    }
+    if(landed) {
+        lock(g);
+    }
+
+    topOut = wasTopOut;
+    headless = wasHeadless;
+}
+
+int sim_place(GameSim *g, int rotations, int column) {
+    if(g->over) {
+        return -1;
+    }
+    bool wasHeadless = headless;
+    bool *wasTopOut = topOut;
+    bool stuck = false;
+    topOut = &stuck;
+    headless = true;
+
+    tetrimo t = g->t;
+    perf_phase_begin();
+    for(int i = 0; i < rotations; i++) {
+        t.toggle(&t, g->matrix);
+    }
+    perf_phase_end(PERF_PHASE_ROTATION);
+    perf_phase_begin();
+    int x = leftmost(&t);
+    while(x != column) {
+        update(x < column ? RIGHT : LEFT, &t, g->matrix);
+        int moved = leftmost(&t);
+        if(moved == x) {
+            break;
+        }
+        x = moved;
+    }
+    int lines = -1;
+    if(x == column) {
+        while(update(DOWN, &t, g->matrix)) {}
+    }
+    perf_phase_end(PERF_PHASE_COLLISION);
+    if(x == column) {
+        g->t = t;
+        g->gravity = 0;
+        lines = lock(g);
+    }
+
+    topOut = wasTopOut;
+    headless = wasHeadless;
+    return lines;
+}
+
+uint8_t sim_input_for_key(int key) {
+    switch(key) {
+        case KEY_LEFT:
+            return SIM_LEFT;
+        case KEY_RIGHT:
+            return SIM_RIGHT;
+        case '\t':
+            return SIM_ROTATE;
+        case KEY_DOWN:
+            return SIM_DROP;
+        case ' ':
+            return SIM_HOLD;
+        default:
+            return 0;
+    }
+}
+
+void sim_draw(GameSim *g, int offset) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(g->matrix[i][j]) {
+                paint(i, blocktomatrix(j)+offset);
+            } else {
+                whiteout(i, blocktomatrix(j)+offset);
+            }
+        }
+    }
+    for(int i = 0; i < 4; i++) {
+        if(g->t.current_xy[i].y >= 0) {
+            paint(g->t.current_xy[i].y, g->t.current_xy[i].x+offset);
+        }
+    }
+    drawScoreLevel(g->score, g->level, offset);
+}
@@ -0,0 +1,57 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+
+#include "tetris.h"
+
+// The simulation advances in fixed frames so two machines given the same
+// seed and inputs end up in the same state.
+#define SIM_FRAME_MS 16
+#define SIM_FRAME_NS (SIM_FRAME_MS * 1000000ULL)
+
+// Input bits for one frame.
+#define SIM_LEFT 0x01
+#define SIM_RIGHT 0x02
+#define SIM_ROTATE 0x04
+#define SIM_DROP 0x08
+#define SIM_HOLD 0x10
+
+// Everything one player's game needs, with its own random generator so the
+// piece sequence only depends on the seed.
+typedef struct GameSim {
+    tetrimo t;
+    Color next;
+    Color held;
+    bool heldExists;
+    bool heldLast;
+    bool over;
+    int score;
+    int level;
+    int speedcnt;
+    int delay;
+    int gravity;
+    unsigned int rng;
+    uint32_t pieces;        // locked so far
+    tetrimo locked;         // last piece locked, as it landed
+    bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH];
+} GameSim;
+
+void sim_init(GameSim *g, unsigned int seed, int level);
+
+// Advances one frame: hold, rotate, shift, then gravity or a drop.
+void sim_step(GameSim *g, uint8_t input);
+
+// Places the falling piece in one go: turned rotations times, shifted until
+// its leftmost block is in column, then dropped and locked. For bots and
+// tools that work in whole pieces rather than frames. Returns the lines
+// cleared, or -1 and leaves g alone if the piece can't get to column.
+int sim_place(GameSim *g, int rotations, int column);
+
+// Maps a key from wgetch to input bits, 0 if the key is not a game input.
+uint8_t sim_input_for_key(int key);
+
+// Draws the settled blocks, the falling piece and score/level at offset.
+void sim_draw(GameSim *g, int offset);
+
+#endif
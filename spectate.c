@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include "spectate.h"
+#include "tetris.h"
+#include "timer.h"
+#include "render.h"
+
+static void release(SpectateBuffer *b) {
+    if(b != NULL && atomic_fetch_sub(&b->refs, 1) == 1) {
+        free(b);
+    }
+}
+
+static SpectateBuffer *retain(SpectateBuffer *b) {
+    atomic_fetch_add(&b->refs, 1);
+    return b;
+}
+
+static void setNonBlocking(SOCKET s) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(s, FIONBIO, &mode);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// Sends what is left of b from offset straight out of the shared buffer, the
+// two boards and the newline go out in one gather call.
+static int sendFrom(SOCKET s, SpectateBuffer *b, int offset) {
+    static char newline[] = "\n";
+    char *parts[3] = {b->host, b->guest, newline};
+    int lens[3] = {FRAME_LEN - 1, FRAME_LEN - 1, 1};
+    int n = 0;
+#ifdef _WIN32
+    WSABUF bufs[3];
+#else
+    struct iovec bufs[3];
+#endif
+    for(int i = 0; i < 3; i++) {
+        if(offset >= lens[i]) {
+            offset -= lens[i];
+            continue;
+        }
+#ifdef _WIN32
+        bufs[n].buf = parts[i] + offset;
+        bufs[n].len = lens[i] - offset;
+#else
+        bufs[n].iov_base = parts[i] + offset;
+        bufs[n].iov_len = lens[i] - offset;
+#endif
+        n++;
+        offset = 0;
+    }
+#ifdef _WIN32
+    DWORD sent;
+    if(WSASend(s, bufs, n, &sent, 0, NULL, NULL) == SOCKET_ERROR) {
+        return -1;
+    }
+    return (int)sent;
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = bufs;
+    msg.msg_iovlen = n;
+    return (int)sendmsg(s, &msg, MSG_NOSIGNAL);
+#endif
+}
+
+// Frames up to seq the viewer never finished count as dropped.
+static void removeViewer(SpectateHub *hub, int i, uint32_t seq) {
+    Viewer *v = &hub->viewers[i];
+    if(v->lastSeq != 0 && seq > v->lastSeq) {
+        hub->framesDropped += seq - v->lastSeq;
+    }
+    closesocket(v->sock);
+    release(v->frame);
+    hub->viewers[i] = hub->viewers[--hub->count];
+    hub->disconnected++;
+}
+
+static void acceptViewers(SpectateHub *hub) {
+    SOCKET s;
+    while((s = accept(hub->listen, NULL, NULL)) != INVALID_SOCKET) {
+        if(hub->count == SPECTATE_MAX) {
+            closesocket(s);
+            hub->rejected++;
+            continue;
+        }
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(one));
+        setNonBlocking(s);
+        Viewer *v = &hub->viewers[hub->count++];
+        memset(v, 0, sizeof(*v));
+        v->sock = s;
+        hub->accepted++;
+        if(hub->count > hub->peak) {
+            hub->peak = hub->count;
+        }
+    }
+}
+
+// Returns false if the viewer should be dropped.
+static bool sendViewer(SpectateHub *hub, Viewer *v, SpectateBuffer *latest, uint64_t now) {
+    if(v->frame == NULL) {
+        if(latest == NULL || latest->seq == v->lastSeq) {
+            return true;
+        }
+        if(v->lastSeq != 0) {
+            hub->framesDropped += latest->seq - v->lastSeq - 1;
+        }
+        v->frame = retain(latest);
+        v->sent = 0;
+        v->since = now;
+    }
+    int n = sendFrom(v->sock, v->frame, v->sent);
+    if(n < 0) {
+        return wouldBlock() && now - v->since < SPECTATE_STALL_NS;
+    }
+    v->sent += n;
+    hub->bytesSent += n;
+    if(v->sent == SPECTATE_FRAME_LEN) {
+        v->lastSeq = v->frame->seq;
+        release(v->frame);
+        v->frame = NULL;
+        hub->framesSent++;
+    }
+    return true;
+}
+
+static void *broadcast(void *arg) {
+    SpectateHub *hub = (SpectateHub *)arg;
+    bool stopping = false;
+    while(!stopping) {
+        pthread_mutex_lock(&hub->lock);
+        if(!hub->stop) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += SPECTATE_WAIT_MS * 1000000L;
+            if(until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&hub->wake, &hub->lock, &until);
+        }
+        // one more pass after stop so viewers get the final frame
+        stopping = hub->stop;
+        SpectateBuffer *latest = hub->latest != NULL ? retain(hub->latest) : NULL;
+        pthread_mutex_unlock(&hub->lock);
+
+        acceptViewers(hub);
+        uint64_t now = timer_now_ns();
+        for(int i = 0; i < hub->count; ) {
+            if(sendViewer(hub, &hub->viewers[i], latest, now)) {
+                i++;
+            } else {
+                removeViewer(hub, i, latest->seq);
+            }
+        }
+        release(latest);
+    }
+    return NULL;
+}
+
+SpectateHub *spectate_start(char *port) {
+    char p[12];
+    snprintf(p, sizeof(p), "%d", atoi(port) + SPECTATE_PORT_OFFSET);
+    SpectateHub *hub = calloc(1, sizeof(SpectateHub));
+    if(hub == NULL) {
+        return NULL;
+    }
+    if(tcp_server_create(&hub->listen, p)) {
+        free(hub);
+        return NULL;
+    }
+    setNonBlocking(hub->listen);
+    pthread_mutex_init(&hub->lock, NULL);
+    pthread_cond_init(&hub->wake, NULL);
+    pthread_create(&hub->thread, NULL, broadcast, hub);
+    return hub;
+}
+
+void spectate_publish(SpectateHub *hub, const char *host, const char *guest) {
+    SpectateBuffer *b = malloc(sizeof(SpectateBuffer));
+    if(b == NULL) {
+        return;
+    }
+    atomic_init(&b->refs, 1);
+    memcpy(b->host, host, FRAME_LEN - 1);
+    memcpy(b->guest, guest, FRAME_LEN - 1);
+    pthread_mutex_lock(&hub->lock);
+    b->seq = ++hub->seq;
+    SpectateBuffer *old = hub->latest;
+    hub->latest = b;
+    hub->published++;
+    pthread_cond_signal(&hub->wake);
+    pthread_mutex_unlock(&hub->lock);
+    release(old);
+}
+
+static int dumpStats(SpectateHub *hub) {
+    FILE *fp = fopen(SPECTATE_STATS_FILE, "w+");
+    if(!fp) {
+        return 1;
+    }
+    fprintf(fp, "frames_published %llu\n", (unsigned long long)hub->published);
+    fprintf(fp, "frames_sent %llu\n", (unsigned long long)hub->framesSent);
+    fprintf(fp, "frames_dropped %llu\n", (unsigned long long)hub->framesDropped);
+    fprintf(fp, "bytes_sent %llu\n", (unsigned long long)hub->bytesSent);
+    fprintf(fp, "viewers_accepted %llu\n", (unsigned long long)hub->accepted);
+    fprintf(fp, "viewers_rejected %llu\n", (unsigned long long)hub->rejected);
+    fprintf(fp, "viewers_dropped %llu\n", (unsigned long long)hub->disconnected);
+    fprintf(fp, "viewers_peak %d\n", hub->peak);
+    fclose(fp);
+    return 0;
+}
+
+void spectate_stop(SpectateHub *hub) {
+    if(hub == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&hub->lock);
+    hub->stop = true;
+    pthread_cond_signal(&hub->wake);
+    pthread_mutex_unlock(&hub->lock);
+    pthread_join(hub->thread, NULL);
+    // viewers still connected at the end left normally
+    uint64_t dropped = hub->disconnected;
+    while(hub->count > 0) {
+        removeViewer(hub, hub->count - 1, hub->seq);
+    }
+    hub->disconnected = dropped;
+    dumpStats(hub);
+    release(hub->latest);
+    closesocket(hub->listen);
+    pthread_mutex_destroy(&hub->lock);
+    pthread_cond_destroy(&hub->wake);
+    free(hub);
+}
+
+static int decodeNumber(const char *s, int len) {
+    int v = 0;
+    for(int i = 0; i < len; i++) {
+        if(s[i] >= '0' && s[i] <= '9') {
+            v = v * 10 + s[i] - '0';
+        }
+    }
+    return v;
+}
+
+static void drawPlayer(const char *f, int offset) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            if(f[FRAME_BOARD + (i*9)+j] == '1') {
+                paint(i, blocktomatrix(j)+offset);
+            } else if(f[FRAME_BOARD + (i*9)+j] == '0') {
+                whiteout(i, blocktomatrix(j)+offset);
+            }
+        }
+    }
+    drawScoreLevel(decodeNumber(f + FRAME_SCORE, 5), decodeNumber(f + FRAME_LEVEL, 2), offset);
+}
+
+int spectate_watch(Config config) {
+    char p[12];
+    snprintf(p, sizeof(p), "%d", atoi(config.port) + SPECTATE_PORT_OFFSET);
+    config.port = p;
+    SOCKET c;
+    render_printf(13, 26, "CONNECTING");
+    render_flush();
+    if(tcp_client_connect(config, &c)) {
+        return 1;
+    }
+    render_clear();
+    drawBoard(0, 0, 0);
+    drawBoard(0, 0, 55);
+    timeout(0);
+
+    char frame[SPECTATE_FRAME_LEN];
+    int len = 0;
+    bool over = false;
+    while(!over) {
+        fd_set readable;
+        struct timeval tv = {0, SPECTATE_WAIT_MS * 1000};
+        FD_ZERO(&readable);
+        FD_SET(c, &readable);
+        if(select(c + 1, &readable, NULL, NULL, &tv) > 0) {
+            int n = recv(c, frame + len, SPECTATE_FRAME_LEN - len, 0);
+            if(n <= 0) {
+                break;
+            }
+            len += n;
+        }
+        if(len == SPECTATE_FRAME_LEN) {
+            drawPlayer(frame, 0);
+            drawPlayer(frame + FRAME_LEN - 1, 55);
+            render_flush();
+            over = frame[FRAME_OVER] == '1' || frame[FRAME_LEN - 1 + FRAME_OVER] == '1';
+            len = 0;
+        }
+        int key;
+        while((key = wgetch(stdscr)) != ERR) {
+            if(key == ESC_KEY) {
+                over = true;
+            }
+        }
+    }
+    timeout(delay);
+    closesocket(c);
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef SPECTATE_H_
+#define SPECTATE_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tcp_client.h"
+#include "tcp_server.h"
+
+// Spectators connect to the host's game port + 1 and receive both players'
+// frames back to back followed by a newline.
+#define SPECTATE_PORT_OFFSET 1
+#define SPECTATE_MAX 256
+#define SPECTATE_FRAME_LEN (2 * (FRAME_LEN - 1) + 1)
+#define SPECTATE_WAIT_MS 20
+#define SPECTATE_STALL_NS 5000000000ULL  // a viewer stuck mid frame this long is dropped
+#define SPECTATE_STATS_FILE "data/spectate_stats.txt"
+
+// One update, encoded once and shared by every viewer still sending it. The
+// last reference frees it.
+typedef struct SpectateBuffer {
+    atomic_int refs;
+    uint32_t seq;
+    char host[FRAME_LEN - 1];
+    char guest[FRAME_LEN - 1];
+} SpectateBuffer;
+
+typedef struct Viewer {
+    SOCKET sock;
+    SpectateBuffer *frame;   // being sent, NULL when idle
+    int sent;                // bytes of frame already written
+    uint32_t lastSeq;        // last frame fully sent
+    uint64_t since;          // when frame was picked up
+} Viewer;
+
+// Viewers are only touched by the broadcast thread, so the players never wait
+// on a slow socket. A viewer that can't keep up finishes the frame it started
+// and then skips straight to the newest one.
+typedef struct SpectateHub {
+    SOCKET listen;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    SpectateBuffer *latest;
+    uint32_t seq;
+    bool stop;
+    Viewer viewers[SPECTATE_MAX];
+    int count;
+    uint64_t published;
+    uint64_t framesSent;
+    uint64_t framesDropped;
+    uint64_t bytesSent;
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t disconnected;
+    int peak;
+} SpectateHub;
+
+// Listens for viewers on port + SPECTATE_PORT_OFFSET, NULL if that fails.
+SpectateHub *spectate_start(char *port);
+
+// Makes host and guest (both FRAME_LEN - 1 bytes) the newest frame.
+void spectate_publish(SpectateHub *hub, const char *host, const char *guest);
+
+// Disconnects every viewer, writes SPECTATE_STATS_FILE and frees the hub.
+void spectate_stop(SpectateHub *hub);
+
+// Watches a match on config.host, config.port is the game port. Returns when
+// the match ends or ESC is pressed.
+int spectate_watch(Config config);
+
+#endif
@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "state.h"
+
+static void (*const toggles[7])(struct tetrimo*, bool[MATRIX_LENGTH-1][MATRIX_WIDTH]) = {
+    toggleRed,
+    toggleGreen,
+    toggleCyan,
+    toggleBlue,
+    toggleYellow,
+    togglePurple,
+    toggleOrange,
+};
+
+static void packMatrix(PackedState *p, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        uint16_t row = 0;
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            row |= (uint16_t)matrix[i][j] << j;
+        }
+        p->rows[i] = row;
+    }
+}
+
+static void packPiece(PackedState *p, const tetrimo *t, bool over) {
+    for(int i = 0; i < 4; i++) {
+        p->cells[i][0] = (int8_t)matrixtoblock(t->current_xy[i].x);
+        p->cells[i][1] = (int8_t)t->current_xy[i].y;
+    }
+    p->piece = (uint8_t)(t->color | (t->current_orientation << 3) | (over << 7));
+}
+
+static uint8_t packPreview(Color next, Color held, bool heldExists, bool heldLast) {
+    return (uint8_t)((next & 7) | ((held & 7) << 3) | (heldExists << 6) | (heldLast << 7));
+}
+
+int state_delay_for_level(int level) {
+    if(level <= 10) {
+        return INITIAL_DELAY - (100 * (level - 1));
+    }
+    return 100 - (10 * (level - 10));
+}
+
+void state_pack(PackedState *p, const GameSim *g) {
+    packMatrix(p, (bool (*)[MATRIX_WIDTH])g->matrix);
+    packPiece(p, &g->t, g->over);
+    p->preview = packPreview(g->next, g->held, g->heldExists, g->heldLast);
+    p->level = (uint8_t)g->level;
+    p->speed = (uint8_t)(g->speedcnt / 100);
+    p->gravity = (uint8_t)g->gravity;
+    p->pad = 0;
+    p->score = (uint32_t)g->score;
+    p->rng = g->rng;
+}
+
+void state_unpack(GameSim *g, const PackedState *p) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            g->matrix[i][j] = (p->rows[i] >> j) & 1;
+        }
+    }
+    for(int i = 0; i < 4; i++) {
+        g->t.current_xy[i].x = blocktomatrix(p->cells[i][0]);
+        g->t.current_xy[i].y = p->cells[i][1];
+        g->t.next_xy[i] = g->t.current_xy[i];
+    }
+    g->t.color = p->piece & 7;
+    g->t.current_orientation = (p->piece >> 3) & 3;
+    g->t.toggle = toggles[g->t.color];
+    g->over = (p->piece >> 7) & 1;
+    g->next = p->preview & 7;
+    g->held = (p->preview >> 3) & 7;
+    g->heldExists = (p->preview >> 6) & 1;
+    g->heldLast = (p->preview >> 7) & 1;
+    g->level = p->level;
+    g->speedcnt = p->speed * 100;
+    g->delay = state_delay_for_level(p->level);
+    g->gravity = p->gravity;
+    g->score = (int)p->score;
+    g->rng = p->rng;
+}
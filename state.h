@@ -0,0 +1,53 @@
+#ifndef STATE_H_
+#define STATE_H_
+
+#include <stdint.h>
+
+#include "sim.h"
+
+// One player's whole game in 72 bytes with no pointers, so it can be copied
+// with memcpy, written to disk or hashed as is. Delay is not stored, it
+// follows from the level, and the toggle function comes from the color.
+// GameSim's bookkeeping (pieces, locked) is not part of the game and not
+// stored either; state_unpack leaves it alone, so whoever restores a state
+// restores what it needs of it, as replay keyframes and the rollback ring do
+// for pieces.
+typedef struct PackedState {
+    uint16_t rows[MATRIX_LENGTH-1];  // bit j set when column j is filled
+    int8_t cells[4][2];              // falling piece, column then row
+    uint8_t piece;                   // color | orientation << 3 | over << 7
+    uint8_t preview;                 // next | held << 3 | heldExists << 6 | heldLast << 7
+    uint8_t level;
+    uint8_t speed;                   // speedcnt / 100
+    uint8_t gravity;
+    uint8_t pad;
+    uint32_t score;
+    uint32_t rng;
+} PackedState;
+
+_Static_assert(sizeof(PackedState) == 72, "PackedState layout changed");
+
+#define STATE_RING_SIZE 64
+
+// Preallocated snapshots addressed by frame (or move) number.
+typedef struct StateRing {
+    PackedState slots[STATE_RING_SIZE];
+} StateRing;
+
+void state_pack(PackedState *p, const GameSim *g);
+
+void state_unpack(GameSim *g, const PackedState *p);
+
+
+// Delay in ms for a level, the same steps updateScoreLevel takes.
+int state_delay_for_level(int level);
+
+static inline void state_ring_save(StateRing *ring, uint32_t index, const PackedState *p) {
+    ring->slots[index & (STATE_RING_SIZE - 1)] = *p;
+}
+
+static inline void state_ring_load(const StateRing *ring, uint32_t index, PackedState *p) {
+    *p = ring->slots[index & (STATE_RING_SIZE - 1)];
+}
+
+#endif
@@ -76,7 +76,7 @@ int tcp_client_receive_response(SOCKET *ConnectSocket, char *message) {
     FILE *fp;
     fp = fopen("data/client_receive.txt", "w+");
     
-    int recvbuflen = 234;
+    int recvbuflen = FRAME_LEN;
     int iResult;
     char c[80];
     iResult = recv((*ConnectSocket), message, recvbuflen, 0);
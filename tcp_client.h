@@ -16,6 +16,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "frame.h"
+
 #define TCP_CLIENT_BAD_SOCKET -1
 #define TCP_CLIENT_DEFAULT_PORT "8081"
 #define TCP_CLIENT_DEFAULT_HOST "localhost"
@@ -41,6 +41,12 @@ int tcp_server_create(SOCKET *ListenSocket, char *port) {
         // fclose(fp);
         return 1;
     }
+#ifndef _WIN32
+    // every exchange is closed from this side, so the port is full of
+    // TIME_WAIT connections and a restarted host couldn't bind it again
+    int one = 1;
+    setsockopt(*ListenSocket, SOL_SOCKET, SO_REUSEADDR, (char *)&one, sizeof(one));
+#endif
     // Setup the TCP listening socket
     iResult = bind( *ListenSocket, result->ai_addr, (int)result->ai_addrlen);
     if (iResult == SOCKET_ERROR) {
@@ -60,6 +66,7 @@ int tcp_server_create(SOCKET *ListenSocket, char *port) {
         // fclose(fp);
         return 1;
     }
+    return 0;
 }
 
 
@@ -83,7 +90,7 @@ int tcp_server_accept_connection(SOCKET *ListenSocket, SOCKET *ClientSocket) {
 }
 
 int tcp_server_receive_request(SOCKET *ClientSocket, char *message) {
-    int recvbuflen = 234;
+    int recvbuflen = FRAME_LEN;
     int iResult;
     FILE *fp;
 
@@ -115,7 +122,7 @@ int tcp_server_send_response(SOCKET *ClientSocket, char *message) {
     fp = fopen("data/server_send.txt", "w+");
     fputs(message, fp);
     int iSendResult;
-    int length = (sizeof(char *)) * strlen(message);
+    int length = strlen(message);
     // Echo the buffer back to the sender
     iSendResult = send(*ClientSocket, message, length, 0);
     if (iSendResult == SOCKET_ERROR) {
@@ -18,6 +18,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "frame.h"
+
 int tcp_server_create(SOCKET *ListenSocket, char *port);
 
 int tcp_server_accept_connection(SOCKET *ListenSocket, SOCKET *ClientSocket);
@@ -8,10 +8,32 @@
 #include <sys/stat.h>
 #include <pthread.h>
 
+#include "tetris.h"
 #include "tcp_client.h"
 #include "tcp_server.h"
-
-// to compile for windows: gcc -I/mingw64/include/ncurses -o tetris.exe tetris.c tcp_client.c tcp_server.c -lncurses -lws2_32 -lpthread -L/mingw64/bin -static
+#include "perft.h"
+#include "bench.h"
+#include "timer.h"
+#include "framestats.h"
+#include "netstats.h"
+#include "frame.h"
+#include "render.h"
+#include "golden.h"
+#include "rollback.h"
+#include "spectate.h"
+#include "replay.h"
+#include "export.h"
+#include "eval.h"
+#include "tune.h"
+#include "tournament.h"
+#include "loadgen.h"
+#include "pacer.h"
+#include "autoshift.h"
+#include "scores.h"
+#include "local.h"
+#include "view.h"
+
+// to compile for windows: gcc -I/mingw64/include/ncurses -o tetris.exe tetris.c tcp_client.c tcp_server.c timer.c perft.c bench.c histogram.c framestats.c netstats.c render.c render_ansi.c render_mem.c golden.c sim.c state.c rollback.c spectate.c replay.c arena.c bot.c eval.c export.c tune.c tournament.c loadgen.c pacer.c autoshift.c scores.c perfctr.c local.c tribuf.c view.c transport.c impair.c -lncurses -lws2_32 -lpthread -L/mingw64/bin -static
 //
 //    ////////// ////// ////////// /////////  //////// ////////
 //       //     //         //     //     //     //    //
@@ -78,95 +100,31 @@
 // [   [1]   |   |[2][1][3]|
 // [   [0]   |   |      [0]|
 //
-#define BLOCK "[ ]"
-#define paint(y, x) mvprintw(y, x, BLOCK);
-#define whiteout(y, x) mvprintw(y, x, "   ");
-#define log(x) fputs(x, err);
-#define blocktomatrix(x) (x*3)+7
-#define blocktomatrix2(x) (x*3)+62
-#define matrixtoblock(x) (x-7)/3
-#define MATRIX "|                             |"
-#define MATRIX_BOTTOM "|_____________________________|"
-#define MATRIX_LENGTH 26
-#define MATRIX_WIDTH 9
-#define ESC_KEY 27
-#define INITIAL_DELAY 1000
-#define ARROW_X 23
-
-typedef enum {LEFT, RIGHT, UP, DOWN} Orientation; 
-typedef enum {RED, GREEN, CYAN, BLUE, YELLOW, PURPLE, ORANGE, RANDOM} Color;
-typedef enum {NEXT, HOLD} Display;
-
-typedef struct block_coords {
-    int x;
-    int y;
-} block_coords;
-
-typedef struct tetrimo {
-    block_coords current_xy[4];
-    block_coords next_xy[4];
-    Color color;
-    Orientation current_orientation;
-    void (*toggle)(struct tetrimo*, bool[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-} tetrimo;
-
-void initMatrix(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void drawBoard(int score, int level, int offset);
-void draw(tetrimo t);
-void elim(tetrimo t);
-void drawRed(Display d, int offset);
-void eraseRed(Display d, int offset);
-void drawGreen(Display d, int offset);
-void eraseGreen(Display d, int offset);
-void drawCyan(Display d, int offset);
-void eraseCyan(Display d, int offset);
-void drawBlue(Display d, int offset);
-void eraseBlue(Display d, int offset);
-void drawYellow(Display d, int offset);
-void eraseYellow(Display d, int offset);
-void drawPurple(Display d, int offset);
-void erasePurple(Display d, int offset);
-void drawOrange(Display d, int offset);
-void eraseOrange(Display d, int offset);
-bool shift(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void updateScoreLevel(int mult, int *score, int *level, int *speedcnt, int *delay);
-bool update(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleRed(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleGreen(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleCyan(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleBlue(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleYellow(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void togglePurple(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void toggleOrange(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void eraseNext(Color c, int offset);
-void drawNext(Color c, int offset);
-tetrimo newBlock(Color c, Color *next_tetrimo, int offset);
-int checkLine(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void save(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color current_color, int delay, int speedcnt, int level, int score, Color next_tetrimo, bool heldExists, bool heldLast, Color held_tetrimo);
-void load(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *current_color, int *delay, int *speedcnt, int *level, int *score, Color *next_tetrimo, bool *heldExists, bool *heldLast, Color *held_tetrimo);
-void drawHeld(Color c, int offset);
-void eraseHeld(Color c, int offset);
-void drawTitle(bool isSave);
-void drawOptions(int level);
-void drawControls();
-void drawScoreLevel(int score, int level, int offset);
-void drawGameOver();
-bool checkDown(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void updateMatrix(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
-void *play(void *id);
-void *server(void *port);
-void *client(void *con);
-void getIpAddr2(char *ip);
-void getPort(char *port);
-int hostOrClient();
-void drawSecondPlayer(char *second);
 
 int max_y = 0;
 int max_x = 0;
 
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-
+// broadcast with mutex held by publishState()
+pthread_cond_t stateChanged = PTHREAD_COND_INITIALIZER;
+unsigned long stateVersion;
+bool waitingForPeer;
+
+// per thread, so a game thread that doesn't draw (a sim or perft worker)
+// doesn't stop the one that does from drawing
+_Thread_local bool headless = false;
+int netRate = 0;
+int dasMs = AUTOSHIFT_DAS_MS;
+int arrMs = AUTOSHIFT_ARR_MS;
+char playerName[SCORES_NAME_LEN];
+bool udpTransport = false;
+ImpairConfig impairment;
+ScoreStore scores;
+bool scoresOpen = false;
 bool gameOver;
+// where update() reports a piece stuck at the top; sims point it at a local
+// of their own so worker threads never write gameOver
+_Thread_local bool *topOut = &gameOver;
 int level;
 int score;
 int speedcnt;
@@ -175,18 +133,93 @@ int delay;
 tetrimo currentTetrimo;
 unsigned int seed;
 
+FrameStats frameStats;
+View view;
+
 bool matrix_g[MATRIX_LENGTH-1][MATRIX_WIDTH];
 
 int main(int argc, char *argv[]) {
 
+    if(argc > 1 && strcmp(argv[1], "perft") == 0) {
+        return perft_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return bench_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "frames") == 0) {
+        return golden_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "replay") == 0) {
+        return replay_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "export") == 0) {
+        return export_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "tune") == 0) {
+        return tune_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "tournament") == 0) {
+        return tournament_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "loadgen") == 0) {
+        return loadgen_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "scores") == 0) {
+        return scores_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "impair") == 0) {
+        return impair_main(argc - 1, argv + 1);
+    }
+    if(argc > 1 && strcmp(argv[1], "eval") == 0) {
+        return eval_main(argc - 1, argv + 1);
+    }
+
     initscr();
     noecho();
     curs_set(FALSE);
     keypad(stdscr, TRUE);
     timeout(INITIAL_DELAY);
+    if(view_init(&view, &viewPlay)) {
+        endwin();
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "ansi") == 0 && render_ansi_enable() == 0) {
+            // curses clears the screen on its first refresh, get that out of
+            // the way before the ANSI backend starts drawing
+            refresh();
+            render_use(&render_ansi);
+        } else if(strcmp(argv[i], "rate") == 0 && i + 1 < argc) {
+            netRate = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "das") == 0 && i + 1 < argc) {
+            dasMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "arr") == 0 && i + 1 < argc) {
+            arrMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "player") == 0 && i + 1 < argc) {
+            snprintf(playerName, sizeof(playerName), "%s", argv[++i]);
+        } else if(strcmp(argv[i], "udp") == 0) {
+            udpTransport = true;
+        } else if(strcmp(argv[i], "loss") == 0 && i + 1 < argc) {
+            impairment.lossPct = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "latency") == 0 && i + 1 < argc) {
+            impairment.latencyMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "jitter") == 0 && i + 1 < argc) {
+            impairment.jitterMs = atoi(argv[++i]);
+        }
+    }
 
     mkdir("savefiles");
     mkdir("data");
+    if(playerName[0] == '\0') {
+        const char *user = getenv("USERNAME") != NULL ? getenv("USERNAME") : getenv("USER");
+        snprintf(playerName, sizeof(playerName), "%s", user != NULL ? user : "player");
+    }
+    if(scores_open(&scores, NULL, NULL) == 0) {
+        scoresOpen = true;
+        atexit(closeScores);
+    }
 
     level = 1;
     score = 0;
@@ -209,21 +242,21 @@ int main(int argc, char *argv[]) {
         int arrow_pos = 13;
         bool title_flg;
         while(!title_flg) {
-            switch(wgetch(stdscr)) {
+            switch(render_getch()) {
                 case KEY_UP:
                     if(option != 0) {
                         option--;
-                        mvprintw(arrow_pos, ARROW_X, "  ");
+                        render_printf(arrow_pos, ARROW_X, "  ");
                         arrow_pos -= 2;
-                        mvprintw(arrow_pos, ARROW_X, "->");
+                        render_printf(arrow_pos, ARROW_X, "->");
                     }
                     break;
                 case KEY_DOWN:
                     if(option != numOptions) {
                         option++;
-                        mvprintw(arrow_pos, ARROW_X, "  ");
+                        render_printf(arrow_pos, ARROW_X, "  ");
                         arrow_pos += 2;
-                        mvprintw(arrow_pos, ARROW_X, "->");
+                        render_printf(arrow_pos, ARROW_X, "->");
                     }
                     break;
                 case '\n':
@@ -251,7 +284,7 @@ int main(int argc, char *argv[]) {
         }
 
 
-        refresh();
+        render_flush();
 
         time_t ti;
         srand((unsigned)time(&ti));
@@ -260,23 +293,23 @@ int main(int argc, char *argv[]) {
         int game;
         switch(option) {
             case 0:
-                clear();
+                render_clear();
                 game = 0;
                 play((void *)&game);
-                clear();
+                render_clear();
                 drawGameOver();
-                while(wgetch(stdscr) != ESC_KEY) {}
+                while(render_getch() != ESC_KEY) {}
                 break;
             case 1:
-                clear();
+                render_clear();
                 game = 1;
                 play((void *)&game);
-                clear();
+                render_clear();
                 drawGameOver();
-                while(wgetch(stdscr) != ESC_KEY) {}
+                while(render_getch() != ESC_KEY) {}
                 break;
             case 2:
-                clear();
+                render_clear();
                 int isClient = hostOrClient();
                 currentTetrimo.current_xy[0].x = 0;
                 if(isClient == 1) {
@@ -284,14 +317,14 @@ int main(int argc, char *argv[]) {
                     FILE *fp;
                     fp = fopen("data/adddr.txt", "w+");
                     Config con;
-                    clear();
+                    render_clear();
                     char host[40];
                     getIpAddr2(host);
                     con.host = host;
                     if(host == NULL) {
                         break;
                     }
-                    clear();
+                    render_clear();
                     char port[6];
                     getPort(port);
                     if(port == NULL) {
@@ -302,59 +335,113 @@ int main(int argc, char *argv[]) {
                     fputs(con.host, fp);
                     fputs(con.port, fp);
                     fclose(fp);
-                    clear();
+                    render_clear();
                     pthread_t client_id;
                     pthread_t play_id;
                     pthread_create(&client_id, NULL, client, (void *)&con);
                     pthread_create(&play_id, NULL, play, (void *)&game);
                     pthread_join(play_id, NULL);
+                    pthread_mutex_lock(&mutex);
                     gameOver = true;
+                    publishState();
+                    pthread_mutex_unlock(&mutex);
                     pthread_join(client_id, NULL);
-                    clear();
+                    render_clear();
                     drawGameOver();
-                    while(wgetch(stdscr) != ESC_KEY) {}
+                    while(render_getch() != ESC_KEY) {}
                 } else if(isClient == 0) {
                     game = 3;
-                    clear();
+                    render_clear();
                     char port[6];
                     getPort(port);
                     if(port == NULL) {
                         break;
                     }
                     srand((unsigned) atoi(port));
-                    clear();
+                    render_clear();
                     pthread_t server_id;
                     pthread_t play_id;
+                    waitingForPeer = true;
                     pthread_create(&server_id, NULL, server, (void *)port);
                     pthread_create(&play_id, NULL, play, (void *)&game);
                     pthread_join(play_id, NULL);
+                    pthread_mutex_lock(&mutex);
                     gameOver = true;
+                    publishState();
+                    pthread_mutex_unlock(&mutex);
                     pthread_join(server_id, NULL);
-                    clear();
+                    render_clear();
+                    drawGameOver();
+                    while(render_getch() != ESC_KEY) {}
+                } else if(isClient == 2) {
+                    render_clear();
+                    char port[6];
+                    getPort(port);
+                    render_clear();
+                    rollback_host(port);
+                    render_clear();
+                    drawGameOver();
+                    while(render_getch() != ESC_KEY) {}
+                } else if(isClient == 3) {
+                    Config con;
+                    render_clear();
+                    char host[40];
+                    getIpAddr2(host);
+                    con.host = host;
+                    render_clear();
+                    char port[6];
+                    getPort(port);
+                    con.port = port;
+                    render_clear();
+                    rollback_join(con);
+                    render_clear();
+                    drawGameOver();
+                    while(render_getch() != ESC_KEY) {}
+                } else if(isClient == 4) {
+                    Config con;
+                    render_clear();
+                    char host[40];
+                    getIpAddr2(host);
+                    con.host = host;
+                    render_clear();
+                    char port[6];
+                    getPort(port);
+                    con.port = port;
+                    render_clear();
+                    spectate_watch(con);
+                    render_clear();
                     drawGameOver();
-                    while(wgetch(stdscr) != ESC_KEY) {}
+                    while(render_getch() != ESC_KEY) {}
+                } else if(isClient == 5) {
+                    int players = getPlayers();
+                    if(players == 0) {
+                        break;
+                    }
+                    local_run(players, (unsigned)rand());
+                    while(render_getch() != ESC_KEY) {}
+                    render_clear();
                 } else {
                     break;
                 }
                 break;
             case 3:
-                clear();
+                render_clear();
                 drawOptions(level);
                 bool options_flg;
                 int new_level = level;
                 while(!options_flg) {
-                    switch (wgetch(stdscr))
+                    switch (render_getch())
                     {
                     case KEY_LEFT:
                         if(new_level != 1) {
                             new_level--;
-                            mvprintw(13, 26, "Level: %2d", new_level);
+                            render_printf(13, 26, "Level: %2d", new_level);
                         }
                         break;
                     case KEY_RIGHT:
                         if(new_level != 20) {
                             new_level++;
-                            mvprintw(13, 26, "Level: %2d", new_level);
+                            render_printf(13, 26, "Level: %2d", new_level);
                         }
                         break;
                     case ESC_KEY:
@@ -372,114 +459,146 @@ int main(int argc, char *argv[]) {
                 options_flg = 0;
                 title_flg = 0;
                 option = 0;
-                clear();
+                render_clear();
                 goto START;
                 break;
             case 4:
-                clear();
+                render_clear();
                 drawControls();
-                while(wgetch(stdscr)!= ESC_KEY) {}
+                while(render_getch()!= ESC_KEY) {}
                 title_flg = 0;
                 option = 0;
-                clear();
+                render_clear();
                 goto START;
                 break;
             default:
                 break;
         }
-        clear();
+        render_clear();
         gameOver = false;
+        waitingForPeer = false;
         title_flg = 0;
         option = 0;
     }
     endwin();
 }
 
+// Fills the next ViewFrame from the game state and hands it to the render
+// thread. Only called from play(), which is the only writer of the board.
+static void publishFrame(tetrimo *t, Color next, bool heldExists, Color held, bool paused, uint64_t inputAt) {
+    static uint32_t seq;
+    ViewFrame *f = view_frame(&view);
+    f->seq = ++seq;
+    memcpy(f->cells, matrix_g, sizeof(f->cells));
+    for(int i = 0; i < 4; i++) {
+        if(t->current_xy[i].y >= 0) {
+            f->cells[t->current_xy[i].y][matrixtoblock(t->current_xy[i].x)] = true;
+        }
+    }
+    f->next = next;
+    f->held = held;
+    f->heldExists = heldExists;
+    f->score = score;
+    f->level = level;
+    f->paused = paused;
+    f->overlay = frameStats.overlay;
+    if(f->overlay) {
+        framestats_row(&frameStats.tick, &f->tick);
+        framestats_row(&frameStats.mutex, &f->mutexWait);
+    }
+    f->inputAt = inputAt;
+    view_publish(&view);
+}
+
+// Runs the game on the calling thread. Drawing and reading the keyboard are
+// left to the view's render thread, so nothing in here touches curses.
 void *play(void *id) {
     int *i = (int *)id;
     int game = *i;
-    Color held_tetrimo;
+    Color held_tetrimo = RED;
     bool pause_flg = false;
     bool toggle_flg = false;
     bool block_flg = false;
     
     bool heldExists = false;
     bool heldLast = false;
+
+    // the engine's own drawing calls are skipped on this thread, solo games
+    // run on the main thread, so it's given back on the way out
+    bool wasHeadless = headless;
+    headless = true;
+    framestats_reset(&frameStats);
+    view_start(&view, game >= 2, &frameStats);
     
     initMatrix(matrix_g);
     
     Color next_tetrimo = rand()%7;
     Color c = RANDOM;
     
-    int cnt = 0;
+    AutoShift autoShift;
+    autoshift_init(&autoShift, dasMs, arrMs);
     
     tetrimo t = newBlock(c, &next_tetrimo, 0);
 
-    int offset;
-    
-    if(game == 0) {
-        drawBoard(score, level, 0);
-    } else if(game == 1) {
-        drawBoard(score, level, 0);
+    if(game == 1) {
         load(matrix_g, &c, &delay, &speedcnt, &level, &score, &next_tetrimo, &heldExists, &heldLast, &held_tetrimo);
-        timeout(delay);
-    }else {
-        offset = 55;
-        drawBoard(score, level, 0);
-        drawBoard(score, level, offset);
     }
+    publishFrame(&t, next_tetrimo, heldExists, held_tetrimo, false, 0);
+
+    // a host doesn't start until the other player has connected
+    pthread_mutex_lock(&mutex);
+    while(waitingForPeer && !gameOver) {
+        pthread_cond_wait(&stateChanged, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+    uint64_t nextDrop = timer_now_ns() + delay * 1000000ULL;
       
     while(1) {
         if(pause_flg) {
-            pthread_mutex_lock(&mutex);
-            mvprintw(13,18, "PAUSED");
-            while(wgetch(stdscr) != 'p'){}
-            mvprintw(13,18, "      ");
-            pthread_mutex_unlock(&mutex);
+            publishFrame(&t, next_tetrimo, heldExists, held_tetrimo, true, 0);
+            // the network threads keep answering while paused, give up if
+            // the other side ends the game
+            while(!gameOver && view_key(&view, PAUSE_POLL_MS * 1000000ULL, NULL) != 'p') {}
+            publishFrame(&t, next_tetrimo, heldExists, held_tetrimo, false, 0);
             pause_flg = false;
+            nextDrop = timer_now_ns() + delay * 1000000ULL;
         }
-        Orientation movement = DOWN;
-        int key = wgetch((stdscr));
+        // sleep until a key, gravity or the next auto-shift is due
+        uint64_t now = timer_now_ns();
+        uint64_t wait = nextDrop > now ? nextDrop - now : 0;
+        uint64_t shiftWait = autoshift_wait_ns(&autoShift, now);
+        if(shiftWait < wait) {
+            wait = shiftWait;
+        }
+        uint64_t keyAt = 0;
+        int key = view_key(&view, wait, &keyAt);
+        uint64_t tickStart = timer_now_ns();
+        int columns = autoshift_update(&autoShift, key, tickStart);
+        // keys other than left/right still move the piece down like before
+        bool fall = key != ERR || tickStart >= nextDrop;
         switch (key)
         {
         case 'p':
             pause_flg = ~pause_flg;
             break;
         case '\t':
-            if(cnt++ == 2) {
-                cnt = 0;
-                pthread_mutex_lock(&mutex);
-                update(movement, &t, matrix_g);
-                pthread_mutex_unlock(&mutex);
-            }
-            pthread_mutex_lock(&mutex);
+            framestats_lock(&frameStats, &mutex);
             t.toggle(&t, matrix_g);
             pthread_mutex_unlock(&mutex);
             toggle_flg = true;
             break;
         case KEY_RIGHT:
-            if(cnt++ == 2) {
-                cnt = 0;
-                pthread_mutex_lock(&mutex);
-                update(movement, &t, matrix_g);
-                pthread_mutex_unlock(&mutex);
-            }
-            movement = RIGHT;
-            break;
         case KEY_LEFT:
-            if(cnt++ == 2) {
-                cnt = 0;
-                pthread_mutex_lock(&mutex);
-                update(movement, &t, matrix_g);
-                pthread_mutex_unlock(&mutex);
-            }
-            movement = LEFT;
+            fall = false;
             break;
         case 's':
             save(matrix_g, t.color, delay, speedcnt, level, score, next_tetrimo, heldExists, heldLast, held_tetrimo);
             break;
         case 'z':
             save(matrix_g, t.color, delay, speedcnt, level, score, next_tetrimo, heldExists, heldLast, held_tetrimo);
+            view_stop(&view);
+            framestats_dump(&frameStats, FRAMESTATS_FILE);
+            headless = wasHeadless;
             endwin();
             exit(EXIT_SUCCESS);
             break;
@@ -488,20 +607,20 @@ void *play(void *id) {
                 break;
             }
             heldLast = TRUE;
-            pthread_mutex_lock(&mutex);
-            elim(t);
+            framestats_lock(&frameStats, &mutex);
             if(heldExists) {
-                eraseNext(next_tetrimo, 0);
                 next_tetrimo = held_tetrimo;
             }
-            eraseHeld(held_tetrimo, 0);
             held_tetrimo = t.color;
-            drawHeld(held_tetrimo, 0); 
             heldExists = true;
             t = newBlock(RANDOM, &next_tetrimo, 0);
             pthread_mutex_unlock(&mutex);
             break;
+        case FRAMESTATS_KEY:
+            frameStats.overlay = !frameStats.overlay;
+            break;
         case ESC_KEY:
+            recordScore(game);
             delay = 1000;
             speedcnt = 0;
             pause_flg = false;
@@ -511,106 +630,125 @@ void *play(void *id) {
             level = 1;
             heldExists = FALSE;
             heldLast = FALSE;
-            pthread_mutex_lock(&mutex);
+            framestats_lock(&frameStats, &mutex);
             gameOver = true;
+            publishState();
             pthread_mutex_unlock(&mutex);
+            view_stop(&view);
+            framestats_dump(&frameStats, FRAMESTATS_FILE);
+            headless = wasHeadless;
             return 0;
             break;
         default:
-            cnt = 0;
             break;
         }
-        if(!toggle_flg){
-            pthread_mutex_lock(&mutex);
-            if(!update(movement, &t, matrix_g)) {
+        if(columns != 0) {
+            framestats_lock(&frameStats, &mutex);
+            for(int n = 0; n < abs(columns); n++) {
+                update(columns < 0 ? LEFT : RIGHT, &t, matrix_g);
+            }
+            pthread_mutex_unlock(&mutex);
+        }
+        if(!toggle_flg && fall){
+            framestats_lock(&frameStats, &mutex);
+            if(!update(DOWN, &t, matrix_g)) {
                 updateMatrix(t, matrix_g);
                 t = newBlock(RANDOM, &next_tetrimo, 0);
                 heldLast = false;
             }
             pthread_mutex_unlock(&mutex);
+            nextDrop = tickStart + delay * 1000000ULL;
         }
         currentTetrimo = t;
         if(gameOver) {
+            framestats_lock(&frameStats, &mutex);
+            publishState();
+            pthread_mutex_unlock(&mutex);
+            recordScore(game);
+            publishFrame(&t, next_tetrimo, heldExists, held_tetrimo, false, 0);
+            view_stop(&view);
+            framestats_dump(&frameStats, FRAMESTATS_FILE);
+            headless = wasHeadless;
             return 0;
         }
         toggle_flg = false;
-        pthread_mutex_lock(&mutex);
+        framestats_lock(&frameStats, &mutex);
         int endLine = checkLine(matrix_g);
-        pthread_mutex_unlock(&mutex);
         if(endLine) {
-            pthread_mutex_lock(&mutex);
-            updateScoreLevel(endLine, &score, &level, &speedcnt, &delay);
-            pthread_mutex_unlock(&mutex);
+            addScore(endLine, &score, &level, &speedcnt, &delay);
         }
+        publishState();
+        pthread_mutex_unlock(&mutex);
+        publishFrame(&t, next_tetrimo, heldExists, held_tetrimo, false, key != ERR ? keyAt : 0);
+        histogram_record(&frameStats.tick, timer_now_ns() - tickStart);
     }
-    refresh();
 }
 
 void *client(void *con) {
     
     SOCKET c;
-    char receive[234];
-    char send[234];
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
     Config *conf = (Config *)con;
     Config config = *conf;
     bool over = false;
+    NetStats ns;
+    netstats_init(&ns);
+    Pacer pacer;
+    pacer_init(&pacer, netRate);
+    unsigned long seen = 0;
     FILE *s;
     s = fopen("data/client_err.txt", "w+");
     while(!over) {
-        for(int i = 0; i < 25; i++) {
-            for(int j = 0; j < 9; j++) {
-                if(matrix_g[i][j] == TRUE){
-                    send[(i*9)+j] = '1';
-                } else {
-                    send[(i*9)+j] = '0';
-                }
-            }
-        }
-        
-        if(currentTetrimo.current_xy[0].x != 0) {
-            for(int i = 0; i < 4; i++) {
-                send[(currentTetrimo.current_xy[i].y*9)+matrixtoblock(currentTetrimo.current_xy[i].x)] = '1';
-            }
-        }
-        char lev[3];
-        sprintf(lev, "%02d", level);
-        send[225] = lev[0];
-        send[226] = lev[1];
-        char sc[6];
-        sprintf(sc, "%5d", score);
-        send[227] = sc[0];
-        send[228] = sc[1];
-        send[229] = sc[2];
-        send[230] = sc[3];
-        send[231] = sc[4];
-        char o = '0';
         if(gameOver) {
             fputs("game over", s);
-            o = '1';
             over = true;
         }
-        send[232] = o;
-        send[233]= '\0';
+        encodeState(send, over);
+        uint64_t now = timer_now_ns();
+        // only exchange when something changed or the host is due a poll,
+        // the game over frame always goes out
+        if(!over && !pacer_due(&pacer, send, now)) {
+            waitState(&seen, pacer_wait_ns(&pacer, send, now));
+            continue;
+        }
+        pacer_sent(&pacer, send, now);
+        memset(receive, 0, sizeof(receive));
+        bool failed = false;
         if(tcp_client_connect(config, &c)) {
             fputs("connect error", s);
-        }        
+            netstats_error(&ns);
+            failed = true;
+        }
+        netstats_stamp(&ns, send);
         if(tcp_client_send_request(&c, send)) {
             fputs("send request error", s);
+            netstats_error(&ns);
+            failed = true;
         }
         if(tcp_client_receive_response(&c, receive)) {
             fputs("receive response rror", s);
+            netstats_error(&ns);
+            failed = true;
         }
         
         tcp_client_close(c);
-        if(receive[232] == '1') {
+        bool valid = netstats_receive(&ns, receive);
+        pacer_answered(&pacer, failed || !valid ? NULL : receive, timer_now_ns() - now);
+        if(receive[FRAME_OVER] == '1') {
             pthread_mutex_lock(&mutex);
             gameOver = true;
+            publishState();
             pthread_mutex_unlock(&mutex);
             over = true;
         }
-        pthread_mutex_lock(&mutex);
-        drawSecondPlayer(receive);
-        pthread_mutex_unlock(&mutex);
+        view_publish_remote(&view, receive, &ns);
+    }
+    netstats_dump(&ns, NETSTATS_CLIENT_FILE);
+    FILE *stats = fopen(NETSTATS_CLIENT_FILE, "a");
+    if(stats) {
+        pacer_dump(&pacer, stats);
+        fclose(stats);
     }
     fclose(s);
 }
@@ -619,78 +757,158 @@ void *server(void *port) {
     char *p = (char *)port;
     SOCKET l;
     SOCKET c;
-    char receive[234];
-    char send[234];
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
     bool firstConnect = false;
+    NetStats ns;
+    netstats_init(&ns);
     tcp_server_create(&l, p);
+    SpectateHub *hub = spectate_start(p);
     bool over = false;
     while(!over) {
         FILE *q;
         q = fopen("data/server_err.txt", "w+");
-        if(firstConnect == false) {
-            pthread_mutex_lock(&mutex);
-        }
         if(tcp_server_accept_connection(&l, &c)) {
             fputs("accept connection errror", q); 
+            netstats_error(&ns);
         }
         if(firstConnect == false) {
+            pthread_mutex_lock(&mutex);
+            waitingForPeer = false;
+            publishState();
             pthread_mutex_unlock(&mutex);
             firstConnect = true;
+            netstats_init(&ns);
         }
+        memset(receive, 0, sizeof(receive));
         if(tcp_server_receive_request(&c, receive)) {
             fputs("receive request errror", q);
+            netstats_error(&ns);
         }
-        for(int i = 0; i < 25; i++) {
-            for(int j = 0; j < 9; j++) {
-                if(matrix_g[i][j] == TRUE){
-                    send[(i*9)+j] = '1';
-                } else {
-                    send[(i*9)+j] = '0';
-                }
-            }
-        }  
-        if(currentTetrimo.current_xy[0].x != 0) {
-            for(int i = 0; i < 4; i++) {
-                send[(currentTetrimo.current_xy[i].y*9)+matrixtoblock(currentTetrimo.current_xy[i].x)] = '1';
-            }
-        }
-        char lev[3];
-        sprintf(lev, "%02d", level);
-        send[225] = lev[0];
-        send[226] = lev[1];
-        char sc[6];
-        sprintf(sc, "%5d", score);
-        send[227] = sc[0];
-        send[228] = sc[1];
-        send[229] = sc[2];
-        send[230] = sc[3];
-        send[231] = sc[4];
-        char o = '0';
+        bool valid = netstats_receive(&ns, receive);
         if(gameOver) {
-            o = '1';
             over = true;
         }
-        send[232] = o;
-        send[233]= '\0';
-        if(receive[232] == '1') {
+        encodeState(send, over);
+        if(hub != NULL && valid) {
+            spectate_publish(hub, send, receive);
+        }
+        if(receive[FRAME_OVER] == '1') {
             pthread_mutex_lock(&mutex);
             gameOver = true;
+            publishState();
             pthread_mutex_unlock(&mutex);
             over = true;
         }
+        netstats_stamp(&ns, send);
         if(tcp_server_send_response(&c, send)) {
             fputs("send error", q);
+            netstats_error(&ns);
+        } else if(!over) {
+            // the client connects again for the next frame
+            closesocket(c);
         }
-        pthread_mutex_lock(&mutex);
-        drawSecondPlayer(receive);
-        pthread_mutex_unlock(&mutex);
+        view_publish_remote(&view, receive, &ns);
         fclose(q);
     }
-    
+    netstats_dump(&ns, NETSTATS_SERVER_FILE);
+    spectate_stop(hub);
+
     tcp_server_close(c, l);
 }
 
-void drawSecondPlayer(char *second) {
+// Hands a finished game to the score store's writer thread, never waits.
+void submitScore(int mode, int score, int level, uint32_t pieces, const char *player) {
+    if(!scoresOpen) {
+        return;
+    }
+    ScoreRecord r;
+    memset(&r, 0, sizeof(r));
+    r.mode = mode;
+    r.level = level;
+    r.score = score;
+    r.pieces = pieces;
+    snprintf(r.player, sizeof(r.player), "%s", player);
+    scores_submit(&scores, &r, false);
+}
+
+void recordScore(int game) {
+    submitScore(game >= 2 ? SCORES_2P : SCORES_SOLO, score, level, 0, playerName);
+}
+
+void closeScores() {
+    if(scoresOpen) {
+        scoresOpen = false;
+        scores_close(&scores);
+    }
+}
+
+// Wakes threads waiting in waitState(), call with mutex held after changing
+// the board, ending the game or letting play() start.
+void publishState() {
+    stateVersion++;
+    pthread_cond_broadcast(&stateChanged);
+}
+
+// Sleeps until there is a change newer than *seen, the game is over or ns
+// have passed. The mutex is only held while checking, never while asleep.
+void waitState(unsigned long *seen, uint64_t ns) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ns / 1000000000ULL;
+    until.tv_nsec += ns % 1000000000ULL;
+    if(until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&mutex);
+    while(*seen == stateVersion && !gameOver) {
+        if(pthread_cond_timedwait(&stateChanged, &mutex, &until) != 0) {
+            break;
+        }
+    }
+    *seen = stateVersion;
+    pthread_mutex_unlock(&mutex);
+}
+
+// Encodes the board with the falling piece, level, score and game over flag
+// into the frame exchanged by client() and server(). The telemetry fields are
+// zeroed here and filled in by netstats_stamp() just before sending.
+void encodeState(char *send, bool over) {
+    for(int i = 0; i < 25; i++) {
+        for(int j = 0; j < 9; j++) {
+            if(matrix_g[i][j] == TRUE){
+                send[(i*9)+j] = '1';
+            } else {
+                send[(i*9)+j] = '0';
+            }
+        }
+    }
+    if(currentTetrimo.current_xy[0].x != 0) {
+        for(int i = 0; i < 4; i++) {
+            send[(currentTetrimo.current_xy[i].y*9)+matrixtoblock(currentTetrimo.current_xy[i].x)] = '1';
+        }
+    }
+    char lev[3];
+    sprintf(lev, "%02d", level);
+    send[FRAME_LEVEL] = lev[0];
+    send[FRAME_LEVEL+1] = lev[1];
+    char sc[6];
+    sprintf(sc, "%5d", score);
+    send[FRAME_SCORE] = sc[0];
+    send[FRAME_SCORE+1] = sc[1];
+    send[FRAME_SCORE+2] = sc[2];
+    send[FRAME_SCORE+3] = sc[3];
+    send[FRAME_SCORE+4] = sc[4];
+    send[FRAME_OVER] = over ? '1' : '0';
+    memset(send + FRAME_SEQ, '0', FRAME_LEN - 1 - FRAME_SEQ);
+    send[FRAME_LEN - 1] = '\0';
+}
+
+void drawSecondPlayer(char *second, NetStats *ns) {
+    if(ns != NULL) {
+        netstats_draw(ns, 28, 5+55);
+    }
     for(int i = 0; i < 25; i++) {
         for(int j = 0; j < 9; j++) {
             if(second[(i*9)+j] == '1'){
@@ -700,110 +918,145 @@ void drawSecondPlayer(char *second) {
             }
         }
     }
-    mvprintw(27,21+55, "     ");
-    mvprintw(27,16+55,"Level:    %c%c", second[225], second[226]);
+    render_printf(27,21+55, "     ");
+    render_printf(27,16+55,"Level:    %c%c", second[225], second[226]);
     if(second[227] == '0') {
         if(second[228] == '0') {
             if(second[229] == '0') {
                 return;
             }
-            mvprintw(26,21+55, "     ");
-            mvprintw(26,16+55,"Score: %c%c%c", second[229], second[230], second[231]);
+            render_printf(26,21+55, "     ");
+            render_printf(26,16+55,"Score: %c%c%c", second[229], second[230], second[231]);
             return;
         }
-        mvprintw(26,21+55, "     ");
-        mvprintw(26,16+55,"Score: %c%c%c%c", second[228], second[229], second[230], second[231]);
+        render_printf(26,21+55, "     ");
+        render_printf(26,16+55,"Score: %c%c%c%c", second[228], second[229], second[230], second[231]);
         return;
     }
-    mvprintw(26,21+55, "     ");
-    mvprintw(26,16+55,"Score: %c%c%c%c%c", second[227], second[228], second[229], second[230], second[231]);
+    render_printf(26,21+55, "     ");
+    render_printf(26,16+55,"Score: %c%c%c%c%c", second[227], second[228], second[229], second[230], second[231]);
 }
 
 void drawTitle(bool isSave) {
-    mvprintw(5,5, "////////// ////// ////////// /////////  //////// ////////");
-    mvprintw(6,5, "   //     //         //     //     //     //    //");
-    mvprintw(7,5, "  //     //////     //     /////////     //     //////");
-    mvprintw(8,5, " //     //         //     //    \\\\      //          //");
-    mvprintw(9,5, "//     //////     //     //      \\\\  ///////  ///////");
-    mvprintw(13, ARROW_X, "->");
-    mvprintw(13, 26, "NEW GAME");
+    render_printf(5,5, "////////// ////// ////////// /////////  //////// ////////");
+    render_printf(6,5, "   //     //         //     //     //     //    //");
+    render_printf(7,5, "  //     //////     //     /////////     //     //////");
+    render_printf(8,5, " //     //         //     //    \\\\      //          //");
+    render_printf(9,5, "//     //////     //     //      \\\\  ///////  ///////");
+    render_printf(13, ARROW_X, "->");
+    render_printf(13, 26, "NEW GAME");
     if(isSave) {
-        mvprintw(15, 26, "CONTINUE");
-        mvprintw(17, 26, "2-PLAYER");
-        mvprintw(19, 26, "OPTIONS");
-        mvprintw(21, 26, "CONTROLS");
+        render_printf(15, 26, "CONTINUE");
+        render_printf(17, 26, "2-PLAYER");
+        render_printf(19, 26, "OPTIONS");
+        render_printf(21, 26, "CONTROLS");
     } else {
-        mvprintw(15, 26, "2-PLAYER");
-        mvprintw(17, 26, "OPTIONS");
-        mvprintw(19, 26, "CONTROLS");
+        render_printf(15, 26, "2-PLAYER");
+        render_printf(17, 26, "OPTIONS");
+        render_printf(19, 26, "CONTROLS");
     }
     
     
 }
 
 void drawControls() {
-    mvprintw(5,5, "Tab..............Rotate block");
-    mvprintw(6,5, "Down.............Drop block faster");
-    mvprintw(7,5, "Left/Right.......Move left and Right");
-    mvprintw(8,5, "Space............Hold block");
-    mvprintw(9,5, "S................Save game");
-    mvprintw(10,5, "P................Pause game");
-    mvprintw(11,5, "Z................Save and quit game");
-    mvprintw(12,5, "ESC..............Go back to title screen");
+    render_printf(5,5, "Tab..............Rotate block");
+    render_printf(6,5, "Down.............Drop block faster");
+    render_printf(7,5, "Left/Right.......Move left and Right");
+    render_printf(8,5, "Space............Hold block");
+    render_printf(9,5, "S................Save game");
+    render_printf(10,5, "P................Pause game");
+    render_printf(11,5, "Z................Save and quit game");
+    render_printf(12,5, "I................Show frame timings");
+    render_printf(13,5, "ESC..............Go back to title screen");
 }
 
 void drawOptions(int level) {
-    mvprintw(13, ARROW_X, "->");
-    mvprintw(13, 26, "Level: %2d", level);
-    mvprintw(15, 22, "(ESC to go back)");
+    render_printf(13, ARROW_X, "->");
+    render_printf(13, 26, "Level: %2d", level);
+    render_printf(15, 22, "(ESC to go back)");
 }
 
 int hostOrClient() {
-    mvprintw(13, ARROW_X, "->");
-    mvprintw(13, 26, "HOST");
-    mvprintw(15, 26, "JOIN");
-    mvprintw(17, 22, "(ESC to go back)");
+    render_printf(13, ARROW_X, "->");
+    render_printf(13, 26, "HOST");
+    render_printf(15, 26, "JOIN");
+    render_printf(17, 26, "HOST (ROLLBACK)");
+    render_printf(19, 26, "JOIN (ROLLBACK)");
+    render_printf(21, 26, "WATCH");
+    render_printf(23, 26, "LOCAL");
+    render_printf(25, 22, "(ESC to go back)");
     int option = 0;
     bool select_flg = false;
     int arrow_pos = 13;
     while(!select_flg) {
-        switch(wgetch(stdscr)) {
+        switch(render_getch()) {
             case KEY_UP:
                 if(option != 0) {
                     option--;
-                    mvprintw(arrow_pos, ARROW_X, "  ");
+                    render_printf(arrow_pos, ARROW_X, "  ");
                     arrow_pos -= 2;
-                    mvprintw(arrow_pos, ARROW_X, "->");
+                    render_printf(arrow_pos, ARROW_X, "->");
                 }
                 break;
             case KEY_DOWN:
-                if(option != 1) {
+                if(option != 5) {
                     option++;
-                    mvprintw(arrow_pos, ARROW_X, "  ");
+                    render_printf(arrow_pos, ARROW_X, "  ");
                     arrow_pos += 2;
-                    mvprintw(arrow_pos, ARROW_X, "->");
+                    render_printf(arrow_pos, ARROW_X, "->");
                 }
                 break;
             case '\n':
                 select_flg = TRUE;
                 break;
             case ESC_KEY:
-                option = 2;
+                option = 6;
             default:
                 break;
         }
     }
-    clear();
+    render_clear();
     return option;
 }
 
+// Asks how many play on this keyboard, 0 on ESC.
+int getPlayers() {
+    int players = 2;
+    render_printf(13, 26, "Players: %d", players);
+    render_printf(15, 22, "(LEFT/RIGHT, ENTER)");
+    while(true) {
+        switch(render_getch()) {
+            case KEY_LEFT:
+                if(players != 2) {
+                    players--;
+                }
+                break;
+            case KEY_RIGHT:
+                if(players != LOCAL_MAX_PLAYERS) {
+                    players++;
+                }
+                break;
+            case '\n':
+                render_clear();
+                return players;
+            case ESC_KEY:
+                render_clear();
+                return 0;
+            default:
+                break;
+        }
+        render_printf(13, 26, "Players: %d", players);
+    }
+}
+
 void getPort(char *port) {
     char port_str[6];
-    mvprintw(13, 26,  "Enter Port:");
+    render_printf(13, 26,  "Enter Port:");
     bool select_flg = false;
     int pos = 0;
     while(!select_flg) {
-        char c = wgetch(stdscr);
+        char c = render_getch();
         if(pos == 6) {
             select_flg = true;
         }
@@ -823,20 +1076,20 @@ void getPort(char *port) {
             return;
         }
         port_str[pos] = '\0';
-        mvprintw(15, 26, "         ");
-        mvprintw(15, 26, port_str);
+        render_printf(15, 26, "         ");
+        render_printf(15, 26, port_str);
     }
     strcpy(port, port_str);
 }
 
 void getIpAddr2(char *ip) {
-    mvprintw(13, 26, "ENTER HOST IP ADDRESS:");
-    mvprintw(17, 26, "(ENTER TO PROCEED)");
+    render_printf(13, 26, "ENTER HOST IP ADDRESS:");
+    render_printf(17, 26, "(ENTER TO PROCEED)");
     char ip_str[40];
     bool select_flg = false;
     int pos = 0;
     while(!select_flg) {
-        char c = wgetch(stdscr);
+        char c = render_getch();
         if(pos == 30) {
             select_flg = true;
         }
@@ -856,8 +1109,8 @@ void getIpAddr2(char *ip) {
             return;
         }
         ip_str[pos] = '\0';
-        mvprintw(15, 26, "                                  ");
-        mvprintw(15, 26, ip_str);
+        render_printf(15, 26, "                                  ");
+        render_printf(15, 26, ip_str);
     }
     strcpy(ip, ip_str);
 }
@@ -964,8 +1217,11 @@ tetrimo newBlock(Color c, Color *next_tetrimo, int offset) {
 }
 
 void eraseNext(Color c, int offset) {
+    if(headless) {
+        return;
+    }
     for(int i = 2; i < 6; i++) {
-        mvprintw(i, 39+offset, "             ");
+        render_printf(i, 39+offset, "             ");
     }
 }
 
@@ -1054,28 +1310,28 @@ void drawHeld(Color c, int offset) {
 }
 
 void drawBoard(int score, int level, int offset) {
-    //clear();
+    //render_clear();
     int i;
     for(i = 0; i < MATRIX_LENGTH - 1; i++) {
-        mvprintw(i, 5+offset, MATRIX);
+        render_printf(i, 5+offset, MATRIX);
     }
-    mvprintw(i, 5+offset, MATRIX_BOTTOM);
+    render_printf(i, 5+offset, MATRIX_BOTTOM);
     drawScoreLevel(score, level, offset);
     if(!offset) {
-        mvprintw(0,38+offset, "Next:");
-        mvprintw(1,39+offset, "_____________");
+        render_printf(0,38+offset, "Next:");
+        render_printf(1,39+offset, "_____________");
         for(int i = 2; i < 7; i++) {
-            mvprintw(i,38+offset,"|");
-            mvprintw(i,52+offset,"|");
+            render_printf(i,38+offset,"|");
+            render_printf(i,52+offset,"|");
         }
-        mvprintw(6,39+offset, "_____________");
-        mvprintw(11,39+offset, "_____________");
+        render_printf(6,39+offset, "_____________");
+        render_printf(11,39+offset, "_____________");
         for(int i = 12; i < 17; i++) {
-            mvprintw(i,38+offset,"|");
-            mvprintw(i,52+offset,"|");
+            render_printf(i,38+offset,"|");
+            render_printf(i,52+offset,"|");
         }
-        mvprintw(16,39+offset, "_____________");
-        mvprintw(10,38+offset, "Hold:");
+        render_printf(16,39+offset, "_____________");
+        render_printf(10,38+offset, "Hold:");
     }
 }
 
@@ -1114,8 +1370,12 @@ void save(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color current_color, int d
 }
 
 void load(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *current_color, int *delay, int *speedcnt, int *level, int *score, Color *next_tetrimo, bool *heldExists, bool *heldLast, Color *held_tetrimo) {
+    loadFile("savefiles/save.txt", matrix, current_color, delay, speedcnt, level, score, next_tetrimo, heldExists, heldLast, held_tetrimo);
+}
+
+void loadFile(const char *path, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *current_color, int *delay, int *speedcnt, int *level, int *score, Color *next_tetrimo, bool *heldExists, bool *heldLast, Color *held_tetrimo) {
     FILE *loadfp;
-    if(!(loadfp = fopen("savefiles/save.txt", "r+"))) {
+    if(!(loadfp = fopen(path, "r+"))) {
         FILE *err;
         fopen("data/err.txt", "w+");
         fputs("Unable to open file save.txt", err);
@@ -1546,12 +1806,13 @@ void replaceLines(int first, int last, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH
 }
 
 void drawScoreLevel(int score, int level, int offset) {
-    mvprintw(26,21+offset, "     ");
-    mvprintw(26,16+offset,"Score: %5d", score);
-    mvprintw(27,21+offset, "     ");
-    mvprintw(27,16+offset,"Level:    %02d", level);
+    render_printf(26,21+offset, "     ");
+    render_printf(26,16+offset,"Score: %5d", score);
+    render_printf(27,21+offset, "     ");
+    render_printf(27,16+offset,"Level:    %02d", level);
 }
-void updateScoreLevel(int mult, int *score, int *level, int *speedcnt, int *delay) {
+// returns true if the level went up
+bool addScore(int mult, int *score, int *level, int *speedcnt, int *delay) {
     (*score) += (100 * mult);
     (*speedcnt) += (100 * mult);
     if((*speedcnt) >= 1000) {
@@ -1560,9 +1821,16 @@ void updateScoreLevel(int mult, int *score, int *level, int *speedcnt, int *dela
         } else {
             (*delay) -= 100;
         }
-        timeout(*delay);
         (*speedcnt) = 0;
         (*level)++;
+        return true;
+    }
+    return false;
+}
+
+void updateScoreLevel(int mult, int *score, int *level, int *speedcnt, int *delay) {
+    if(addScore(mult, score, level, speedcnt, delay)) {
+        timeout(*delay);
     }
     drawScoreLevel(*score, *level, 0);
 }
@@ -1637,8 +1905,8 @@ bool shift(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]
 }
 
 void drawGameOver() {
-    clear();
-    mvprintw(15,15,"GAME OVER");
+    render_clear();
+    render_printf(15,15,"GAME OVER");
 }
 
 // returns false if checkDown
@@ -1649,7 +1917,7 @@ bool update(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH
             (*t).next_xy[i].x = (*t).current_xy[i].x;
             (*t).next_xy[i].y = (*t).current_xy[i].y;
             if((*t).current_xy[i].y==0) {
-                (gameOver) = TRUE;
+                *topOut = TRUE;
             }
         }
         return false;
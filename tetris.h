@@ -0,0 +1,130 @@
+#ifndef TETRIS_H_
+#define TETRIS_H_
+
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "netstats.h"
+#include "impair.h"
+#include "render.h"
+
+#define BLOCK "[ ]"
+#define paint(y, x) if(!headless) { render_put(y, x, BLOCK); }
+#define whiteout(y, x) if(!headless) { render_put(y, x, "   "); }
+#define log(x) fputs(x, err);
+#define blocktomatrix(x) (x*3)+7
+#define blocktomatrix2(x) (x*3)+62
+#define matrixtoblock(x) (x-7)/3
+#define MATRIX "|                             |"
+#define MATRIX_BOTTOM "|_____________________________|"
+#define MATRIX_LENGTH 26
+#define MATRIX_WIDTH 9
+#define ESC_KEY 27
+#define INITIAL_DELAY 1000
+#define PAUSE_POLL_MS 250
+#define ARROW_X 23
+
+typedef enum {LEFT, RIGHT, UP, DOWN} Orientation; 
+typedef enum {RED, GREEN, CYAN, BLUE, YELLOW, PURPLE, ORANGE, RANDOM} Color;
+typedef enum {NEXT, HOLD} Display;
+
+typedef struct block_coords {
+    int x;
+    int y;
+} block_coords;
+
+typedef struct tetrimo {
+    block_coords current_xy[4];
+    block_coords next_xy[4];
+    Color color;
+    Orientation current_orientation;
+    void (*toggle)(struct tetrimo*, bool[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+} tetrimo;
+
+void initMatrix(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void drawBoard(int score, int level, int offset);
+void draw(tetrimo t);
+void elim(tetrimo t);
+void drawRed(Display d, int offset);
+void eraseRed(Display d, int offset);
+void drawGreen(Display d, int offset);
+void eraseGreen(Display d, int offset);
+void drawCyan(Display d, int offset);
+void eraseCyan(Display d, int offset);
+void drawBlue(Display d, int offset);
+void eraseBlue(Display d, int offset);
+void drawYellow(Display d, int offset);
+void eraseYellow(Display d, int offset);
+void drawPurple(Display d, int offset);
+void erasePurple(Display d, int offset);
+void drawOrange(Display d, int offset);
+void eraseOrange(Display d, int offset);
+bool shift(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+bool addScore(int mult, int *score, int *level, int *speedcnt, int *delay);
+void updateScoreLevel(int mult, int *score, int *level, int *speedcnt, int *delay);
+bool update(Orientation o, tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleRed(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleGreen(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleCyan(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleBlue(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleYellow(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void togglePurple(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void toggleOrange(struct tetrimo *t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void eraseNext(Color c, int offset);
+void drawNext(Color c, int offset);
+tetrimo newBlock(Color c, Color *next_tetrimo, int offset);
+int checkLine(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void save(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color current_color, int delay, int speedcnt, int level, int score, Color next_tetrimo, bool heldExists, bool heldLast, Color held_tetrimo);
+void loadFile(const char *path, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *current_color, int *delay, int *speedcnt, int *level, int *score, Color *next_tetrimo, bool *heldExists, bool *heldLast, Color *held_tetrimo);
+void load(bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH], Color *current_color, int *delay, int *speedcnt, int *level, int *score, Color *next_tetrimo, bool *heldExists, bool *heldLast, Color *held_tetrimo);
+void drawHeld(Color c, int offset);
+void eraseHeld(Color c, int offset);
+void drawTitle(bool isSave);
+void drawOptions(int level);
+void drawControls();
+void drawScoreLevel(int score, int level, int offset);
+void drawGameOver();
+bool checkDown(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+bool checkLeft(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+bool checkRight(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void hitMatrix(int x, int y, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void eraseLine(int y, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void replaceLines(int first, int last, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void updateMatrix(tetrimo t, bool matrix[MATRIX_LENGTH-1][MATRIX_WIDTH]);
+void *play(void *id);
+void *server(void *port);
+void *client(void *con);
+void getIpAddr2(char *ip);
+void getPort(char *port);
+int hostOrClient();
+int getPlayers();
+void drawSecondPlayer(char *second, NetStats *ns);
+void encodeState(char *send, bool over);
+void submitScore(int mode, int score, int level, uint32_t pieces, const char *player);
+void recordScore(int game);
+void closeScores();
+void publishState();
+void waitState(unsigned long *seen, uint64_t ns);
+extern _Thread_local bool headless;
+extern int netRate;
+extern int dasMs;
+extern int arrMs;
+extern bool udpTransport;
+extern ImpairConfig impairment;
+extern bool gameOver;
+extern _Thread_local bool *topOut;
+extern int level;
+extern int score;
+extern int speedcnt;
+extern int delay;
+extern tetrimo currentTetrimo;
+extern bool matrix_g[MATRIX_LENGTH-1][MATRIX_WIDTH];
+extern pthread_mutex_t mutex;
+extern pthread_cond_t stateChanged;
+extern unsigned long stateVersion;
+extern bool waitingForPeer;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+
+// Monotonic clock in nanoseconds, used for benchmarks and frame timing.
+uint64_t timer_now_ns();
+
+// CPU time used by the calling thread in nanoseconds.
+uint64_t timer_thread_cpu_ns();
+
+#endif
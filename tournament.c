@@ -0,0 +1,426 @@
+#include <sys/stat.h>
+
+#include "tournament.h"
+#include "bot.h"
+#include "timer.h"
+
+// encodeState() for a GameSim instead of the globals.
+static void encodeSim(char *send, const GameSim *g, bool over) {
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        for(int j = 0; j < MATRIX_WIDTH; j++) {
+            send[FRAME_BOARD + (i*9)+j] = g->matrix[i][j] ? '1' : '0';
+        }
+    }
+    if(!g->over && g->t.current_xy[0].x != 0) {
+        for(int i = 0; i < 4; i++) {
+            send[FRAME_BOARD + (g->t.current_xy[i].y*9)+matrixtoblock(g->t.current_xy[i].x)] = '1';
+        }
+    }
+    char field[12];
+    snprintf(field, sizeof(field), "%02d", g->level % 100);
+    memcpy(send + FRAME_LEVEL, field, 2);
+    snprintf(field, sizeof(field), "%5d", g->score % 100000);
+    memcpy(send + FRAME_SCORE, field, 5);
+    send[FRAME_OVER] = over ? '1' : '0';
+    memset(send + FRAME_SEQ, '0', FRAME_LEN - 1 - FRAME_SEQ);
+    send[FRAME_LEN - 1] = '\0';
+}
+
+static bool done(const Match *m, const GameSim *g) {
+    return g->over || g->pieces >= m->maxPieces;
+}
+
+static void playPiece(const Match *m, GameSim *g) {
+    BotMove move;
+    if(done(m, g)) {
+        return;
+    }
+    if(bot_choose(g, &bot_default_weights, &move)) {
+        g->over = true;
+        return;
+    }
+    sim_place(g, move.rotations, move.column);
+}
+
+// server() with a bot instead of play(): accept, read the guest's frame,
+// answer with ours, then place a piece. Unlike server() every exchange's
+// socket is closed once answered.
+static void *hostSide(void *arg) {
+    Match *m = (Match *)arg;
+    MatchSide *s = &m->host;
+    uint64_t cpu = timer_thread_cpu_ns();
+    SOCKET l;
+    SOCKET c = INVALID_SOCKET;
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
+    netstats_init(&s->ns);
+    int err = tcp_server_create(&l, m->port);
+    pthread_mutex_lock(&m->lock);
+    m->listen = l;
+    m->listening = err ? -1 : 1;
+    pthread_cond_broadcast(&m->ready);
+    pthread_mutex_unlock(&m->lock);
+    if(err) {
+        netstats_error(&s->ns);
+        s->cpuNs = timer_thread_cpu_ns() - cpu;
+        return NULL;
+    }
+    bool over = false;
+    int errors = 0;
+    while(!over && errors < TOURNAMENT_MAX_ERRORS) {
+        if(tcp_server_accept_connection(&l, &c)) {
+            // the listening socket is gone with it
+            netstats_error(&s->ns);
+            s->cpuNs = timer_thread_cpu_ns() - cpu;
+            return NULL;
+        }
+        memset(receive, 0, sizeof(receive));
+        if(tcp_server_receive_request(&c, receive)) {
+            netstats_error(&s->ns);
+            errors++;
+            continue;
+        }
+        netstats_receive(&s->ns, receive);
+        over = done(m, &s->g);
+        encodeSim(send, &s->g, over);
+        if(receive[FRAME_OVER] == '1') {
+            over = true;
+        }
+        netstats_stamp(&s->ns, send);
+        if(tcp_server_send_response(&c, send)) {
+            netstats_error(&s->ns);
+            errors++;
+            continue;
+        }
+        errors = 0;
+        if(!over) {
+            closesocket(c);
+            playPiece(m, &s->g);
+        }
+    }
+    s->finished = over;
+    if(over) {
+        tcp_server_close(c, l);
+    } else {
+        closesocket(l);
+        WSACleanup();
+    }
+    s->cpuNs = timer_thread_cpu_ns() - cpu;
+    return NULL;
+}
+
+// client() with a bot: a new connection per exchange, send our frame, read
+// the host's, then place a piece.
+static void *guestSide(void *arg) {
+    Match *m = (Match *)arg;
+    MatchSide *s = &m->guest;
+    uint64_t cpu = timer_thread_cpu_ns();
+    SOCKET c;
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
+    Config config = {m->port, "127.0.0.1"};
+    netstats_init(&s->ns);
+    pthread_mutex_lock(&m->lock);
+    while(m->listening == 0) {
+        pthread_cond_wait(&m->ready, &m->lock);
+    }
+    bool listening = m->listening > 0;
+    pthread_mutex_unlock(&m->lock);
+    bool over = !listening;
+    int errors = 0;
+    while(!over && errors < TOURNAMENT_MAX_ERRORS) {
+        over = done(m, &s->g);
+        encodeSim(send, &s->g, over);
+        memset(receive, 0, sizeof(receive));
+        if(tcp_client_connect(config, &c)) {
+            netstats_error(&s->ns);
+            errors++;
+            over = false;
+            continue;
+        }
+        netstats_stamp(&s->ns, send);
+        if(tcp_client_send_request(&c, send) || tcp_client_receive_response(&c, receive)) {
+            netstats_error(&s->ns);
+            errors++;
+            over = false;
+            continue;
+        }
+        tcp_client_close(c);
+        netstats_receive(&s->ns, receive);
+        errors = 0;
+        if(receive[FRAME_OVER] == '1') {
+            over = true;
+        }
+        if(!over) {
+            playPiece(m, &s->g);
+        }
+    }
+    s->finished = over && listening;
+    s->cpuNs = timer_thread_cpu_ns() - cpu;
+    return NULL;
+}
+
+// Next frame from the other side, 1 once it has one and -1 if the other
+// side is gone.
+static int receiveFrame(Transport *net, char *frame) {
+    int r;
+    while((r = transport_recv(net, (unsigned char *)frame)) == 0) {
+        transport_wait(net, TOURNAMENT_WAIT_MS);
+    }
+    return r;
+}
+
+// hostSide() over one Transport for the whole match: wait for the guest's
+// frame, answer with ours, then place a piece.
+static void *hostTransport(void *arg) {
+    Match *m = (Match *)arg;
+    MatchSide *s = &m->host;
+    uint64_t cpu = timer_thread_cpu_ns();
+    Transport net;
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
+    netstats_init(&s->ns);
+    int err = transport_listen(&net, m->port, FRAME_LEN);
+    pthread_mutex_lock(&m->lock);
+    m->listen = err ? INVALID_SOCKET : net.listener;
+    m->listening = err ? -1 : 1;
+    pthread_cond_broadcast(&m->ready);
+    pthread_mutex_unlock(&m->lock);
+    if(err || transport_accept(&net)) {
+        netstats_error(&s->ns);
+        s->cpuNs = timer_thread_cpu_ns() - cpu;
+        return NULL;
+    }
+    m->via = net.name;
+    bool over = false;
+    while(!over) {
+        if(receiveFrame(&net, receive) < 0) {
+            netstats_error(&s->ns);
+            break;
+        }
+        netstats_receive(&s->ns, receive);
+        over = done(m, &s->g);
+        encodeSim(send, &s->g, over);
+        if(receive[FRAME_OVER] == '1') {
+            over = true;
+        }
+        netstats_stamp(&s->ns, send);
+        if(transport_send(&net, (unsigned char *)send)) {
+            netstats_error(&s->ns);
+            over = false;
+            break;
+        }
+        if(!over) {
+            playPiece(m, &s->g);
+        }
+    }
+    s->finished = over;
+    transport_close(&net);
+    s->cpuNs = timer_thread_cpu_ns() - cpu;
+    return NULL;
+}
+
+// guestSide() over one Transport: send our frame, wait for the host's, then
+// place a piece.
+static void *guestTransport(void *arg) {
+    Match *m = (Match *)arg;
+    MatchSide *s = &m->guest;
+    uint64_t cpu = timer_thread_cpu_ns();
+    Transport net;
+    char receive[FRAME_LEN];
+    char send[FRAME_LEN];
+    Config config = {m->port, "127.0.0.1"};
+    netstats_init(&s->ns);
+    pthread_mutex_lock(&m->lock);
+    while(m->listening == 0) {
+        pthread_cond_wait(&m->ready, &m->lock);
+    }
+    bool listening = m->listening > 0;
+    pthread_mutex_unlock(&m->lock);
+    if(listening && transport_join(&net, config, FRAME_LEN) == 0) {
+        m->joined = true;
+    } else {
+        netstats_error(&s->ns);
+    }
+    bool over = !m->joined;
+    while(!over) {
+        over = done(m, &s->g);
+        encodeSim(send, &s->g, over);
+        netstats_stamp(&s->ns, send);
+        if(transport_send(&net, (unsigned char *)send) || receiveFrame(&net, receive) < 0) {
+            netstats_error(&s->ns);
+            over = false;
+            break;
+        }
+        netstats_receive(&s->ns, receive);
+        if(receive[FRAME_OVER] == '1') {
+            over = true;
+        }
+        if(!over) {
+            playPiece(m, &s->g);
+        }
+    }
+    s->finished = over;
+    if(m->joined) {
+        transport_close(&net);
+    }
+    s->cpuNs = timer_thread_cpu_ns() - cpu;
+    return NULL;
+}
+
+// Plays match id to the end, both sides on their own thread like the two
+// machines of a real game.
+static void playMatch(Tournament *t, Match *m, int id) {
+    memset(m, 0, sizeof(*m));
+    m->id = id;
+    snprintf(m->port, sizeof(m->port), "%d", t->basePort + id);
+    m->seed = 1000u + id;
+    m->maxPieces = t->maxPieces;
+    m->transport = t->transport;
+    m->via = "tcp";
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->ready, NULL);
+    // different piece sequences, the same for every run of the tournament,
+    // swapped every other match so neither seat gets the better one
+    unsigned int other = m->seed + 500000u;
+    sim_init(&m->host.g, id % 2 ? other : m->seed, 1);
+    sim_init(&m->guest.g, id % 2 ? m->seed : other, 1);
+
+    pthread_t host;
+    pthread_t guest;
+    m->start = timer_now_ns();
+    pthread_create(&host, NULL, m->transport ? hostTransport : hostSide, m);
+    pthread_create(&guest, NULL, m->transport ? guestTransport : guestSide, m);
+    pthread_join(guest, NULL);
+    if(!m->guest.finished && m->listening > 0 && !m->joined) {
+        // the host would wait in accept for good
+        shutdown(m->listen, SD_BOTH);
+    }
+    pthread_join(host, NULL);
+    m->end = timer_now_ns();
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->ready);
+}
+
+// 1 host, 2 guest, 0 draw. Topping out loses, otherwise the higher score wins.
+static int winner(const Match *m) {
+    const GameSim *h = &m->host.g;
+    const GameSim *g = &m->guest.g;
+    if(h->over != g->over) {
+        return h->over ? 2 : 1;
+    }
+    return h->score > g->score ? 1 : h->score < g->score ? 2 : 0;
+}
+
+static void addMatch(Tournament *t, Match *m) {
+    const char *names[] = {"draw", "host", "guest"};
+    bool finished = m->host.finished && m->guest.finished;
+    int w = winner(m);
+    uint64_t messages = m->host.ns.frames + m->guest.ns.frames;
+    uint64_t cpu = m->host.cpuNs + m->guest.cpuNs;
+    pthread_mutex_lock(&t->lock);
+    if(finished) {
+        t->finished++;
+        t->hostWins += w == 1;
+        t->guestWins += w == 2;
+    } else {
+        t->abandoned++;
+    }
+    t->messages += messages;
+    t->bytes += m->host.ns.bytesSent + m->host.ns.bytesReceived + m->guest.ns.bytesSent + m->guest.ns.bytesReceived;
+    t->errors += m->host.ns.errors + m->guest.ns.errors;
+    t->badFrames += m->host.ns.badFrames + m->guest.ns.badFrames;
+    t->cpuNs += cpu;
+    t->matchNs += m->end - m->start;
+    histogram_merge(&t->rtt, &m->guest.ns.rtt);
+    printf("match %4d port %s %s: %5d vs %5d %-9s %4u pieces %6llu msgs %7.2fs cpu %7.1fms\n", m->id, m->port, m->via,
+           m->host.g.score, m->guest.g.score, finished ? names[w] : "abandoned",
+           m->host.g.pieces + m->guest.g.pieces, (unsigned long long)messages, (m->end - m->start) / 1e9, cpu / 1e6);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void *runner(void *arg) {
+    Tournament *t = (Tournament *)arg;
+    // a NetStats histogram each side, too big to keep on the stack
+    Match *m = malloc(sizeof(Match));
+    if(m == NULL) {
+        return NULL;
+    }
+    for(;;) {
+        pthread_mutex_lock(&t->lock);
+        int id = t->next < t->matches ? t->next++ : -1;
+        pthread_mutex_unlock(&t->lock);
+        if(id < 0) {
+            break;
+        }
+        playMatch(t, m, id);
+        addMatch(t, m);
+    }
+    free(m);
+    return NULL;
+}
+
+static void report(FILE *fp, Tournament *t, int parallel, double secs) {
+    uint64_t played = t->finished + t->abandoned;
+    fprintf(fp, "%d matches (%d finished, %d abandoned) %d at a time in %.2fs\n", (int)played, t->finished,
+            t->abandoned, parallel, secs);
+    fprintf(fp, "host wins %d guest wins %d draws %d\n", t->hostWins, t->guestWins,
+            t->finished - t->hostWins - t->guestWins);
+    fprintf(fp, "games/hour %.0f\n", secs > 0 ? t->finished * 3600.0 / secs : 0.0);
+    fprintf(fp, "messages %llu (%.0f/s) bytes %llu (%.0f/s) errors %llu bad frames %llu\n",
+            (unsigned long long)t->messages, secs > 0 ? t->messages / secs : 0.0,
+            (unsigned long long)t->bytes, secs > 0 ? t->bytes / secs : 0.0,
+            (unsigned long long)t->errors, (unsigned long long)t->badFrames);
+    fprintf(fp, "cpu per match %.1fms (%.0f%% of its wall time), per message %.1fus\n",
+            played ? t->cpuNs / 1e6 / played : 0.0, t->matchNs ? 100.0 * t->cpuNs / t->matchNs : 0.0,
+            t->messages ? t->cpuNs / 1e3 / t->messages : 0.0);
+    fprintf(fp, "rtt us p50 %.1f p99 %.1f max %.1f\n", histogram_percentile(&t->rtt, 50) / 1e3,
+            histogram_percentile(&t->rtt, 99) / 1e3, t->rtt.total ? t->rtt.max / 1e3 : 0.0);
+}
+
+int tournament_main(int argc, char *argv[]) {
+    int matches = argc > 1 ? atoi(argv[1]) : 16;
+    int parallel = argc > 2 ? atoi(argv[2]) : 4;
+    int port = argc > 3 ? atoi(argv[3]) : TOURNAMENT_DEFAULT_PORT;
+    uint32_t maxPieces = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 10) : 500;
+    bool transport = argc > 5 && strcmp(argv[5], "shm") == 0;
+    if(matches < 1 || parallel < 1 || parallel > TOURNAMENT_MAX_PARALLEL || port < 1 || port + matches > 65535
+       || maxPieces < 1) {
+        fprintf(stderr, "usage: tournament [matches] [parallel 1-%d] [port] [maxpieces] [shm]\n", TOURNAMENT_MAX_PARALLEL);
+        return EXIT_FAILURE;
+    }
+    // the engine draws unless told not to, the tcp calls log to data/
+    headless = true;
+    mkdir("data");
+
+    static Tournament t;
+    memset(&t, 0, sizeof(t));
+    pthread_mutex_init(&t.lock, NULL);
+    histogram_reset(&t.rtt);
+    t.matches = matches;
+    t.basePort = port;
+    t.maxPieces = maxPieces;
+    t.transport = transport;
+    if(parallel > matches) {
+        parallel = matches;
+    }
+
+    pthread_t ids[TOURNAMENT_MAX_PARALLEL];
+    uint64_t start = timer_now_ns();
+    for(int i = 0; i < parallel; i++) {
+        pthread_create(&ids[i], NULL, runner, &t);
+    }
+    for(int i = 0; i < parallel; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double secs = (timer_now_ns() - start) / 1e9;
+    report(stdout, &t, parallel, secs);
+    FILE *fp = fopen(TOURNAMENT_STATS_FILE, "w+");
+    if(fp) {
+        report(fp, &t, parallel, secs);
+        histogram_dump(&t.rtt, "rtt_ns", fp);
+        fclose(fp);
+    }
+    pthread_mutex_destroy(&t.lock);
+    return t.abandoned ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#ifndef TOURNAMENT_H_
+#define TOURNAMENT_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tcp_client.h"
+#include "tcp_server.h"
+#include "histogram.h"
+#include "netstats.h"
+#include "sim.h"
+#include "transport.h"
+
+#define TOURNAMENT_DEFAULT_PORT 9100     // match n listens on this + n
+#define TOURNAMENT_MAX_PARALLEL 64
+#define TOURNAMENT_MAX_ERRORS 50         // failed exchanges in a row before a match is abandoned
+#define TOURNAMENT_STATS_FILE "data/tournament_stats.txt"
+#define TOURNAMENT_WAIT_MS 100          // a side checks the other is still there this often
+
+// One player of a match, the bot places a piece per exchange.
+typedef struct MatchSide {
+    GameSim g;
+    NetStats ns;
+    uint64_t cpuNs;                      // CPU time of the side's thread
+    bool finished;                       // played until one side was over, not abandoned
+} MatchSide;
+
+// A 2-Player game between two bots over the same tcp_server/tcp_client calls
+// as server() and client(), the guest connecting to the host on loopback.
+// With transport set the two keep one Transport for the whole match instead,
+// which on this host is shared memory.
+typedef struct Match {
+    int id;
+    char port[12];
+    unsigned int seed;
+    uint32_t maxPieces;                  // both sides stop here and the higher score wins
+    bool transport;
+    const char *via;                     // what the frames went over
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int listening;                       // 1 once the host listens, -1 if it couldn't
+    SOCKET listen;                       // host's, shut down to wake it if the guest gives up
+    bool joined;                         // the guest has a transport, the host no longer listens
+    MatchSide host;
+    MatchSide guest;
+    uint64_t start;
+    uint64_t end;
+} Match;
+
+// Shared by the runner threads, each plays matches one after another and adds
+// them to the totals.
+typedef struct Tournament {
+    pthread_mutex_t lock;
+    int next;                            // next match to start
+    int matches;
+    int basePort;
+    uint32_t maxPieces;
+    bool transport;                      // a Transport per match, not a connection per exchange
+    int finished;
+    int abandoned;
+    int hostWins;
+    int guestWins;
+    uint64_t messages;                   // valid frames received by either side
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t badFrames;
+    uint64_t cpuNs;
+    uint64_t matchNs;                    // sum of match durations
+    Histogram rtt;                       // measured by the guests, the side that waits on the reply
+} Tournament;
+
+// Command line entry: tournament [matches] [parallel] [port] [maxpieces] [shm]
+int tournament_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__) || defined(_WIN32)
+#define SHM_RING
+#include <stdatomic.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#include "transport.h"
+#include "timer.h"
+
+static bool readable(SOCKET sock, int ms) {
+    fd_set fds;
+    struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    return select(sock + 1, &fds, NULL, NULL, &tv) > 0;
+}
+
+static bool sockWait(Transport *t, int ms) {
+    return readable(t->sock, ms);
+}
+
+static void init(Transport *t, const char *name, bool stream, int packetLen) {
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->stream = stream;
+    t->sock = INVALID_SOCKET;
+    t->listener = INVALID_SOCKET;
+    t->packetLen = packetLen;
+}
+
+static int tcpWrite(Transport *t, const unsigned char *p, int len) {
+    int done = 0;
+    while(done < len) {
+        int n = send(t->sock, (const char *)p + done, len - done, 0);
+        if(n <= 0) {
+            return 1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+static int tcpRead(Transport *t, unsigned char *p) {
+    while(readable(t->sock, 0)) {
+        int n = recv(t->sock, (char *)t->partial + t->partialLen, t->packetLen - t->partialLen, 0);
+        if(n <= 0) {
+            return -1;
+        }
+        t->partialLen += n;
+        if(t->partialLen == t->packetLen) {
+            memcpy(p, t->partial, t->packetLen);
+            t->partialLen = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void tcpCloseHost(Transport *t) {
+    tcp_server_close(t->sock, t->listener);
+}
+
+static void tcpCloseJoin(Transport *t) {
+    tcp_client_close(t->sock);
+}
+
+static void useTcp(Transport *t, void (*close)(Transport *t)) {
+    int one = 1;
+    setsockopt(t->sock, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(one));
+    t->write = tcpWrite;
+    t->read = tcpRead;
+    t->wait = sockWait;
+    t->close = close;
+}
+
+int transport_tcp_host(Transport *t, char *port, int packetLen) {
+    init(t, "tcp", true, packetLen);
+    if(tcp_server_create(&t->listener, port) || tcp_server_accept_connection(&t->listener, &t->sock)) {
+        return 1;
+    }
+    useTcp(t, tcpCloseHost);
+    return 0;
+}
+
+int transport_tcp_join(Transport *t, Config config, int packetLen) {
+    init(t, "tcp", true, packetLen);
+    if(tcp_client_connect(config, &t->sock)) {
+        return 1;
+    }
+    useTcp(t, tcpCloseJoin);
+    return 0;
+}
+
+// A lost datagram is just lost, errors are not a reason to give up.
+static int udpWrite(Transport *t, const unsigned char *p, int len) {
+    send(t->sock, (const char *)p, len, 0);
+    return 0;
+}
+
+static bool isHello(const char *buf, int n) {
+    return n == (int)strlen(TRANSPORT_HELLO) && memcmp(buf, TRANSPORT_HELLO, n) == 0;
+}
+
+static int udpRead(Transport *t, unsigned char *p) {
+    char buf[TRANSPORT_MAX_PACKET];
+    while(readable(t->sock, 0)) {
+        int n = recv(t->sock, buf, sizeof(buf), 0);
+        if(n < 0) {
+            // an ICMP error for something sent earlier
+            continue;
+        }
+        if(isHello(buf, n)) {
+            // the joiner missed the answer and is still asking
+            send(t->sock, TRANSPORT_HELLO, strlen(TRANSPORT_HELLO), 0);
+            t->ignored++;
+            continue;
+        }
+        if(n != t->packetLen) {
+            t->ignored++;
+            continue;
+        }
+        memcpy(p, buf, n);
+        return 1;
+    }
+    return 0;
+}
+
+static void udpClose(Transport *t) {
+    closesocket(t->sock);
+    WSACleanup();
+}
+
+static void useUdp(Transport *t) {
+    t->write = udpWrite;
+    t->read = udpRead;
+    t->wait = sockWait;
+    t->close = udpClose;
+}
+
+static SOCKET udpSocket(const char *host, char *port, struct addrinfo **res) {
+    struct addrinfo hints;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    hints.ai_flags = host == NULL ? AI_PASSIVE : 0;
+    if(getaddrinfo(host, port, &hints, res) != 0) {
+        return INVALID_SOCKET;
+    }
+    SOCKET sock = socket((*res)->ai_family, (*res)->ai_socktype, (*res)->ai_protocol);
+    if(sock == INVALID_SOCKET) {
+        freeaddrinfo(*res);
+    }
+    return sock;
+}
+
+int transport_udp_host(Transport *t, char *port, int packetLen) {
+    init(t, "udp", false, packetLen);
+    WSADATA wsaData;
+    if(WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
+        return 1;
+    }
+    struct addrinfo *res;
+    t->sock = udpSocket(NULL, port, &res);
+    if(t->sock == INVALID_SOCKET) {
+        WSACleanup();
+        return 1;
+    }
+    int err = bind(t->sock, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR;
+    freeaddrinfo(res);
+    // whoever says hello first is the other player
+    struct sockaddr_storage from;
+    socklen_t fromLen;
+    char buf[TRANSPORT_MAX_PACKET];
+    while(!err) {
+        fromLen = sizeof(from);
+        int n = recvfrom(t->sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromLen);
+        if(n < 0) {
+            err = 1;
+        } else if(isHello(buf, n)) {
+            break;
+        }
+    }
+    if(err || connect(t->sock, (struct sockaddr *)&from, fromLen) == SOCKET_ERROR) {
+        closesocket(t->sock);
+        WSACleanup();
+        return 1;
+    }
+    send(t->sock, TRANSPORT_HELLO, strlen(TRANSPORT_HELLO), 0);
+    useUdp(t);
+    return 0;
+}
+
+int transport_udp_join(Transport *t, Config config, int packetLen) {
+    init(t, "udp", false, packetLen);
+    WSADATA wsaData;
+    if(WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
+        return 1;
+    }
+    struct addrinfo *res;
+    t->sock = udpSocket(config.host, config.port, &res);
+    if(t->sock == INVALID_SOCKET) {
+        WSACleanup();
+        return 1;
+    }
+    int err = connect(t->sock, res->ai_addr, (int)res->ai_addrlen) == SOCKET_ERROR;
+    freeaddrinfo(res);
+    char buf[TRANSPORT_MAX_PACKET];
+    for(int i = 0; !err && i < TRANSPORT_HELLO_TRIES; i++) {
+        send(t->sock, TRANSPORT_HELLO, strlen(TRANSPORT_HELLO), 0);
+        if(!readable(t->sock, TRANSPORT_HELLO_WAIT_MS)) {
+            continue;
+        }
+        int n = recv(t->sock, buf, sizeof(buf), 0);
+        if(isHello(buf, n)) {
+            useUdp(t);
+            return 0;
+        }
+        if(n < 0) {
+            // nobody listening yet
+            usleep(TRANSPORT_HELLO_WAIT_MS * 1000);
+        }
+    }
+    closesocket(t->sock);
+    WSACleanup();
+    return 1;
+}
+
+#ifdef SHM_RING
+#define SHM_MAGIC 0x54524e47u
+
+enum {SHM_LISTENING = 1, SHM_JOINED, SHM_REFUSED};
+
+// what a side sleeps on: the host on state while listening, a reader on its
+// ring's head
+enum {SHM_WAKE_STATE, SHM_WAKE_RING, SHM_WAKES = SHM_WAKE_RING + 2};
+#define SHM_HANDLES (1 + SHM_WAKES)      // Windows: the mapping, then an event per wake
+
+// One direction, written by one side and read by the other. head and tail
+// only ever grow, so the ring is full when they are TRANSPORT_SHM_SLOTS
+// apart, and each sits on its own cache line.
+typedef struct ShmRing {
+    _Alignas(64) atomic_uint head;       // packets written, the reader sleeps on it
+    atomic_uint sleeping;                // set while the reader waits for head to move
+    _Alignas(64) atomic_uint tail;       // packets read
+    _Alignas(64) unsigned char slots[TRANSPORT_SHM_SLOTS][TRANSPORT_MAX_PACKET];
+} ShmRing;
+
+struct ShmRegion {
+    uint32_t magic;
+    int packetLen;
+    atomic_uint state;                   // the host sleeps on it while listening
+    atomic_uint closed[2];
+    ShmRing ring[2];                     // [0] host to joiner, [1] joiner to host
+};
+
+// On Linux a side sleeps on a futex on the word itself, on Windows on a
+// named event per word, as WaitOnAddress doesn't work across processes.
+static atomic_uint *wakeWord(Transport *t, int word) {
+    return word == SHM_WAKE_STATE ? &t->shm->state : &t->shm->ring[word - SHM_WAKE_RING].head;
+}
+
+#ifdef __linux__
+
+static long futex(atomic_uint *word, int op, unsigned int val, int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    return syscall(SYS_futex, word, op, val, op == FUTEX_WAIT ? &ts : NULL, NULL, 0);
+}
+
+// Sleeps up to ms unless the word has moved on from val.
+static void sleepOn(Transport *t, int word, unsigned int val, int ms) {
+    futex(wakeWord(t, word), FUTEX_WAIT, val, ms);
+}
+
+static void wake(Transport *t, int word) {
+    futex(wakeWord(t, word), FUTEX_WAKE, 1, 0);
+}
+
+// per user, so two people on one machine can host the same port number
+static void regionName(char *name, size_t len, const char *port) {
+    snprintf(name, len, "/tetris-%u-%s", (unsigned int)getuid(), port);
+}
+
+// Returns 1 if the region can't be created (or found).
+static int mapRegion(Transport *t, const char *name, bool create) {
+    int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if(fd < 0) {
+        return 1;
+    }
+    struct stat st;
+    if(create ? ftruncate(fd, sizeof(struct ShmRegion)) != 0
+              : fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct ShmRegion)) {
+        close(fd);
+        if(create) {
+            shm_unlink(name);
+        }
+        return 1;
+    }
+    void *p = mmap(NULL, sizeof(struct ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) {
+        if(create) {
+            shm_unlink(name);
+        }
+        return 1;
+    }
+    t->shm = (struct ShmRegion *)p;
+    return 0;
+}
+
+// Takes the name away from joiners still to come, the mapping stays.
+static void unlinkRegion(const char *name) {
+    shm_unlink(name);
+}
+
+static void unmapRegion(Transport *t) {
+    munmap(t->shm, sizeof(struct ShmRegion));
+    t->shm = NULL;
+}
+
+#else
+
+_Static_assert(SHM_HANDLES == sizeof(((Transport *)0)->shmHandles) / sizeof(void *), "shmHandles size");
+
+static void sleepOn(Transport *t, int word, unsigned int val, int ms) {
+    // a wake between the check and the wait leaves the event set
+    if(atomic_load(wakeWord(t, word)) == val) {
+        WaitForSingleObject(t->shmHandles[1 + word], ms);
+    }
+}
+
+static void wake(Transport *t, int word) {
+    SetEvent(t->shmHandles[1 + word]);
+}
+
+// in the login session's namespace, so two people on one machine can host
+// the same port number
+static void regionName(char *name, size_t len, const char *port) {
+    snprintf(name, len, "Local\\tetris-%s", port);
+}
+
+static void unmapRegion(Transport *t) {
+    if(t->shm != NULL) {
+        UnmapViewOfFile(t->shm);
+        t->shm = NULL;
+    }
+    for(int i = 0; i < SHM_HANDLES; i++) {
+        if(t->shmHandles[i] != NULL) {
+            CloseHandle(t->shmHandles[i]);
+            t->shmHandles[i] = NULL;
+        }
+    }
+}
+
+// The mapping and its events only live as long as somebody has them open,
+// so one by that name means the port is hosted already.
+static int mapRegion(Transport *t, const char *name, bool create) {
+    char event[sizeof(t->shmName) + 8];
+    if(create) {
+        t->shmHandles[0] = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                              sizeof(struct ShmRegion), name);
+        if(t->shmHandles[0] != NULL && GetLastError() == ERROR_ALREADY_EXISTS) {
+            unmapRegion(t);
+            return 1;
+        }
+    } else {
+        t->shmHandles[0] = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    }
+    if(t->shmHandles[0] == NULL) {
+        return 1;
+    }
+    for(int i = 1; i < SHM_HANDLES; i++) {
+        snprintf(event, sizeof(event), "%s-%d", name, i);
+        // auto reset, one wake lets one wait through
+        t->shmHandles[i] = create ? CreateEventA(NULL, FALSE, FALSE, event)
+                                  : OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, event);
+        if(t->shmHandles[i] == NULL) {
+            unmapRegion(t);
+            return 1;
+        }
+    }
+    t->shm = (struct ShmRegion *)MapViewOfFile(t->shmHandles[0], FILE_MAP_ALL_ACCESS, 0, 0,
+                                               sizeof(struct ShmRegion));
+    if(t->shm == NULL) {
+        unmapRegion(t);
+        return 1;
+    }
+    return 0;
+}
+
+static void unlinkRegion(const char *name) {
+    (void)name;
+}
+
+#endif
+
+static bool peerClosed(Transport *t) {
+    return atomic_load(&t->shm->closed[1 - t->shmSide]);
+}
+
+static int shmWrite(Transport *t, const unsigned char *p, int len) {
+    ShmRing *r = &t->shm->ring[t->shmSide];
+    unsigned int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for(int waited = 0; head - atomic_load_explicit(&r->tail, memory_order_acquire) == TRANSPORT_SHM_SLOTS; waited++) {
+        if(peerClosed(t) || waited == TRANSPORT_SHM_FULL_MS) {
+            return 1;
+        }
+        usleep(1000);
+    }
+    memcpy(r->slots[head % TRANSPORT_SHM_SLOTS], p, len);
+    atomic_store(&r->head, head + 1);
+    // only a sleeping reader costs a system call
+    if(atomic_load(&r->sleeping)) {
+        wake(t, SHM_WAKE_RING + t->shmSide);
+    }
+    return 0;
+}
+
+static int shmRead(Transport *t, unsigned char *p) {
+    ShmRing *r = &t->shm->ring[1 - t->shmSide];
+    // closed is read first, a side closes after its last write
+    bool closed = peerClosed(t);
+    unsigned int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if(atomic_load_explicit(&r->head, memory_order_acquire) == tail) {
+        return closed ? -1 : 0;
+    }
+    memcpy(p, r->slots[tail % TRANSPORT_SHM_SLOTS], t->packetLen);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static bool shmWait(Transport *t, int ms) {
+    ShmRing *r = &t->shm->ring[1 - t->shmSide];
+    unsigned int head = atomic_load(&r->head);
+    if(head != atomic_load(&r->tail) || peerClosed(t)) {
+        return true;
+    }
+    atomic_store(&r->sleeping, 1);
+    // returns at once if a write got in since head was read
+    sleepOn(t, SHM_WAKE_RING + 1 - t->shmSide, head, ms);
+    atomic_store(&r->sleeping, 0);
+    return atomic_load(&r->head) != atomic_load(&r->tail);
+}
+
+static void shmClose(Transport *t) {
+    atomic_store(&t->shm->closed[t->shmSide], 1);
+    wake(t, SHM_WAKE_RING + t->shmSide);
+    unmapRegion(t);
+}
+
+static void useShm(Transport *t, int side) {
+    t->name = "shm";
+    t->shmSide = side;
+    t->write = shmWrite;
+    t->read = shmRead;
+    t->wait = shmWait;
+    t->close = shmClose;
+}
+
+static bool isLocal(const char *host) {
+    return strcmp(host, "localhost") == 0 || strncmp(host, "127.", 4) == 0 || strcmp(host, "::1") == 0;
+}
+#endif
+
+int transport_listen(Transport *t, char *port, int packetLen) {
+    init(t, "tcp", true, packetLen);
+    if(tcp_server_create(&t->listener, port)) {
+        return 1;
+    }
+#ifdef SHM_RING
+    regionName(t->shmName, sizeof(t->shmName), port);
+    // the port is ours, so a region by that name was left by a host that died
+    unlinkRegion(t->shmName);
+    if(mapRegion(t, t->shmName, true) == 0) {
+        t->shm->magic = SHM_MAGIC;
+        t->shm->packetLen = packetLen;
+        atomic_store(&t->shm->state, SHM_LISTENING);
+    }
+#endif
+    return 0;
+}
+
+int transport_accept(Transport *t) {
+#ifdef SHM_RING
+    while(t->shm != NULL) {
+        sleepOn(t, SHM_WAKE_STATE, SHM_LISTENING, TRANSPORT_ACCEPT_POLL_MS);
+        unsigned int listening = SHM_LISTENING;
+        // a TCP joiner only wins if no shared memory one got in first
+        if(readable(t->listener, 0) && atomic_compare_exchange_strong(&t->shm->state, &listening, SHM_REFUSED)) {
+            unlinkRegion(t->shmName);
+            unmapRegion(t);
+            break;
+        }
+        if(atomic_load(&t->shm->state) == SHM_JOINED) {
+            unlinkRegion(t->shmName);
+            closesocket(t->listener);
+            WSACleanup();
+            t->listener = INVALID_SOCKET;
+            useShm(t, 0);
+            return 0;
+        }
+    }
+#endif
+    if(tcp_server_accept_connection(&t->listener, &t->sock)) {
+        return 1;
+    }
+    useTcp(t, tcpCloseHost);
+    return 0;
+}
+
+int transport_join(Transport *t, Config config, int packetLen) {
+#ifdef SHM_RING
+    if(isLocal(config.host)) {
+        init(t, "shm", true, packetLen);
+        regionName(t->shmName, sizeof(t->shmName), config.port);
+        if(mapRegion(t, t->shmName, false) == 0) {
+            struct ShmRegion *r = t->shm;
+            unsigned int listening = SHM_LISTENING;
+            if(r->magic == SHM_MAGIC && r->packetLen == packetLen &&
+               atomic_compare_exchange_strong(&r->state, &listening, SHM_JOINED)) {
+                wake(t, SHM_WAKE_STATE);
+                useShm(t, 1);
+                return 0;
+            }
+            unmapRegion(t);
+        }
+    }
+#endif
+    return transport_tcp_join(t, config, packetLen);
+}
+
+void transport_impair(Transport *t, const ImpairConfig *cfg, unsigned int seed) {
+    impair_init(&t->impairment, cfg, t->stream, seed);
+    t->impaired = true;
+}
+
+// Writes what the shim has let through by now.
+static int releaseDue(Transport *t, uint64_t now) {
+    unsigned char p[TRANSPORT_MAX_PACKET];
+    int len;
+    while((len = impair_pop(&t->impairment, now, p)) > 0) {
+        if(t->write(t, p, len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int transport_send(Transport *t, const unsigned char *p) {
+    t->sent++;
+    if(!t->impaired) {
+        return t->write(t, p, t->packetLen);
+    }
+    uint64_t now = timer_now_ns();
+    impair_push(&t->impairment, p, t->packetLen, now);
+    return releaseDue(t, now);
+}
+
+int transport_recv(Transport *t, unsigned char *p) {
+    if(t->impaired && releaseDue(t, timer_now_ns())) {
+        return -1;
+    }
+    int r = t->read(t, p);
+    if(r == 1) {
+        t->received++;
+    }
+    return r;
+}
+
+bool transport_wait(Transport *t, int ms) {
+    return t->wait(t, ms);
+}
+
+void transport_close(Transport *t) {
+    t->close(t);
+}
@@ -0,0 +1,85 @@
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tcp_client.h"
+#include "tcp_server.h"
+#include "impair.h"
+
+#define TRANSPORT_MAX_PACKET IMPAIR_MAX_PACKET
+#define TRANSPORT_HELLO "TETRIS HELLO"   // a UDP joiner repeats this until the host answers
+#define TRANSPORT_HELLO_TRIES 50
+#define TRANSPORT_HELLO_WAIT_MS 100
+#define TRANSPORT_SHM_SLOTS 64           // packets in flight each way
+#define TRANSPORT_SHM_FULL_MS 1000       // a writer waits this long for room before giving up
+#define TRANSPORT_ACCEPT_POLL_MS 10
+
+struct ShmRegion;
+
+// Moves fixed size game packets between two players. Over TCP and shared
+// memory they arrive in order or the other side is gone; over UDP any of
+// them can be lost, duplicated or reordered and the game's own protocol has
+// to cope.
+typedef struct Transport {
+    const char *name;
+    int (*write)(struct Transport *t, const unsigned char *p, int len);
+    int (*read)(struct Transport *t, unsigned char *p);
+    bool (*wait)(struct Transport *t, int ms);
+    void (*close)(struct Transport *t);
+    bool stream;                         // in order and never lost
+    SOCKET sock;
+    SOCKET listener;                     // tcp host only
+    struct ShmRegion *shm;               // same host only, NULL otherwise
+    int shmSide;                         // 0 host, 1 joiner
+    char shmName[32];
+#ifdef _WIN32
+    void *shmHandles[4];                 // HANDLEs of the mapping and its events, NULL once closed
+#endif
+    int packetLen;
+    unsigned char partial[TRANSPORT_MAX_PACKET];  // tcp: start of the next packet
+    int partialLen;
+    bool impaired;
+    Impairment impairment;               // outgoing packets only
+    uint64_t sent;
+    uint64_t received;
+    uint64_t ignored;                    // udp datagrams of the wrong size or sender
+} Transport;
+
+int transport_tcp_host(Transport *t, char *port, int packetLen);
+
+int transport_tcp_join(Transport *t, Config config, int packetLen);
+
+// Listens on port over TCP and, on Linux and Windows, also offers a shared
+// memory ring named after the port to joiners on the same host. Doesn't
+// wait for one.
+int transport_listen(Transport *t, char *port, int packetLen);
+
+// Waits for the first joiner, over whichever of the two it comes.
+int transport_accept(Transport *t);
+
+// Shared memory if the host is this machine and offers it, TCP otherwise.
+int transport_join(Transport *t, Config config, int packetLen);
+
+// Waits for a joiner's hello and answers it.
+int transport_udp_host(Transport *t, char *port, int packetLen);
+
+int transport_udp_join(Transport *t, Config config, int packetLen);
+
+// Sends through the impairment shim from now on.
+void transport_impair(Transport *t, const ImpairConfig *cfg, unsigned int seed);
+
+// Returns 1 once the other side is gone.
+int transport_send(Transport *t, const unsigned char *p);
+
+// Reads one packet if there is one. Returns 1 with a packet, 0 if none is
+// waiting and -1 once the other side is gone.
+int transport_recv(Transport *t, unsigned char *p);
+
+// Waits up to ms for a packet to come in. False if none did.
+bool transport_wait(Transport *t, int ms);
+
+void transport_close(Transport *t);
+
+#endif
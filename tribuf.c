@@ -0,0 +1,43 @@
+#include <stdlib.h>
+
+#include "tribuf.h"
+
+int tribuf_init(TripleBuffer *tb, size_t size) {
+    tb->size = size;
+    for(int i = 0; i < 3; i++) {
+        tb->slot[i] = calloc(1, size);
+        if(tb->slot[i] == NULL) {
+            tribuf_free(tb);
+            return 1;
+        }
+    }
+    tb->back = 0;
+    tb->front = 1;
+    atomic_init(&tb->shared, 2);
+    return 0;
+}
+
+void tribuf_free(TripleBuffer *tb) {
+    for(int i = 0; i < 3; i++) {
+        free(tb->slot[i]);
+        tb->slot[i] = NULL;
+    }
+}
+
+void *tribuf_back(TripleBuffer *tb) {
+    return tb->slot[tb->back];
+}
+
+void tribuf_publish(TripleBuffer *tb) {
+    unsigned int old = atomic_exchange_explicit(&tb->shared, tb->back | TRIBUF_FRESH, memory_order_acq_rel);
+    tb->back = old & ~TRIBUF_FRESH;
+}
+
+const void *tribuf_front(TripleBuffer *tb, bool *fresh) {
+    *fresh = (atomic_load_explicit(&tb->shared, memory_order_acquire) & TRIBUF_FRESH) != 0;
+    if(*fresh) {
+        unsigned int old = atomic_exchange_explicit(&tb->shared, tb->front, memory_order_acq_rel);
+        tb->front = old & ~TRIBUF_FRESH;
+    }
+    return tb->slot[tb->front];
+}
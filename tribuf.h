@@ -0,0 +1,39 @@
+#ifndef TRIBUF_H_
+#define TRIBUF_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRIBUF_FRESH 4u                  // set on the shared index until the reader takes it
+
+// Hands the newest copy of some state from one writer thread to one reader
+// without either of them ever waiting on the other. There are three slots:
+// the writer fills its own and swaps it with the shared one, the reader swaps
+// its own for the shared one when a newer copy is there. A copy the reader
+// was too slow for is overwritten, never queued. The writer's slot holds
+// stale data after a swap, so every publish has to fill the whole slot.
+typedef struct TripleBuffer {
+    void *slot[3];
+    size_t size;
+    atomic_uint shared;
+    unsigned int back;                   // writer's slot
+    unsigned int front;                  // reader's slot
+} TripleBuffer;
+
+// Allocates three zeroed slots of size bytes. Returns 1 if out of memory.
+int tribuf_init(TripleBuffer *tb, size_t size);
+
+void tribuf_free(TripleBuffer *tb);
+
+// Slot for the writer to fill.
+void *tribuf_back(TripleBuffer *tb);
+
+// Makes the filled slot the newest copy.
+void tribuf_publish(TripleBuffer *tb);
+
+// Newest copy published so far, zeroed before the first one. fresh is set if
+// it wasn't returned by an earlier call. Only valid until the next call.
+const void *tribuf_front(TripleBuffer *tb, bool *fresh);
+
+#endif
@@ -0,0 +1,334 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tune.h"
+#include "timer.h"
+#include "fsutil.h"
+
+static double uniform(unsigned int *rng) {
+    *rng = (*rng * 1103515245u) + 12345u;
+    return ((*rng >> 8) & 0xffffff) / (double)0x1000000;
+}
+
+static double gaussian(unsigned int *rng) {
+    double u = uniform(rng);
+    double v = uniform(rng);
+    // (log) so tetris.h's log() macro doesn't expand
+    return sqrt(-2.0 * (log)(u + 1e-12)) * cos(2.0 * M_PI * v);
+}
+
+// Only the direction of the weights matters to the bot, so every candidate is
+// kept at unit length.
+static void normalize(BotWeights *w) {
+    double len = 0;
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        len += w->w[k] * w->w[k];
+    }
+    len = sqrt(len);
+    if(len == 0) {
+        return;
+    }
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        w->w[k] /= len;
+    }
+}
+
+static uint32_t playGame(GameSim *g, const BotWeights *w, unsigned int seed, int depth, Arena *nodes) {
+    BotMove move;
+    sim_init(g, seed, 1);
+    while(!g->over && g->pieces < TUNE_MAX_PIECES && bot_search(g, w, depth, nodes, &move) == 0) {
+        sim_place(g, move.rotations, move.column);
+        arena_reset(nodes);
+    }
+    // every cleared line is worth 100
+    return (uint32_t)(g->score / 100);
+}
+
+static void *worker(void *arg) {
+    TunePool *p = (TunePool *)arg;
+    GameSim g;
+    Arena nodes;
+    int seen = 0;
+    // sized once for the search depth, nothing is allocated per move; without
+    // it every search fails and shows up in the failed count
+    if(arena_init(&nodes, bot_search_bytes(p->depth))) {
+        arena_wrap(&nodes, NULL, 0);
+    }
+    pthread_mutex_lock(&p->lock);
+    for(;;) {
+        while(p->round == seen && !p->quit) {
+            pthread_cond_wait(&p->start, &p->lock);
+        }
+        if(p->quit) {
+            break;
+        }
+        seen = p->round;
+        while(p->nextJob < p->jobs) {
+            int job = p->nextJob++;
+            const BotWeights *w = &p->candidates[job / p->games].weights;
+            unsigned int seed = p->seed + job % p->games;
+            pthread_mutex_unlock(&p->lock);
+            uint32_t lines = playGame(&g, w, seed, p->depth, &nodes);
+            pthread_mutex_lock(&p->lock);
+            p->lines[job] = lines;
+            if(++p->finished == p->jobs) {
+                pthread_cond_signal(&p->done);
+            }
+        }
+    }
+    if(nodes.peak > p->arenaPeak) {
+        p->arenaPeak = nodes.peak;
+    }
+    p->arenaFailed += nodes.failed;
+    pthread_mutex_unlock(&p->lock);
+    arena_free(&nodes);
+    return NULL;
+}
+
+static int poolStart(TunePool *p, int threads, int maxJobs, int depth) {
+    memset(p, 0, sizeof(*p));
+    p->depth = depth;
+    p->lines = calloc(maxJobs, sizeof(uint32_t));
+    if(p->lines == NULL) {
+        return 1;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for(p->count = 0; p->count < threads; p->count++) {
+        if(pthread_create(&p->threads[p->count], NULL, worker, p) != 0) {
+            break;
+        }
+    }
+    return p->count == 0;
+}
+
+static void poolStop(TunePool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for(int i = 0; i < p->count; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free(p->lines);
+}
+
+// Plays every candidate on the same games seeds and sets its fitness.
+static void evaluate(TunePool *p, TuneState *s) {
+    pthread_mutex_lock(&p->lock);
+    p->candidates = s->candidates;
+    p->games = s->games;
+    p->seed = (unsigned int)s->generation * s->games + 1;
+    p->jobs = s->population * s->games;
+    p->nextJob = 0;
+    p->finished = 0;
+    p->round++;
+    pthread_cond_broadcast(&p->start);
+    while(p->finished < p->jobs) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    for(int i = 0; i < s->population; i++) {
+        uint64_t sum = 0;
+        for(int k = 0; k < s->games; k++) {
+            sum += p->lines[i * s->games + k];
+        }
+        s->candidates[i].fitness = sum / (double)s->games;
+    }
+}
+
+static int byFitness(const void *a, const void *b) {
+    double fa = ((const TuneCandidate *)a)->fitness;
+    double fb = ((const TuneCandidate *)b)->fitness;
+    return fa < fb ? 1 : fa > fb ? -1 : 0;
+}
+
+static int tournament(TuneState *s) {
+    int best = -1;
+    for(int i = 0; i < TUNE_TOURNAMENT; i++) {
+        int k = (int)(uniform(&s->rng) * s->population);
+        if(best < 0 || s->candidates[k].fitness > s->candidates[best].fitness) {
+            best = k;
+        }
+    }
+    return best;
+}
+
+// Keeps the elite, fills the rest with fitness weighted crossovers of two
+// tournament winners plus gaussian mutation.
+static void breed(TuneState *s) {
+    TuneCandidate next[TUNE_MAX_POPULATION];
+    qsort(s->candidates, s->population, sizeof(TuneCandidate), byFitness);
+    if(s->generation == 0 || s->candidates[0].fitness > s->best.fitness) {
+        s->best = s->candidates[0];
+    }
+    int elite = s->population < TUNE_ELITE ? s->population : TUNE_ELITE;
+    for(int i = 0; i < elite; i++) {
+        next[i] = s->candidates[i];
+    }
+    for(int i = elite; i < s->population; i++) {
+        TuneCandidate *a = &s->candidates[tournament(s)];
+        TuneCandidate *b = &s->candidates[tournament(s)];
+        double fa = a->fitness + 1;
+        double fb = b->fitness + 1;
+        for(int k = 0; k < BOT_FEATURES; k++) {
+            next[i].weights.w[k] = (a->weights.w[k] * fa + b->weights.w[k] * fb) / (fa + fb);
+            if(uniform(&s->rng) < 0.5) {
+                next[i].weights.w[k] += gaussian(&s->rng) * TUNE_MUTATION;
+            }
+        }
+        normalize(&next[i].weights);
+        next[i].fitness = 0;
+    }
+    memcpy(s->candidates, next, s->population * sizeof(TuneCandidate));
+    s->generation++;
+}
+
+static void initState(TuneState *s, int population, int games) {
+    memset(s, 0, sizeof(*s));
+    s->population = population;
+    s->games = games;
+    s->rng = 12345u;
+    s->candidates[0].weights = bot_default_weights;
+    normalize(&s->candidates[0].weights);
+    for(int i = 1; i < population; i++) {
+        for(int k = 0; k < BOT_FEATURES; k++) {
+            s->candidates[i].weights.w[k] = uniform(&s->rng) * 2 - 1;
+        }
+        normalize(&s->candidates[i].weights);
+    }
+}
+
+static void printWeights(FILE *fp, const BotWeights *w) {
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        fprintf(fp, " %.17g", w->w[k]);
+    }
+}
+
+static bool readWeights(FILE *fp, TuneCandidate *c) {
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        if(fscanf(fp, "%lf", &c->weights.w[k]) != 1) {
+            return false;
+        }
+    }
+    return fscanf(fp, "%lf", &c->fitness) == 1;
+}
+
+// Written to a temporary file first so a crash mid write keeps the last
+// checkpoint.
+int tune_save(TuneState *s, const char *path) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w+");
+    if(!fp) {
+        return 1;
+    }
+    fprintf(fp, "tune %d\n", BOT_FEATURES);
+    fprintf(fp, "generation %d\n", s->generation);
+    fprintf(fp, "population %d\n", s->population);
+    fprintf(fp, "games %d\n", s->games);
+    fprintf(fp, "rng %u\n", s->rng);
+    fprintf(fp, "best");
+    printWeights(fp, &s->best.weights);
+    fprintf(fp, " %.17g\n", s->best.fitness);
+    for(int i = 0; i < s->population; i++) {
+        fprintf(fp, "candidate");
+        printWeights(fp, &s->candidates[i].weights);
+        fprintf(fp, " %.17g\n", s->candidates[i].fitness);
+    }
+    if(fclose(fp) != 0) {
+        return 1;
+    }
+    return fs_replace(tmp, path);
+}
+
+int tune_load(TuneState *s, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if(!fp) {
+        return 1;
+    }
+    memset(s, 0, sizeof(*s));
+    int features = 0;
+    bool ok = fscanf(fp, "tune %d generation %d population %d games %d rng %u best",
+                     &features, &s->generation, &s->population, &s->games, &s->rng) == 5
+              && features == BOT_FEATURES
+              && s->population > 0 && s->population <= TUNE_MAX_POPULATION
+              && s->games > 0
+              && readWeights(fp, &s->best);
+    for(int i = 0; ok && i < s->population; i++) {
+        int n = 0;
+        ok = fscanf(fp, " candidate%n", &n) == 0 && n > 0 && readWeights(fp, &s->candidates[i]);
+    }
+    fclose(fp);
+    return ok ? 0 : 1;
+}
+
+int tune_main(int argc, char *argv[]) {
+    int generations = argc > 1 ? atoi(argv[1]) : 20;
+    int population = argc > 2 ? atoi(argv[2]) : 32;
+    int games = argc > 3 ? atoi(argv[3]) : 16;
+    int threads = argc > 4 ? atoi(argv[4]) : 4;
+    const char *path = argc > 5 ? argv[5] : TUNE_DEFAULT_FILE;
+    int depth = argc > 6 ? atoi(argv[6]) : 1;
+    if(population < 2 || population > TUNE_MAX_POPULATION || games < 1 || threads < 1 || threads > TUNE_MAX_THREADS
+       || depth < 1 || depth > TUNE_MAX_DEPTH) {
+        fprintf(stderr, "usage: tune [generations] [population 2-%d] [games] [threads 1-%d] [checkpoint] [depth 1-%d]\n",
+                TUNE_MAX_POPULATION, TUNE_MAX_THREADS, TUNE_MAX_DEPTH);
+        return EXIT_FAILURE;
+    }
+    // the engine draws unless told not to
+    headless = true;
+
+    static TuneState s;
+    if(tune_load(&s, path) == 0) {
+        printf("resuming %s at generation %d (population %d, %d games each)\n", path, s.generation, s.population, s.games);
+    } else {
+        initState(&s, population, games);
+    }
+
+    TunePool pool;
+    if(poolStart(&pool, threads, s.population * s.games, depth)) {
+        fprintf(stderr, "unable to start worker threads\n");
+        return EXIT_FAILURE;
+    }
+    while(s.generation < generations) {
+        uint64_t start = timer_now_ns();
+        evaluate(&pool, &s);
+        double mean = 0;
+        for(int i = 0; i < s.population; i++) {
+            mean += s.candidates[i].fitness / s.population;
+        }
+        int gen = s.generation;
+        breed(&s);
+        double secs = (timer_now_ns() - start) / 1e9;
+        printf("generation %3d best %7.1f mean %7.1f lines, %d games in %.1fs (%.0f games/s)\n", gen,
+               s.candidates[0].fitness, mean, s.population * s.games, secs, s.population * s.games / secs);
+        if(tune_save(&s, path)) {
+            fprintf(stderr, "unable to write %s\n", path);
+        }
+    }
+    poolStop(&pool);
+    printf("search arena peak %zu of %zu bytes per thread", pool.arenaPeak, bot_search_bytes(depth));
+    if(pool.arenaFailed) {
+        printf(", %zu allocations didn't fit", pool.arenaFailed);
+    }
+    printf("\n");
+
+    printf("best %.1f lines per game (cut off at %d pieces):\n", s.best.fitness, TUNE_MAX_PIECES);
+    for(int k = 0; k < BOT_FEATURES; k++) {
+        char name[32];
+        int n = 0;
+        for(; bot_feature_names[k][n] && n < 31; n++) {
+            name[n] = toupper((unsigned char)bot_feature_names[k][n]);
+        }
+        name[n] = '\0';
+        printf("    [BOT_%s] = %.4f,\n", name, s.best.weights.w[k]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#ifndef TUNE_H_
+#define TUNE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "bot.h"
+
+#define TUNE_DEFAULT_FILE "data/tune.txt"
+#define TUNE_MAX_POPULATION 256
+#define TUNE_MAX_THREADS 64
+#define TUNE_MAX_PIECES 500     // games are cut off here so good weights don't run forever
+#define TUNE_ELITE 4            // best candidates kept unchanged each generation
+#define TUNE_TOURNAMENT 4
+#define TUNE_MUTATION 0.2
+#define TUNE_MAX_DEPTH 3        // pieces the bot looks ahead, each one multiplies the cost by ~30
+
+typedef struct TuneCandidate {
+    BotWeights weights;
+    double fitness;             // mean lines cleared per game
+} TuneCandidate;
+
+// Everything needed to resume a run, this is what the checkpoint holds.
+typedef struct TuneState {
+    int generation;
+    int population;
+    int games;
+    unsigned int rng;
+    TuneCandidate candidates[TUNE_MAX_POPULATION];
+    TuneCandidate best;
+} TuneState;
+
+// Worker threads that each own one GameSim and a search arena and play (candidate, game) jobs
+// handed out for a generation.
+typedef struct TunePool {
+    pthread_t threads[TUNE_MAX_THREADS];
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    int round;                  // bumped to start a generation
+    bool quit;
+    int jobs;
+    int nextJob;
+    int finished;
+    int games;
+    unsigned int seed;          // first seed of this generation, the same for every candidate
+    TuneCandidate *candidates;
+    uint32_t *lines;            // jobs results, candidate * games + game
+    int depth;                  // bot_search depth
+    size_t arenaPeak;           // largest search arena any worker used
+    size_t arenaFailed;
+} TunePool;
+
+int tune_save(TuneState *s, const char *path);
+
+int tune_load(TuneState *s, const char *path);
+
+// Command line entry: tune [generations] [population] [games] [threads] [checkpoint] [depth]
+int tune_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "view.h"
+#include "timer.h"
+
+static void deadline(struct timespec *until, uint64_t ns) {
+    clock_gettime(CLOCK_REALTIME, until);
+    until->tv_sec += ns / 1000000000ULL;
+    until->tv_nsec += ns % 1000000000ULL;
+    if(until->tv_nsec >= 1000000000L) {
+        until->tv_sec++;
+        until->tv_nsec -= 1000000000L;
+    }
+}
+
+static int openWake(View *v) {
+#ifdef _WIN32
+    v->wakeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    return v->wakeEvent == NULL;
+#else
+    if(pipe(v->wakePipe) != 0) {
+        v->wakePipe[0] = v->wakePipe[1] = -1;
+        return 1;
+    }
+    fcntl(v->wakePipe[0], F_SETFL, O_NONBLOCK);
+    return 0;
+#endif
+}
+
+static void closeWake(View *v) {
+#ifdef _WIN32
+    if(v->wakeEvent != NULL) {
+        CloseHandle(v->wakeEvent);
+        v->wakeEvent = NULL;
+    }
+#else
+    if(v->wakePipe[0] >= 0) {
+        close(v->wakePipe[0]);
+        close(v->wakePipe[1]);
+        v->wakePipe[0] = v->wakePipe[1] = -1;
+    }
+#endif
+}
+
+int view_init(View *v, const ViewScreen *screen) {
+    memset(v, 0, sizeof(*v));
+    v->screen = screen;
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->keyReady, NULL);
+#ifndef _WIN32
+    v->wakePipe[0] = v->wakePipe[1] = -1;
+#endif
+    v->last = malloc(screen->frameSize);
+    if(v->last == NULL || tribuf_init(&v->local, screen->frameSize)
+       || tribuf_init(&v->remote, sizeof(ViewRemote)) || openWake(v)) {
+        view_free(v);
+        return 1;
+    }
+    return 0;
+}
+
+void view_free(View *v) {
+    tribuf_free(&v->local);
+    tribuf_free(&v->remote);
+    free(v->last);
+    v->last = NULL;
+    closeWake(v);
+    pthread_mutex_destroy(&v->lock);
+    pthread_cond_destroy(&v->keyReady);
+}
+
+// Sets pending and makes it wake the render thread. Called with lock held.
+static void setPending(View *v) {
+    if(v->pending) {
+        return;
+    }
+    v->pending = true;
+#ifdef _WIN32
+    SetEvent(v->wakeEvent);
+#else
+    // can't fill up, there is at most one byte in it
+    (void)!write(v->wakePipe[1], "", 1);
+#endif
+}
+
+// Clears pending. Called with lock held.
+static void clearPending(View *v) {
+    if(!v->pending) {
+        return;
+    }
+    v->pending = false;
+#ifdef _WIN32
+    ResetEvent(v->wakeEvent);
+#else
+    char byte;
+    (void)!read(v->wakePipe[0], &byte, 1);
+#endif
+}
+
+// Sleeps until a key comes in or pending is set.
+static void waitWake(View *v) {
+#ifdef _WIN32
+    // the console's handle is signalled while it has unread input
+    HANDLE handles[2] = {GetStdHandle(STD_INPUT_HANDLE), v->wakeEvent};
+    WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+#else
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {v->wakePipe[0], POLLIN, 0}};
+    poll(fds, 2, -1);
+#endif
+}
+
+static void wakeRenderer(View *v) {
+    pthread_mutex_lock(&v->lock);
+    setPending(v);
+    pthread_mutex_unlock(&v->lock);
+}
+
+void *view_frame(View *v) {
+    return tribuf_back(&v->local);
+}
+
+void view_publish(View *v) {
+    tribuf_publish(&v->local);
+    wakeRenderer(v);
+}
+
+void view_publish_remote(View *v, const char *frame, NetStats *ns) {
+    ViewRemote *r = (ViewRemote *)tribuf_back(&v->remote);
+    memcpy(r->frame, frame, FRAME_LEN);
+    netstats_format(ns, r->net);
+    tribuf_publish(&v->remote);
+    wakeRenderer(v);
+}
+
+int view_key(View *v, uint64_t ns, uint64_t *at) {
+    struct timespec until;
+    deadline(&until, ns);
+    int key = ERR;
+    pthread_mutex_lock(&v->lock);
+    while(v->keyCount == 0 && v->running) {
+        if(pthread_cond_timedwait(&v->keyReady, &v->lock, &until) != 0) {
+            break;
+        }
+    }
+    if(v->keyCount > 0) {
+        key = v->keys[v->keyHead];
+        if(at != NULL) {
+            *at = v->keyAt[v->keyHead];
+        }
+        v->keyHead = (v->keyHead + 1) % VIEW_KEYS;
+        v->keyCount--;
+    }
+    pthread_mutex_unlock(&v->lock);
+    return key;
+}
+
+static void readKeys(View *v) {
+    int key;
+    while((key = wgetch(stdscr)) != ERR) {
+        uint64_t now = timer_now_ns();
+        pthread_mutex_lock(&v->lock);
+        if(v->keyCount < VIEW_KEYS) {
+            int tail = (v->keyHead + v->keyCount) % VIEW_KEYS;
+            v->keys[tail] = key;
+            v->keyAt[tail] = now;
+            v->keyCount++;
+            pthread_cond_signal(&v->keyReady);
+        } else {
+            v->keysDropped++;
+        }
+        pthread_mutex_unlock(&v->lock);
+    }
+}
+
+static void drawCells(const ViewFrame *f, const ViewFrame *last, int row) {
+    for(int j = 0; j < MATRIX_WIDTH; j++) {
+        if(last != NULL && f->cells[row][j] == last->cells[row][j]) {
+            continue;
+        }
+        if(f->cells[row][j]) {
+            paint(row, blocktomatrix(j));
+        } else {
+            whiteout(row, blocktomatrix(j));
+        }
+    }
+}
+
+static void startPlay(View *v) {
+    drawBoard(0, 1, 0);
+    if(v->twoPlayer) {
+        drawBoard(0, 1, VIEW_OPPONENT_OFFSET);
+    }
+}
+
+// Draws what changed since last, everything if last is NULL.
+static uint64_t drawPlay(View *v, const void *frame, const void *previous) {
+    const ViewFrame *f = (const ViewFrame *)frame;
+    const ViewFrame *last = (const ViewFrame *)previous;
+    bool unpaused = last != NULL && last->paused && !f->paused;
+    for(int i = 0; i < MATRIX_LENGTH-1; i++) {
+        // the PAUSED label covered row 13
+        drawCells(f, unpaused && i == 13 ? NULL : last, i);
+    }
+    if(last == NULL || f->next != last->next) {
+        eraseNext(f->next, 0);
+        drawNext(f->next, 0);
+    }
+    if(last == NULL || f->heldExists != last->heldExists || f->held != last->held) {
+        if(last != NULL && last->heldExists) {
+            eraseHeld(last->held, 0);
+        }
+        if(f->heldExists) {
+            drawHeld(f->held, 0);
+        }
+    }
+    if(last == NULL || f->score != last->score || f->level != last->level) {
+        drawScoreLevel(f->score, f->level, 0);
+    }
+    if(f->paused) {
+        render_printf(13, 18, "PAUSED");
+    }
+    if(f->overlay) {
+        FrameStatsRow rows[FRAMESTATS_ROWS];
+        framestats_row(&v->stats->input, &rows[FRAMESTATS_INPUT]);
+        rows[FRAMESTATS_TICK] = f->tick;
+        rows[FRAMESTATS_MUTEX] = f->mutexWait;
+        framestats_row(&v->stats->render, &rows[FRAMESTATS_RENDER]);
+        framestats_draw(rows, FRAMESTATS_Y, FRAMESTATS_X);
+    } else if(last != NULL && last->overlay) {
+        framestats_erase(FRAMESTATS_Y, FRAMESTATS_X);
+    }
+    return f->inputAt;
+}
+
+const ViewScreen viewPlay = {sizeof(ViewFrame), startPlay, drawPlay};
+
+static void *renderLoop(void *arg) {
+    View *v = (View *)arg;
+    bool drawn = false;
+    bool running = true;
+    PerfGroup group;
+    bool counting = perf_open(&group) == 0;
+    if(counting) {
+        perf_start(&group);
+        perf_phases_init(&v->stats->phases, &group);
+        perfPhases = &v->stats->phases;
+    }
+    timeout(0);
+    if(v->screen->start != NULL) {
+        v->screen->start(v);
+    }
+    while(running) {
+        // keys are read below until there are none, so anything left to
+        // wake for is new
+        pthread_mutex_lock(&v->lock);
+        bool pending = v->pending;
+        pthread_mutex_unlock(&v->lock);
+        if(!pending) {
+            waitWake(v);
+        }
+        pthread_mutex_lock(&v->lock);
+        clearPending(v);
+        running = v->running;
+        pthread_mutex_unlock(&v->lock);
+
+        readKeys(v);
+        uint64_t start = timer_now_ns();
+        perf_phase_begin();
+        bool fresh;
+        bool dirty = false;
+        uint64_t inputAt = 0;
+        const void *f = tribuf_front(&v->local, &fresh);
+        if(fresh) {
+            uint32_t seq = *(const uint32_t *)f;
+            uint32_t lastSeq = *(const uint32_t *)v->last;
+            if(drawn && seq > lastSeq + 1) {
+                v->framesSkipped += seq - lastSeq - 1;
+            }
+            inputAt = v->screen->draw(v, f, drawn ? v->last : NULL);
+            memcpy(v->last, f, v->screen->frameSize);
+            drawn = true;
+            dirty = true;
+        }
+        const ViewRemote *r = (const ViewRemote *)tribuf_front(&v->remote, &fresh);
+        if(fresh) {
+            drawSecondPlayer((char *)r->frame, NULL);
+            render_put(28, 5 + VIEW_OPPONENT_OFFSET, r->net[0]);
+            render_put(29, 5 + VIEW_OPPONENT_OFFSET, r->net[1]);
+            dirty = true;
+        }
+        if(dirty) {
+            render_flush();
+            perf_phase_end(PERF_PHASE_RENDER);
+            uint64_t end = timer_now_ns();
+            histogram_record(&v->stats->render, end - start);
+            if(inputAt != 0) {
+                histogram_record(&v->stats->input, end - inputAt);
+            }
+            v->framesDrawn++;
+        }
+    }
+    if(counting) {
+        perfPhases = NULL;
+        v->stats->phases.group = NULL;
+        perf_close(&group);
+    }
+    timeout(delay);
+    return NULL;
+}
+
+int view_start(View *v, bool twoPlayer, FrameStats *stats) {
+    bool fresh;
+    // whatever is left over from the last game isn't drawn
+    tribuf_front(&v->local, &fresh);
+    tribuf_front(&v->remote, &fresh);
+    v->twoPlayer = twoPlayer;
+    v->stats = stats;
+    // view_stop left it set
+    clearPending(v);
+    v->running = true;
+    v->keyHead = 0;
+    v->keyCount = 0;
+    v->framesDrawn = 0;
+    v->framesSkipped = 0;
+    v->keysDropped = 0;
+    if(pthread_create(&v->thread, NULL, renderLoop, v) != 0) {
+        v->running = false;
+        return 1;
+    }
+    return 0;
+}
+
+void view_stop(View *v) {
+    pthread_mutex_lock(&v->lock);
+    if(!v->running) {
+        pthread_mutex_unlock(&v->lock);
+        return;
+    }
+    v->running = false;
+    setPending(v);
+    pthread_cond_broadcast(&v->keyReady);
+    pthread_mutex_unlock(&v->lock);
+    pthread_join(v->thread, NULL);
+}
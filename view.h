@@ -0,0 +1,116 @@
+#ifndef VIEW_H_
+#define VIEW_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tetris.h"
+#include "frame.h"
+#include "framestats.h"
+#include "netstats.h"
+#include "tribuf.h"
+
+#define VIEW_KEYS 64
+#define VIEW_OPPONENT_OFFSET 55
+
+// Everything the render thread needs to draw one frame of play(), a copy
+// that nothing changes once it's published.
+typedef struct ViewFrame {
+    uint32_t seq;
+    bool cells[MATRIX_LENGTH-1][MATRIX_WIDTH];   // settled blocks and the falling piece
+    Color next;
+    Color held;
+    bool heldExists;
+    int score;
+    int level;
+    bool paused;
+    bool overlay;
+    FrameStatsRow tick;
+    FrameStatsRow mutexWait;
+    uint64_t inputAt;                    // when the key behind this frame was read, 0 for gravity
+} ViewFrame;
+
+struct View;
+
+// What a View draws. Every frame published to it starts with a uint32_t
+// sequence number, frames the render thread was too slow for are counted
+// from the gaps in it.
+typedef struct ViewScreen {
+    size_t frameSize;
+    void (*start)(struct View *v);       // empty boards before the first frame, or NULL
+    // Draws frame over last (NULL the first time), returns when the key
+    // behind it was read or 0.
+    uint64_t (*draw)(struct View *v, const void *frame, const void *last);
+} ViewScreen;
+
+// play()'s boards, frames are ViewFrames.
+extern const ViewScreen viewPlay;
+
+// The last frame from the other player and the link stats under it.
+typedef struct ViewRemote {
+    char frame[FRAME_LEN];
+    char net[2][NETSTATS_LINE];
+} ViewRemote;
+
+// The render thread of a game. It is the only thread that calls curses while
+// the game runs: it reads the keyboard and hands keys to the game through a
+// queue, and draws the newest frame from the game and ViewRemote from
+// client()/server(), each handed over in a triple buffer. A slow terminal
+// only makes it skip frames, gravity and input never wait for it. Between
+// frames it sleeps until a key comes in or something is published, never
+// on a timer.
+typedef struct View {
+    const ViewScreen *screen;
+    TripleBuffer local;                  // screen's frames, written by the game
+    TripleBuffer remote;                 // ViewRemote, written by client() or server()
+    void *last;                          // frame drawn last, render thread only
+    FrameStats *stats;                   // input and render are recorded here
+    bool twoPlayer;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t keyReady;
+    bool pending;                        // something was published or the view stops
+#ifdef _WIN32
+    void *wakeEvent;                     // HANDLE, signalled while pending is set
+#else
+    int wakePipe[2];                     // holds a byte while pending is set
+#endif
+    bool running;
+    int keys[VIEW_KEYS];
+    uint64_t keyAt[VIEW_KEYS];
+    int keyHead;
+    int keyCount;
+
+    uint64_t framesDrawn;
+    uint64_t framesSkipped;              // published but overwritten before they were drawn
+    uint64_t keysDropped;
+} View;
+
+// Allocates the buffers once, before any thread publishes. Returns 1 if out
+// of memory.
+int view_init(View *v, const ViewScreen *screen);
+
+void view_free(View *v);
+
+// Starts the render thread, which draws the empty boards first.
+int view_start(View *v, bool twoPlayer, FrameStats *stats);
+
+// Draws what is still pending and stops the render thread. Curses is free
+// for the caller again afterwards.
+void view_stop(View *v);
+
+// Slot for the next frame, the game fills all of it and calls view_publish.
+void *view_frame(View *v);
+
+void view_publish(View *v);
+
+// Copies the opponent's frame and the link stats for drawing.
+void view_publish_remote(View *v, const char *frame, NetStats *ns);
+
+// Next key read by the render thread, waits up to ns for one. Returns ERR if
+// none came, at is set to when the key was read.
+int view_key(View *v, uint64_t ns, uint64_t *at);
+
+#endif